@@ -44,8 +44,17 @@
 #include <pybind11/stl.h>
 
 #include "BingoCpp/acyclic_graph.h"
+#include "BingoCpp/distance.h"
 #include "BingoCpp/graph_manip.h"
+#include "BingoCpp/island.h"
+#include "BingoCpp/fitness_cache.h"
 #include "BingoCpp/fitness_metric.h"
+#include "BingoCpp/jit.h"
+#include "BingoCpp/memo.h"
+#include "BingoCpp/population.h"
+#include "BingoCpp/random.h"
+#include "BingoCpp/rewrite.h"
+#include "BingoCpp/thread_pool.h"
 #include "BingoCpp/training_data.h"
 #include "BingoCpp/utils.h"
 
@@ -59,22 +68,125 @@ using namespace bingo;
 PYBIND11_MODULE(bingocpp, m) {
   m.doc() = "pybind11 example plugin";  // optional module docstring
   m.def("is_cpp", &is_cpp, "is the backend c++");
-  m.def("evaluate", &evaluate, "evaluate");
-  m.def("simplify_and_evaluate", &simplify_and_evaluate,
+  m.def("evaluate", (Eigen::ArrayXXd (*)(const Eigen::ArrayX3i&,
+                                         const Eigen::ArrayXXd&,
+                                         const Eigen::VectorXd&)) &evaluate,
+        "evaluate");
+  m.def("simplify_and_evaluate",
+        (Eigen::ArrayXXd (*)(const Eigen::ArrayX3i&,
+                             const Eigen::ArrayXXd&,
+                             const Eigen::VectorXd&)) &simplify_and_evaluate,
         "evaluate after simplification");
-  m.def("evaluate_with_derivative", &evaluate_with_derivative,
+  m.def("evaluate_with_derivative",
+        (std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd> (*)(
+           const Eigen::ArrayX3i&, const Eigen::ArrayXXd&,
+           const Eigen::VectorXd&, const bool)) &evaluate_with_derivative,
         "evaluate with derivative");
   m.def("simplify_and_evaluate_with_derivative",
+        (std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd> (*)(
+           const Eigen::ArrayX3i&, const Eigen::ArrayXXd&,
+           const Eigen::VectorXd&, const bool))
         &simplify_and_evaluate_with_derivative,
         "evaluate with derivative after simplification");
+  m.def("evaluate_population",
+        (Eigen::ArrayXXd (*)(const std::vector<Eigen::ArrayX3i>&,
+                             const Eigen::ArrayXXd&,
+                             const std::vector<Eigen::VectorXd>&))
+        &evaluate_population,
+        "evaluate a population of stacks after simplification");
+  m.def("evaluate_population",
+        (Eigen::ArrayXXd (*)(const std::vector<Eigen::ArrayX3i>&,
+                             const Eigen::ArrayXXd&,
+                             const std::vector<Eigen::VectorXd>&,
+                             ThreadPool&)) &evaluate_population,
+        "evaluate a population of stacks after simplification in parallel",
+        py::call_guard<py::gil_scoped_release>());
+  m.def("evaluate_population",
+        (Eigen::ArrayXXd (*)(const std::vector<Eigen::ArrayX3i>&,
+                             const Eigen::ArrayXXd&,
+                             const std::vector<Eigen::VectorXd>&,
+                             SubexpressionMemo&)) &evaluate_population,
+        "evaluate a population of stacks through a subexpression memo");
+  m.def("evaluate_population",
+        (Eigen::ArrayXXd (*)(const std::vector<Eigen::ArrayX3i>&,
+                             const Eigen::ArrayXXd&,
+                             const std::vector<Eigen::VectorXd>&,
+                             SubexpressionMemo&, ThreadPool&))
+        &evaluate_population,
+        "evaluate a population of stacks through a subexpression memo in "
+        "parallel",
+        py::call_guard<py::gil_scoped_release>());
+  m.def("evaluate_population_with_derivative",
+        (std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd> (*)(
+           const std::vector<Eigen::ArrayX3i>&, const Eigen::ArrayXXd&,
+           const std::vector<Eigen::VectorXd>&, const bool))
+        &evaluate_population_with_derivative,
+        "evaluate a population of stacks with derivatives after "
+        "simplification");
+  m.def("evaluate_population_with_derivative",
+        (std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd> (*)(
+           const std::vector<Eigen::ArrayX3i>&, const Eigen::ArrayXXd&,
+           const std::vector<Eigen::VectorXd>&, ThreadPool&, const bool))
+        &evaluate_population_with_derivative,
+        "evaluate a population of stacks with derivatives after "
+        "simplification in parallel",
+        py::call_guard<py::gil_scoped_release>());
   m.def("get_utilized_commands",
-        &get_utilized_commands,
+        (std::vector<bool> (*)(const Eigen::ArrayX3i&)) &get_utilized_commands,
         "get the commands that are utilized in a stack");
   m.def("simplify_stack", &simplify_stack,
         "simplify stack to only utilized commands");
+  m.def("merge_common_subexpressions", &merge_common_subexpressions,
+        "merge duplicate commands of a stack");
+  m.def("rewrite_stack", &rewrite_stack,
+        "simplify a stack with algebraic identities");
         
         
-  m.def("rand_init", &rand_init);
+  py::class_<Xoshiro256>(m, "Xoshiro256")
+  .def(py::init<uint64_t>(), py::arg("seed") = 0)
+  .def("seed", &Xoshiro256::seed)
+  .def("jump", &Xoshiro256::jump)
+  .def("uniform_int", &Xoshiro256::uniform_int)
+  .def("uniform_float", &Xoshiro256::uniform_float);
+  py::enum_<DistanceMode>(m, "DistanceMode")
+  .value("STACK_DISTANCE", STACK_DISTANCE)
+  .value("UTILIZED_DISTANCE", UTILIZED_DISTANCE);
+  m.def("distance_matrix",
+        (Eigen::ArrayXXi (*)(const std::vector<AcyclicGraph>&, DistanceMode))
+        &distance_matrix, py::arg("population"),
+        py::arg("mode") = STACK_DISTANCE);
+  m.def("distance_matrix",
+        (Eigen::ArrayXXi (*)(const std::vector<AcyclicGraph>&, DistanceMode,
+                             ThreadPool&)) &distance_matrix,
+        py::call_guard<py::gil_scoped_release>());
+  m.def("distance_matrix",
+        (Eigen::ArrayXXi (*)(const Population&, DistanceMode))
+        &distance_matrix<int>, py::arg("population"),
+        py::arg("mode") = STACK_DISTANCE);
+  m.def("distance_matrix",
+        (Eigen::ArrayXXi (*)(const Population&, DistanceMode, ThreadPool&))
+        &distance_matrix<int>, py::call_guard<py::gil_scoped_release>());
+  py::class_<ThreadPool>(m, "ThreadPool")
+  .def(py::init<int>(), py::arg("num_threads") = 0)
+  .def("num_threads", &ThreadPool::num_threads);
+  py::class_<MemoStatistics>(m, "MemoStatistics")
+  .def_readonly("hits", &MemoStatistics::hits)
+  .def_readonly("misses", &MemoStatistics::misses)
+  .def_readonly("evictions", &MemoStatistics::evictions)
+  .def_readonly("entries", &MemoStatistics::entries)
+  .def_readonly("bytes", &MemoStatistics::bytes)
+  .def_readonly("capacity_bytes", &MemoStatistics::capacity_bytes)
+  .def("hit_rate", &MemoStatistics::hit_rate);
+  py::class_<SubexpressionMemo>(m, "SubexpressionMemo")
+  .def(py::init<std::size_t>(), py::arg("capacity_bytes") = 256 << 20)
+  .def("clear", &SubexpressionMemo::clear)
+  .def("statistics", &SubexpressionMemo::statistics)
+  .def("reset_statistics", &SubexpressionMemo::reset_statistics);
+  py::class_<JitOptions>(m, "JitOptions")
+  .def(py::init<>())
+  .def_readwrite("compiler", &JitOptions::compiler)
+  .def_readwrite("flags", &JitOptions::flags)
+  .def_readwrite("cache_directory", &JitOptions::cache_directory);
   py::class_<AcyclicGraph>(m, "AcyclicGraph")
   .def(py::init<>())
   .def(py::init<AcyclicGraph &>())
@@ -87,10 +199,19 @@ PYBIND11_MODULE(bingocpp, m) {
   .def("needs_optimization", &AcyclicGraph::needs_optimization)
   .def("set_constants", &AcyclicGraph::set_constants)
   .def("count_constants", &AcyclicGraph::count_constants)
+  .def("compile_native", &AcyclicGraph::compile_native,
+       py::arg("options") = JitOptions())
+  .def("enable_evaluation_cache", &AcyclicGraph::enable_evaluation_cache)
 //   .def("input_constants", &AcyclicGraph::input_constants)
-  .def("evaluate", &AcyclicGraph::evaluate)
-  .def("evaluate_deriv", &AcyclicGraph::evaluate_deriv)
-  .def("evaluate_with_const_deriv", &AcyclicGraph::evaluate_with_const_deriv)
+  .def("evaluate",
+       (Eigen::ArrayXXd (AcyclicGraph::*)(Eigen::ArrayXXd&))
+       &AcyclicGraph::evaluate)
+  .def("evaluate_deriv",
+       (std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd> (AcyclicGraph::*)(
+          Eigen::ArrayXXd&)) &AcyclicGraph::evaluate_deriv)
+  .def("evaluate_with_const_deriv",
+       (std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd> (AcyclicGraph::*)(
+          Eigen::ArrayXXd&)) &AcyclicGraph::evaluate_with_const_deriv)
   .def("latexstring", &AcyclicGraph::latexstring)
   .def("utilized_commands", &AcyclicGraph::utilized_commands)
   .def("complexity", &AcyclicGraph::complexity)
@@ -100,13 +221,39 @@ PYBIND11_MODULE(bingocpp, m) {
        py::arg("nvars") = 3, py::arg("ag_size") = 15, py::arg("nloads") = 1,
        py::arg("float_lim") = 10.0, py::arg("terminal_prob") = 0.1,
        py::arg("opt_rate") = 0)
+  .def_readwrite("rng", &AcyclicGraphManipulator::rng)
+  .def_readwrite("eliminate_common_subexpressions",
+                 &AcyclicGraphManipulator::eliminate_common_subexpressions)
+  .def_readwrite("rewrite_identities",
+                 &AcyclicGraphManipulator::rewrite_identities)
+  .def_readwrite("inherit_equivalent_fitness",
+                 &AcyclicGraphManipulator::inherit_equivalent_fitness)
   .def("add_node_type", &AcyclicGraphManipulator::add_node_type)
   .def("generate", &AcyclicGraphManipulator::generate)
+  .def("generate_batch",
+       (Population (AcyclicGraphManipulator::*)(int))
+       &AcyclicGraphManipulator::generate_batch)
+  .def("generate_batch",
+       (Population (AcyclicGraphManipulator::*)(int, ThreadPool&))
+       &AcyclicGraphManipulator::generate_batch,
+       py::call_guard<py::gil_scoped_release>())
   .def("simplify_stack", &AcyclicGraphManipulator::simplify_stack)
   .def("dump", &AcyclicGraphManipulator::dump)
   .def("load", &AcyclicGraphManipulator::load)
-  .def("crossover", &AcyclicGraphManipulator::crossover)
-  .def("mutation", &AcyclicGraphManipulator::mutation)
+  .def("crossover",
+       (std::vector<AcyclicGraph> (AcyclicGraphManipulator::*)(
+          AcyclicGraph&, AcyclicGraph&)) &AcyclicGraphManipulator::crossover)
+  .def("crossover_into",
+       (void (AcyclicGraphManipulator::*)(AcyclicGraph&, AcyclicGraph&,
+                                          AcyclicGraph&, AcyclicGraph&))
+       &AcyclicGraphManipulator::crossover)
+  .def("mutation",
+       (AcyclicGraph (AcyclicGraphManipulator::*)(AcyclicGraph&))
+       &AcyclicGraphManipulator::mutation)
+  .def("mutation_into",
+       (void (AcyclicGraphManipulator::*)(AcyclicGraph&, AcyclicGraph&))
+       &AcyclicGraphManipulator::mutation)
+  .def("inherit_fitness", &AcyclicGraphManipulator::inherit_fitness)
   .def("distance", &AcyclicGraphManipulator::distance)
   .def("rand_operator_params", &AcyclicGraphManipulator::rand_operator_params)
   .def("rand_operator_type", &AcyclicGraphManipulator::rand_operator_type)
@@ -114,10 +261,75 @@ PYBIND11_MODULE(bingocpp, m) {
   .def("rand_terminal_param", &AcyclicGraphManipulator::rand_operator_params)
   .def("mutate_terminal_param", &AcyclicGraphManipulator::rand_operator_type)
   .def("rand_terminal", &AcyclicGraphManipulator::rand_operator);
+  py::class_<Population>(m, "Population")
+  .def(py::init<int, int>(), py::arg("pop_size") = 0,
+       py::arg("stack_size") = 0)
+  .def_readwrite("fitness", &Population::fitness)
+  .def_readwrite("genetic_age", &Population::genetic_age)
+  .def("size", &Population::size)
+  .def("stack_size", &Population::stack_size)
+  .def("num_constants", &Population::num_constants)
+  .def("set_constants", &Population::set_constants)
+  .def("individual", &Population::individual)
+  .def("set_individual", &Population::set_individual)
+  .def("copy_individual", &Population::copy_individual)
+  .def("set_command", &Population::set_command)
+  .def("crossover", &Population::crossover);
+  py::enum_<MigrationTopology>(m, "MigrationTopology")
+  .value("RING_MIGRATION", RING_MIGRATION)
+  .value("RANDOM_MIGRATION", RANDOM_MIGRATION)
+  .value("FULLY_CONNECTED_MIGRATION", FULLY_CONNECTED_MIGRATION);
+  py::enum_<MigrantSelection>(m, "MigrantSelection")
+  .value("BEST_MIGRANTS", BEST_MIGRANTS)
+  .value("RANDOM_MIGRANTS", RANDOM_MIGRANTS);
+  py::class_<Island>(m, "Island")
+  .def(py::init<const std::vector<AcyclicGraph>&,
+       const AcyclicGraphManipulator&, FitnessMetric&, TrainingData&>(),
+       py::keep_alive<1, 4>(), py::keep_alive<1, 5>())
+  .def_readwrite("population", &Island::population)
+  .def_readwrite("manipulator", &Island::manipulator)
+  .def_readwrite("crossover_probability", &Island::crossover_probability)
+  .def_readwrite("mutation_probability", &Island::mutation_probability)
+  .def_readonly("generation", &Island::generation)
+  .def_readonly("fitness_evaluations", &Island::fitness_evaluations)
+  .def("evaluate", (void (Island::*)(ThreadPool&)) &Island::evaluate,
+       py::call_guard<py::gil_scoped_release>())
+  .def("step", &Island::step, py::call_guard<py::gil_scoped_release>())
+  .def("best_individual", &Island::best_individual);
+  py::class_<Archipelago>(m, "Archipelago")
+  .def(py::init<const std::vector<Island>&, MigrationTopology, int, int,
+       uint64_t>(), py::arg("islands"),
+       py::arg("topology") = RING_MIGRATION,
+       py::arg("migration_interval") = 10, py::arg("num_migrants") = 1,
+       py::arg("seed") = 0, py::keep_alive<1, 2>())
+  .def_readwrite("islands", &Archipelago::islands)
+  .def_readwrite("topology", &Archipelago::topology)
+  .def_readwrite("migrant_selection", &Archipelago::migrant_selection)
+  .def_readwrite("migration_interval", &Archipelago::migration_interval)
+  .def_readwrite("num_migrants", &Archipelago::num_migrants)
+  .def("evolve", &Archipelago::evolve,
+       py::call_guard<py::gil_scoped_release>())
+  .def("migrate", &Archipelago::migrate,
+       py::call_guard<py::gil_scoped_release>())
+  .def("fitness_evaluations", &Archipelago::fitness_evaluations)
+  .def("best_individual", &Archipelago::best_individual);
+  py::class_<FitnessCache>(m, "FitnessCache")
+  .def(py::init<std::size_t>(), py::arg("capacity") = 1 << 16)
+  .def("clear", &FitnessCache::clear)
+  .def("size", &FitnessCache::size)
+  .def("hits", &FitnessCache::hits)
+  .def("misses", &FitnessCache::misses);
   py::class_<FitnessMetric>(m, "FitnessMetric")
   //  .def(py::init<>())
+  .def_readwrite("memo", &FitnessMetric::memo)
+  .def_readwrite("fitness_cache", &FitnessMetric::fitness_cache)
   .def("evaluate_fitness", &FitnessMetric::evaluate_fitness)
-  .def("optimize_constants", &FitnessMetric::optimize_constants);
+  .def("optimize_constants",
+       (void (FitnessMetric::*)(AcyclicGraph&, TrainingData&))
+       &FitnessMetric::optimize_constants)
+  .def("evaluate_population_fitness",
+       &FitnessMetric::evaluate_population_fitness,
+       py::call_guard<py::gil_scoped_release>());
   py::class_<StandardRegression, FitnessMetric>(m, "StandardRegression")
   .def(py::init<>())
   .def("evaluate_fitness_vector", &StandardRegression::evaluate_fitness_vector);
@@ -126,7 +338,12 @@ PYBIND11_MODULE(bingocpp, m) {
        py::arg("required_params") = 0, py::arg("normalize_dot") = false,
        py::arg("acceptable_nans") = 0.1)
   .def("evaluate_fitness_vector", &ImplicitRegression::evaluate_fitness_vector);
-  py::class_<TrainingData>(m, "TrainingData");
+  py::class_<TrainingData>(m, "TrainingData")
+  .def_property("dataset_id",
+                [](TrainingData &train) { return train.dataset_id.load(); },
+                [](TrainingData &train, uint64_t id) {
+                  train.dataset_id = id;
+                });
   py::class_<ExplicitTrainingData, TrainingData>(m, "ExplicitTrainingData")
   .def_readwrite("x", &ExplicitTrainingData::x)
   .def_readwrite("y", &ExplicitTrainingData::y)
@@ -82,10 +82,28 @@ void run_benchmarks(const BenchMarkTestData &benchmark_test_data) {
   Eigen::ArrayXd evaluate_times = time_benchmark(benchmark_evaluate, benchmark_test_data);
   Eigen::ArrayXd x_derivative_times = time_benchmark(benchmark_evaluate_w_x_derivative, benchmark_test_data);
   Eigen::ArrayXd c_derivative_times = time_benchmark(benchmark_evaluate_w_c_derivative, benchmark_test_data);
+  Eigen::ArrayXd pop_evaluate_times = time_benchmark(benchmark_evaluate_population, benchmark_test_data);
+  Eigen::ArrayXd pop_x_derivative_times = time_benchmark(benchmark_evaluate_population_w_x_derivative, benchmark_test_data);
+  Eigen::ArrayXd pop_c_derivative_times = time_benchmark(benchmark_evaluate_population_w_c_derivative, benchmark_test_data);
+  Eigen::ArrayXd par_evaluate_times = time_benchmark(benchmark_parallel_evaluate, benchmark_test_data);
+  Eigen::ArrayXd par_x_derivative_times = time_benchmark(benchmark_parallel_evaluate_w_x_derivative, benchmark_test_data);
+  Eigen::ArrayXd par_c_derivative_times = time_benchmark(benchmark_parallel_evaluate_w_c_derivative, benchmark_test_data);
+  Eigen::ArrayXd bytecode_evaluate_times = time_benchmark(benchmark_evaluate_bytecode, benchmark_test_data);
+  Eigen::ArrayXd native_evaluate_times = time_benchmark(benchmark_evaluate_native, benchmark_test_data);
+  Eigen::ArrayXd native_c_derivative_times = time_benchmark(benchmark_evaluate_native_w_c_derivative, benchmark_test_data);
   print_header();
   print_results(evaluate_times, EVALUATE);
   print_results(x_derivative_times, X_DERIVATIVE);
   print_results(c_derivative_times, C_DERIVATIVE);
+  print_results(pop_evaluate_times, POP_EVALUATE);
+  print_results(pop_x_derivative_times, POP_X_DERIVATIVE);
+  print_results(pop_c_derivative_times, POP_C_DERIVATIVE);
+  print_results(par_evaluate_times, PAR_EVALUATE);
+  print_results(par_x_derivative_times, PAR_X_DERIVATIVE);
+  print_results(par_c_derivative_times, PAR_C_DERIVATIVE);
+  print_results(bytecode_evaluate_times, BYTECODE_EVALUATE);
+  print_results(native_evaluate_times, NATIVE_EVALUATE);
+  print_results(native_c_derivative_times, NATIVE_C_DERIVATIVE);
 }
 
 Eigen::ArrayXd time_benchmark(
@@ -104,6 +122,22 @@ Eigen::ArrayXd time_benchmark(
   return times; 
 }
 
+Eigen::ArrayXd time_benchmark(
+  void (*benchmark)(const PopulationValues&, const Eigen::ArrayXXd&),
+  const BenchMarkTestData &test_data, int number, int repeat) {
+  Eigen::ArrayXd times = Eigen::ArrayXd(repeat);
+  for (int run=0; run<repeat; run++) {
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i=0; i<number; i++) {
+      benchmark(test_data.population, test_data.x_vals);
+    }
+    auto stop = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double, std::ratio<1, 1>> time_span = (stop - start);
+    times(run) = time_span.count();
+  }
+  return times;
+}
+
 void benchmark_evaluate(const std::vector<AGraphValues> &indv_list,
                         const Eigen::ArrayXXd &x_vals) {
   std::vector<AGraphValues>::const_iterator indv;
@@ -136,6 +170,89 @@ void benchmark_evaluate_w_c_derivative(const std::vector<AGraphValues> &indv_lis
   }
 }
 
+void benchmark_evaluate_population(const PopulationValues &population,
+                                   const Eigen::ArrayXXd &x_vals) {
+  bingo::evaluate_population(population.stacks, x_vals, population.constants);
+}
+
+void benchmark_evaluate_population_w_x_derivative(
+    const PopulationValues &population, const Eigen::ArrayXXd &x_vals) {
+  bingo::evaluate_population_with_derivative(population.stacks,
+                                             x_vals,
+                                             population.constants,
+                                             true);
+}
+
+void benchmark_evaluate_population_w_c_derivative(
+    const PopulationValues &population, const Eigen::ArrayXXd &x_vals) {
+  bingo::evaluate_population_with_derivative(population.stacks,
+                                             x_vals,
+                                             population.constants,
+                                             false);
+}
+
+void benchmark_parallel_evaluate(const PopulationValues &population,
+                                 const Eigen::ArrayXXd &x_vals) {
+  bingo::evaluate_population(population.stacks, x_vals, population.constants,
+                             benchmark_pool());
+}
+
+void benchmark_parallel_evaluate_w_x_derivative(
+    const PopulationValues &population, const Eigen::ArrayXXd &x_vals) {
+  bingo::evaluate_population_with_derivative(population.stacks,
+                                             x_vals,
+                                             population.constants,
+                                             benchmark_pool(),
+                                             true);
+}
+
+void benchmark_parallel_evaluate_w_c_derivative(
+    const PopulationValues &population, const Eigen::ArrayXXd &x_vals) {
+  bingo::evaluate_population_with_derivative(population.stacks,
+                                             x_vals,
+                                             population.constants,
+                                             benchmark_pool(),
+                                             false);
+}
+
+void benchmark_evaluate_bytecode(const PopulationValues &population,
+                                 const Eigen::ArrayXXd &x_vals) {
+  for (std::size_t i = 0; i < population.programs.size(); ++i) {
+    bingo::evaluate(population.programs[i], x_vals, population.constants[i]);
+  }
+}
+
+void benchmark_evaluate_native(const PopulationValues &population,
+                               const Eigen::ArrayXXd &x_vals) {
+  for (std::size_t i = 0; i < population.kernels.size(); ++i) {
+    if (population.kernels[i]) {
+      bingo::evaluate(*population.kernels[i], x_vals, population.constants[i]);
+    } else {
+      bingo::evaluate(population.programs[i], x_vals, population.constants[i]);
+    }
+  }
+}
+
+void benchmark_evaluate_native_w_c_derivative(
+    const PopulationValues &population, const Eigen::ArrayXXd &x_vals) {
+  for (std::size_t i = 0; i < population.kernels.size(); ++i) {
+    if (population.kernels[i]) {
+      bingo::evaluate_with_derivative(*population.kernels[i], x_vals,
+                                      population.constants[i], false);
+    } else {
+      bingo::simplify_and_evaluate_with_derivative(population.stacks[i],
+                                                   x_vals,
+                                                   population.constants[i],
+                                                   false);
+    }
+  }
+}
+
+bingo::ThreadPool &benchmark_pool() {
+  static bingo::ThreadPool pool;
+  return pool;
+}
+
 void print_header() {
   const std::string top_tacks = std::string(23, '-');
   const std::string title = ":::: PERFORMANCE BENCHMARKS ::::";
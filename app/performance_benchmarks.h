@@ -13,10 +13,21 @@
 #include <Eigen/Core>
 
 #include "BingoCpp/backend.h"
+#include "BingoCpp/jit.h"
+#include "BingoCpp/thread_pool.h"
 
 #define EVALUATE "pure c++: evaluate"
 #define X_DERIVATIVE "pure c++: x derivative"
 #define C_DERIVATIVE "pure c++: c derivative"
+#define POP_EVALUATE "pure c++: pop evaluate"
+#define POP_X_DERIVATIVE "pure c++: pop x derivative"
+#define POP_C_DERIVATIVE "pure c++: pop c derivative"
+#define PAR_EVALUATE "pure c++: par evaluate"
+#define PAR_X_DERIVATIVE "pure c++: par x derivative"
+#define PAR_C_DERIVATIVE "pure c++: par c derivative"
+#define BYTECODE_EVALUATE "pure c++: bytecode evaluate"
+#define NATIVE_EVALUATE "pure c++: native evaluate"
+#define NATIVE_C_DERIVATIVE "pure c++: native c derivative"
 #define STACK_FILE "test-agraph-stacks.csv"
 #define CONST_FILE "test-agraph-consts.csv"
 #define X_FILE "test-agraph-x-vals.csv"
@@ -30,12 +41,27 @@ struct AGraphValues {
   Eigen::VectorXd constants;
 };
 
+struct PopulationValues {
+  std::vector<Eigen::ArrayX3i> stacks;
+  std::vector<Eigen::VectorXd> constants;
+  std::vector<bingo::Program> programs;
+  std::vector<std::shared_ptr<const bingo::JitKernel> > kernels;
+};
+
 struct BenchMarkTestData {
   std::vector<AGraphValues> indv_list;
+  PopulationValues population;
   Eigen::ArrayXXd x_vals;
   BenchMarkTestData() {}
   BenchMarkTestData(std::vector<AGraphValues> &il, Eigen::ArrayXXd &x):
-    indv_list(il), x_vals(x) {}
+    indv_list(il), x_vals(x) {
+    for (std::size_t i = 0; i < il.size(); ++i) {
+      population.stacks.push_back(il[i].command_array);
+      population.constants.push_back(il[i].constants);
+      population.programs.push_back(bingo::compile_stack(il[i].command_array));
+      population.kernels.push_back(bingo::jit_compile(il[i].command_array));
+    }
+  }
 };
 
 void do_benchmarking();
@@ -54,6 +80,28 @@ void benchmark_evaluate_w_x_derivative(const std::vector<AGraphValues> &indv_lis
                                        const Eigen::ArrayXXd &x_vals);
 void benchmark_evaluate_w_c_derivative(const std::vector<AGraphValues> &indv_list,
                                        const Eigen::ArrayXXd &x_vals);
+Eigen::ArrayXd time_benchmark(
+  void (*benchmark)(const PopulationValues&, const Eigen::ArrayXXd&),
+  const BenchMarkTestData &test_data, int number=100, int repeat=10);
+void benchmark_evaluate_population(const PopulationValues &population,
+                                   const Eigen::ArrayXXd &x_vals);
+void benchmark_evaluate_population_w_x_derivative(
+  const PopulationValues &population, const Eigen::ArrayXXd &x_vals);
+void benchmark_evaluate_population_w_c_derivative(
+  const PopulationValues &population, const Eigen::ArrayXXd &x_vals);
+void benchmark_parallel_evaluate(const PopulationValues &population,
+                                 const Eigen::ArrayXXd &x_vals);
+void benchmark_parallel_evaluate_w_x_derivative(
+  const PopulationValues &population, const Eigen::ArrayXXd &x_vals);
+void benchmark_parallel_evaluate_w_c_derivative(
+  const PopulationValues &population, const Eigen::ArrayXXd &x_vals);
+void benchmark_evaluate_bytecode(const PopulationValues &population,
+                                 const Eigen::ArrayXXd &x_vals);
+void benchmark_evaluate_native(const PopulationValues &population,
+                               const Eigen::ArrayXXd &x_vals);
+void benchmark_evaluate_native_w_c_derivative(
+  const PopulationValues &population, const Eigen::ArrayXXd &x_vals);
+bingo::ThreadPool &benchmark_pool();
 void print_header();
 void print_results(const Eigen::ArrayXd &run_times, const std::string &name);
 std::string string_precision(double val, int precision);
@@ -11,15 +11,18 @@
 
 #include <stdio.h>
 #include <math.h>
+#include <time.h>
 
 #include <iostream>
 #include <set>
 #include <vector>
 #include <string>
 #include <sstream>
+#include <utility>
 #include "BingoCpp/graph_manip.h"
 #include "BingoCpp/training_data.h"
 #include "BingoCpp/fitness_metric.h"
+#include "BingoCpp/thread_pool.h"
 
 int cross_useful;
 int not_useful;
@@ -28,25 +31,28 @@ using namespace bingo;
 class Island {
  public:
   Island(std::vector<AcyclicGraph> p, AcyclicGraphManipulator m,
-         StandardRegression, ExplicitTrainingData t);
+         StandardRegression, ExplicitTrainingData t, ThreadPool *tp);
   int age;
   int fit_eval;
   std::vector<AcyclicGraph> pop;
   AcyclicGraphManipulator manip;
   StandardRegression fit;
   ExplicitTrainingData train;
+  ThreadPool *pool;
   void step();
   std::vector<double> fit_func(AcyclicGraph ind);
+  void fit_population(std::vector<AcyclicGraph> &inds);
 };
 
 Island::Island(std::vector<AcyclicGraph> p, AcyclicGraphManipulator m,
-               StandardRegression f, ExplicitTrainingData t) {
+               StandardRegression f, ExplicitTrainingData t, ThreadPool *tp) {
   age = 0;
   fit_eval = 0;
-  pop = p;
+  pop = std::move(p);
   manip = m;
   fit = f;
   train = t;
+  pool = tp;
 }
 
 std::vector<double> Island::fit_func(AcyclicGraph ind) {
@@ -62,17 +68,51 @@ std::vector<double> Island::fit_func(AcyclicGraph ind) {
   return fitv;
 }
 
+void Island::fit_population(std::vector<AcyclicGraph> &inds) {
+  std::vector<int> unset;
+  std::vector<AcyclicGraph> batch;
+
+  for (std::size_t i = 0; i < inds.size(); ++i) {
+    if (!inds[i].fit_set) {
+      unset.push_back(i);
+      batch.push_back(inds[i]);
+    }
+  }
+
+  std::list<int> items;
+
+  for (int i = 0; i < 15; ++i) {
+    items.push_back(i * 2);
+  }
+
+  ExplicitTrainingData *data = train.get_item(items);
+  std::vector<double> fitness = fit.evaluate_population_fitness(batch, *data,
+                                *pool);
+  delete data;
+
+  for (std::size_t i = 0; i < unset.size(); ++i) {
+    AcyclicGraph &ind = inds[unset[i]];
+    ind = std::move(batch[i]);
+    ind.fitness = std::vector<double>(1, fitness[i]);
+    ind.fit_set = true;
+    ++fit_eval;
+  }
+}
+
 void Island::step() {
   ++age;
   float cx = .7;
   float mut = .01;
+  // parent 1, parent 2, child 1 and child 2 of every pair
+  std::vector<AcyclicGraph> family;
+  family.reserve(2 * pop.size());
 
   for (int i = 0, j = pop.size() / 2; i < pop.size() / 2; ++i, ++j) {
     AcyclicGraph p1 = pop[i];
     AcyclicGraph p2 = pop[j];
-    float r1 = static_cast <float> (rand()) / static_cast < float> (RAND_MAX);
-    float r2 = static_cast <float> (rand()) / static_cast < float> (RAND_MAX);
-    float r3 = static_cast <float> (rand()) / static_cast < float> (RAND_MAX);
+    float r1 = manip.rng.uniform_float();
+    float r2 = manip.rng.uniform_float();
+    float r3 = manip.rng.uniform_float();
     bool docx = r1 <= cx;
     bool domut1 = r2 <= mut;
     bool domut2 = r3 <= mut;
@@ -81,12 +121,12 @@ void Island::step() {
 
     if (docx) {
       std::vector<AcyclicGraph> vec = manip.crossover(p1, p2);
-      c1 = vec[0];
-      c2 = vec[1];
+      c1 = std::move(vec[0]);
+      c2 = std::move(vec[1]);
 
     } else {
-      c1 = p1.copy();
-      c2 = p2.copy();
+      c1 = p1;
+      c2 = p2;
     }
 
     if (domut1) {
@@ -94,36 +134,25 @@ void Island::step() {
       c2 = manip.mutation(c2);
     }
 
-    if (!p1.fit_set) {
-      p1.fitness = fit_func(p1);
-      p1.fit_set = true;
-      ++fit_eval;
-    }
-
-    if (!p2.fit_set) {
-      p2.fitness = fit_func(p2);
-      p2.fit_set = true;
-      ++fit_eval;
-    }
-
-    if (!c1.fit_set) {
-      c1.fitness = fit_func(c1);
-      c1.fit_set = true;
-      ++fit_eval;
-    }
+    family.push_back(std::move(p1));
+    family.push_back(std::move(p2));
+    family.push_back(std::move(c1));
+    family.push_back(std::move(c2));
+  }
 
-    if (!c2.fit_set) {
-      c2.fitness = fit_func(c2);
-      c2.fit_set = true;
-      ++fit_eval;
-    }
+  fit_population(family);
 
+  for (std::size_t i = 0, j = pop.size() / 2; i < pop.size() / 2; ++i, ++j) {
+    AcyclicGraph &p1 = family[4 * i];
+    AcyclicGraph &p2 = family[4 * i + 1];
+    AcyclicGraph &c1 = family[4 * i + 2];
+    AcyclicGraph &c2 = family[4 * i + 3];
     int dis1 = manip.distance(p1, c1) + manip.distance(p2, c2);
     int dis2 = manip.distance(p1, c2) + manip.distance(p2, c1);
 
     if (dis1 <= dis2) {
       if (c1.fitness[0] <= p1.fitness[0]) {
-        pop[i] = c1;
+        pop[i] = std::move(c1);
         cross_useful++;
 
       } else {
@@ -131,7 +160,7 @@ void Island::step() {
       }
 
       if (c2.fitness[0] <= p2.fitness[0]) {
-        pop[j] = c2;
+        pop[j] = std::move(c2);
         cross_useful++;
 
       } else {
@@ -140,7 +169,7 @@ void Island::step() {
 
     } else {
       if (c2.fitness[0] <= p1.fitness[0]) {
-        pop[i] = c2;
+        pop[i] = std::move(c2);
         cross_useful++;
 
       } else {
@@ -148,7 +177,7 @@ void Island::step() {
       }
 
       if (c1.fitness[0] <= p2.fitness[0]) {
-        pop[j] = c1;
+        pop[j] = std::move(c1);
         cross_useful++;
 
       } else {
@@ -1170,6 +1199,7 @@ int main() {
 //   AcyclicGraphManipulator manip = AcyclicGraphManipulator(x.cols(), 64, 2);
   AcyclicGraphManipulator manip = AcyclicGraphManipulator(x.cols(), 64, 2, 10.0,
                                   .1, 0);
+  manip.rng.seed(time(NULL));
   StandardRegression stan = StandardRegression();
   ExplicitTrainingData train = ExplicitTrainingData(x, y);
   manip.add_node_type(2);
@@ -1192,7 +1222,8 @@ int main() {
 
   not_useful = 0;
   cross_useful = 0;
-  Island is = Island(pops, manip, stan, train);
+  ThreadPool pool;
+  Island is = Island(pops, manip, stan, train, &pool);
 
   for (int i = 0; i < 5; ++i) {
     is.step();
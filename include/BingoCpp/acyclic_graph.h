@@ -26,11 +26,17 @@
 #ifndef INCLUDE_BINGOCPP_ACYCLIC_GRAPH_H_
 #define INCLUDE_BINGOCPP_ACYCLIC_GRAPH_H_
 
+#include <memory>
 #include <set>
 
 #include <Eigen/Dense>
 #include <Eigen/Core>
 
+#include "BingoCpp/backend.h"
+#include "BingoCpp/bytecode.h"
+#include "BingoCpp/jit.h"
+#include "BingoCpp/thread_pool.h"
+
 namespace bingo {
 
 /*! \class AcyclicGraph
@@ -41,10 +47,14 @@ namespace bingo {
  *        Multiplication, Division, sin, cos, exp, log, pow, abs, sqrt
  *
  *  \fn bool needs_optimization()
+ *  \fn void enable_evaluation_cache()
  *  \fn void set_constants(Eigen::VectorXd con)
  *  \fn int count_constants()
+ *  \fn const Program &compiled_program()
  *  \fn Eigen::ArrayXXd evaluate(Eigen::ArrayXXd &eval_x)
  *  \fn std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd> evaluate_deriv(Eigen::ArrayXXd &eval_x)
+ *  \fn Eigen::ArrayXXd evaluate(Eigen::ArrayXXd &eval_x, ThreadPool &pool)
+ *  \fn std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd> evaluate_deriv(Eigen::ArrayXXd &eval_x, ThreadPool &pool)
  *  \fn std::string latexstring()
  *  \fn std::set<int> utilized_commands()
  *  \fn int complexity()
@@ -84,6 +94,17 @@ class AcyclicGraph {
   //! int genetic_age
   /*! holds genetic age of individual */
   int genetic_age;
+  //! std::shared_ptr<const Program> program
+  /*! simple_stack compiled to bytecode, shared by copies of the individual */
+  std::shared_ptr<const Program> program;
+  //! std::shared_ptr<const JitKernel> native_kernel
+  /*! simple_stack compiled to native code by compile_native, if any */
+  std::shared_ptr<const JitKernel> native_kernel;
+  //! std::shared_ptr<EvaluationCache> evaluation_cache
+  /*! values of the commands of stack from the last serial evaluation, kept
+   *  once enable_evaluation_cache is called; copies share it until one of
+   *  them is evaluated */
+  std::shared_ptr<EvaluationCache> evaluation_cache;
 
   
     
@@ -91,6 +112,12 @@ class AcyclicGraph {
   AcyclicGraph();
   //! \brief Copy constructor
   AcyclicGraph(const AcyclicGraph &ag);
+  //! \brief Move constructor
+  AcyclicGraph(AcyclicGraph &&ag) noexcept;
+  //! \brief Copy assignment
+  AcyclicGraph &operator=(const AcyclicGraph &ag);
+  //! \brief Move assignment
+  AcyclicGraph &operator=(AcyclicGraph &&ag) noexcept;
   //! \brief Copies self (for pybind)
   AcyclicGraph copy();
   /*! \brief find out whether constants need optimization
@@ -105,7 +132,12 @@ class AcyclicGraph {
   void set_constants(Eigen::VectorXd con);
   /*! \brief returns constants.size()
    *
-   *  \return int the size of the constants vector
+   *  With opt_rate 0 the utilized constants of stack are first numbered in
+   *  stack order, and so are those of simple_stack unless it was merged or
+   *  rewritten, in which case they were numbered before.
+   *
+   *  \return int the size of the constants vector, or the number of
+   *          utilized constants with opt_rate 0
    */
   int count_constants();
   /*! \brief replaces -1 in stack with location in constants vector
@@ -113,6 +145,29 @@ class AcyclicGraph {
    *  \return void
    */
   // void input_constants();
+  /*! \brief gets simple_stack compiled to bytecode
+   *
+   *  The program is compiled on first use and again whenever simple_stack
+   *  no longer matches the stack it was compiled from.
+   *
+   *  \return const Program& the compiled simple_stack
+   */
+  const Program &compiled_program();
+  /*! \brief compiles simple_stack to native code
+   *
+   *  Serial evaluation uses the native kernel while simple_stack matches it.
+   *
+   *  \param[in] options Compiler and cache settings. JitOptions
+   *  \return true if a native kernel is available
+   */
+  bool compile_native(const JitOptions &options = JitOptions());
+  /*! \brief keeps the value of every command between serial evaluations
+   *
+   *  Serial evaluation then goes through evaluate_incremental on stack, so
+   *  an individual copied from an evaluated parent and mutated only
+   *  recomputes the commands downstream of the mutation.
+   */
+  void enable_evaluation_cache();
   /*! \brief evaluate the compiled stack
    *
    *  \param[in] eval_x The x parameters. Eigen::ArrayXXd
@@ -128,6 +183,23 @@ class AcyclicGraph {
     Eigen::ArrayXXd &eval_x);
   std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd> evaluate_deriv(
     Eigen::ArrayXXd &eval_x);
+  /*! \brief evaluate the compiled stack with the samples split across threads
+   *
+   *  \param[in] eval_x The x parameters. Eigen::ArrayXXd
+   *  \param[in] pool The threads sharing the samples. ThreadPool
+   *  \return Eigen::ArrayXXd of evaluated stack
+   */
+  Eigen::ArrayXXd evaluate(Eigen::ArrayXXd &eval_x, ThreadPool &pool);
+  /*! \brief evaluate the compiled stack with the samples split across threads
+   *
+   *  \param[in] eval_x The x parameters. Eigen::ArrayXXd
+   *  \param[in] pool The threads sharing the samples. ThreadPool
+   *  \return std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd> of evaluated deriv stack
+   */
+  std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd>evaluate_with_const_deriv(
+    Eigen::ArrayXXd &eval_x, ThreadPool &pool);
+  std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd> evaluate_deriv(
+    Eigen::ArrayXXd &eval_x, ThreadPool &pool);
   /*! \brief conversion to simplified latex string
    *
    *  \return the latexstring representation of the stack
@@ -24,7 +24,202 @@
 #include <Eigen/Dense>
 #include <Eigen/Core>
 
+#include "BingoCpp/bytecode.h"
+#include "BingoCpp/thread_pool.h"
+
 namespace bingo {
+/*! \struct BufferAllocation
+ *
+ *  Assignment of the commands of a stack to a small pool of recycled buffers.
+ *
+ *  A command's buffer is returned to the pool after the last command that
+ *  reads it, in the same way a register allocator treats live ranges.  The
+ *  number of buffers is therefore the maximum number of simultaneously live
+ *  values rather than the depth of the stack.
+ */
+struct BufferAllocation {
+  //! std::vector<int> buffer_index
+  /*! buffer holding each command, -1 for commands that are not evaluated */
+  std::vector<int> buffer_index;
+  //! int num_buffers
+  /*! number of distinct buffers needed */
+  int num_buffers;
+  //! std::vector<int> last_use
+  /*! scratch: last command reading each command */
+  std::vector<int> last_use;
+  //! std::vector<int> free_buffers
+  /*! scratch: buffers available for reuse */
+  std::vector<int> free_buffers;
+
+  BufferAllocation() : num_buffers(0) {}
+};
+
+/*! \struct ConstantFolding
+ *
+ *  Sample-invariant commands of a stack, evaluated once on scalars.
+ *
+ *  A command is sample-invariant when it reads constants only.  Rather than
+ *  computing such a command for every sample, it is evaluated once and its
+ *  value is broadcast where a sample-dependent command reads it: in stack,
+ *  each invariant command read by a sample-dependent command (or ending the
+ *  stack) becomes a load of a folded constant, appended to constants after
+ *  the constants of the original stack, and the invariant commands feeding it
+ *  are dropped from mask.  Row i of jacobian is the derivative of folded
+ *  constant i with respect to the original constants, which reduces the
+ *  constant gradient of the folded stack back onto the original constants.
+ */
+struct ConstantFolding {
+  //! Eigen::ArrayX3i stack
+  /*! the stack with invariant commands replaced by folded constants */
+  Eigen::ArrayX3i stack;
+  //! std::vector<bool> mask
+  /*! commands of stack still evaluated per sample */
+  std::vector<bool> mask;
+  //! Eigen::VectorXd constants
+  /*! original constants followed by the folded ones */
+  Eigen::VectorXd constants;
+  //! Eigen::MatrixXd jacobian
+  /*! derivative of the folded constants wrt the original constants */
+  Eigen::MatrixXd jacobian;
+  //! std::vector<int> folded_rows
+  /*! command each folded constant was computed from */
+  std::vector<int> folded_rows;
+  //! std::vector<bool> invariant
+  /*! whether each command of the stack is sample-invariant */
+  std::vector<bool> invariant;
+  //! std::vector<bool> frontier
+  /*! invariant commands whose value is read per sample */
+  std::vector<bool> frontier;
+  //! std::vector<bool> subgraph
+  /*! commands a folded constant is computed from */
+  std::vector<bool> subgraph;
+  //! std::vector<Eigen::ArrayXXd> scalar_eval
+  /*! 1x1 value of each invariant command */
+  std::vector<Eigen::ArrayXXd> scalar_eval;
+  //! std::vector<Eigen::ArrayXXd> scalar_reverse
+  /*! 1x1 adjoint of each invariant command */
+  std::vector<Eigen::ArrayXXd> scalar_reverse;
+  //! Eigen::ArrayXXd derivative
+  /*! gradient wrt the original and folded constants */
+  Eigen::ArrayXXd derivative;
+};
+
+/*! \struct EvaluationWorkspace
+ *
+ *  Reusable buffers for the forward and reverse passes of the backend.
+ *
+ *  Each backend entry point that accepts a workspace writes its results into
+ *  the workspace in place.  Buffers only grow, so once a workspace has seen
+ *  the largest stack and the largest number of samples it will be used with,
+ *  further evaluations do not allocate.  A workspace is not thread safe; each
+ *  thread should own its own.
+ *
+ *  Large inputs are evaluated in tiles of rows: the whole stack is run over
+ *  one tile of samples before moving on to the next, so the intermediate
+ *  values of a tile stay in cache.  tile_size sets the number of rows per
+ *  tile; when it is 0 the tile is sized so that all the buffers of a tile fit
+ *  in L2 cache.
+ *
+ *  Commands which read constants only are evaluated once per evaluation
+ *  rather than once per sample, see ConstantFolding.
+ *
+ *  \fn void reserve(int stack_depth)
+ *  \fn const Eigen::ArrayXXd& result() const
+ */
+struct EvaluationWorkspace {
+  //! std::vector<Eigen::ArrayXXd> forward_eval
+  /*! value of each command in the stack (or of each allocated buffer) */
+  std::vector<Eigen::ArrayXXd> forward_eval;
+  //! std::vector<Eigen::ArrayXXd> reverse_eval
+  /*! adjoint of each command in the stack */
+  std::vector<Eigen::ArrayXXd> reverse_eval;
+  //! Eigen::ArrayXXd derivative
+  /*! gradient from the last derivative evaluation */
+  Eigen::ArrayXXd derivative;
+  //! Eigen::ArrayXXd derivative_tile
+  /*! gradient of the current tile of samples */
+  Eigen::ArrayXXd derivative_tile;
+  //! std::vector<bool> mask
+  /*! utilized commands from the last simplified evaluation */
+  std::vector<bool> mask;
+  //! BufferAllocation allocation
+  /*! buffer assignment used by value-only evaluations */
+  BufferAllocation allocation;
+  //! ConstantFolding folding
+  /*! sample-invariant commands of the last evaluated stack */
+  ConstantFolding folding;
+  //! int result_index
+  /*! location of the result in forward_eval */
+  int result_index;
+  //! int tile_size
+  /*! rows of samples evaluated at a time, 0 to size tiles automatically */
+  int tile_size;
+
+  EvaluationWorkspace() : result_index(0), tile_size(0) {}
+  /*! \brief make sure there is a buffer for every command in a stack
+   *
+   *  \param[in] stack_depth The number of commands in the stack. int
+   */
+  void reserve(int stack_depth);
+  /*! \brief value of the last command of the last evaluated stack
+   *
+   *  \return const Eigen::ArrayXXd& reference into forward_eval
+   */
+  const Eigen::ArrayXXd& result() const {
+    return forward_eval[result_index];
+  }
+};
+
+/*! \struct EvaluationCache
+ *
+ *  Value of every command of a stack, kept from one evaluation to the next.
+ *
+ *  evaluate_incremental compares a stack with the one the buffers were
+ *  computed from and only recomputes the utilized commands which changed,
+ *  read a constant whose value changed, or read a recomputed command.  After
+ *  a mutation of one command that is the commands downstream of it.  The
+ *  values of unused commands are kept while they stay valid, so a command
+ *  which is used again later need not be recomputed either.  All values are
+ *  dropped when x changes.
+ *
+ *  \fn const Eigen::ArrayXXd& result() const
+ */
+struct EvaluationCache {
+  //! Eigen::ArrayX3i stack
+  /*! the stack forward_eval was computed from */
+  Eigen::ArrayX3i stack;
+  //! Eigen::VectorXd constants
+  /*! the constants forward_eval was computed with */
+  Eigen::VectorXd constants;
+  //! Eigen::ArrayXXd x
+  /*! the samples forward_eval was computed at */
+  Eigen::ArrayXXd x;
+  //! std::vector<Eigen::ArrayXXd> forward_eval
+  /*! value of each command of stack */
+  std::vector<Eigen::ArrayXXd> forward_eval;
+  //! std::vector<bool> valid
+  /*! whether each buffer of forward_eval holds the value of its command */
+  std::vector<bool> valid;
+  //! std::vector<bool> mask
+  /*! utilized commands of the stack being evaluated */
+  std::vector<bool> mask;
+  //! std::vector<bool> changed
+  /*! commands whose value changed in the last evaluation */
+  std::vector<bool> changed;
+  //! int num_recomputed
+  /*! number of commands computed by the last evaluation */
+  int num_recomputed;
+
+  EvaluationCache() : stack(0, 3), num_recomputed(0) {}
+  /*! \brief value of the last command of the last evaluated stack
+   *
+   *  \return const Eigen::ArrayXXd& reference into forward_eval
+   */
+  const Eigen::ArrayXXd& result() const {
+    return forward_eval[stack.rows() - 1];
+  }
+};
+
 /*!
  * \brief Identify whether a c++ backend is being used in python module.
  *
@@ -74,6 +269,239 @@ std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd> evaluate_with_derivative(
     const Eigen::VectorXd& constants,
     const bool param_x_or_c = true);
 
+/*!
+ * \brief Evaluates a stack in place using the buffers of a workspace.
+ *
+ * Only the value of the last command is needed, so intermediate values share
+ * recycled buffers (see allocate_buffers) and the peak memory is the maximum
+ * live width of the stack rather than its depth.
+ *
+ * \param stack Description of an acyclic graph in stack format.
+ * \param x The input variables to the acyclic graph. (Eigen::ArrayXXd)
+ * \param constants Vector of the constants used in the stack.
+ * \param workspace Buffers to evaluate into; the value of the last command
+ *                  is available from workspace.result().
+ */
+void evaluate(const Eigen::ArrayX3i& stack,
+              const Eigen::ArrayXXd& x,
+              const Eigen::VectorXd& constants,
+              EvaluationWorkspace& workspace);
+
+/*!
+ * \brief Evaluates a stack and its derivative in place using a workspace.
+ *
+ * The reverse pass reads the forward value of every command, so these are
+ * all retained in their own buffer.
+ *
+ * \param stack Description of an acyclic graph in stack format.
+ * \param x The input variables to the acyclic graph. (Eigen::ArrayXXd)
+ * \param constants Vector of the constants used in the stack.
+ * \param workspace Buffers to evaluate into; the value of the last command
+ *                  is available from workspace.result() and the gradient
+ *                  from workspace.derivative.
+ * \param param_x_or_c true: x derivative, false: c derivative
+ */
+void evaluate_with_derivative(const Eigen::ArrayX3i& stack,
+                              const Eigen::ArrayXXd& x,
+                              const Eigen::VectorXd& constants,
+                              EvaluationWorkspace& workspace,
+                              const bool param_x_or_c = true);
+
+
+/*!
+ * \brief Evaluates a stack, splitting the samples across threads.
+ *
+ * The rows of x are divided into contiguous partitions which are evaluated
+ * on the threads of the pool.  Each row is computed exactly as in the serial
+ * evaluate, so the result does not depend on the number of threads.  Small
+ * inputs are evaluated by a single thread.
+ *
+ * \param stack Description of an acyclic graph in stack format.
+ * \param x The input variables to the acyclic graph. (Eigen::ArrayXXd)
+ * \param constants The constants used in the acyclic graph.
+ * \param pool The threads evaluating the partitions.
+ *
+ * \return The value of the last command in the stack. (Eigen::ArrayXXd)
+ */
+Eigen::ArrayXXd evaluate(const Eigen::ArrayX3i& stack,
+                         const Eigen::ArrayXXd& x,
+                         const Eigen::VectorXd& constants,
+                         ThreadPool& pool);
+
+/*!
+ * \brief Evaluates a stack and its derivative, splitting the samples across
+ *        threads.
+ *
+ * Every partition of the rows of x fills its own rows of the value and of
+ * the derivative, so the result does not depend on the number of threads.
+ *
+ * \param stack Description of an acyclic graph in stack format.
+ * \param x The input variables to the acyclic graph. (Eigen::ArrayXXd)
+ * \param constants The constants used in the acyclic graph.
+ * \param pool The threads evaluating the partitions.
+ * \param param_x_or_c true: x derivative, false: c derivative
+ *
+ * \return The value of the last command in the stack and the gradient.
+ *         (std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd>)
+ */
+std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd> evaluate_with_derivative(
+    const Eigen::ArrayX3i& stack,
+    const Eigen::ArrayXXd& x,
+    const Eigen::VectorXd& constants,
+    ThreadPool& pool,
+    const bool param_x_or_c = true);
+
+/*!
+ * \brief Evaluates the x gradient of a stack and its derivative with respect
+ *        to the constants.
+ *
+ * The utilized commands of the stack are swept forward once, carrying with
+ * the value of each command its first derivatives with respect to x and the
+ * constants and its mixed second derivatives.  This is what the constant
+ * derivative of a fitness defined on the x gradient (e.g. implicit
+ * regression) needs.
+ *
+ * \param stack Description of an acyclic graph in stack format.
+ * \param x The input variables to the acyclic graph. (Eigen::ArrayXXd)
+ * \param constants The constants used in the acyclic graph.
+ *
+ * \return The x gradient of the stack (samples by x.cols()) and its mixed
+ *         derivative (samples by constants.size() * x.cols()), in which the
+ *         block of columns [k * x.cols(), (k + 1) * x.cols()) is the
+ *         derivative of the x gradient with respect to constant k.
+ *         (std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd>)
+ */
+std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd> evaluate_mixed_derivative(
+    const Eigen::ArrayX3i& stack,
+    const Eigen::ArrayXXd& x,
+    const Eigen::VectorXd& constants);
+
+/*!
+ * \brief Evaluates a compiled stack.
+ *
+ * \param program A stack compiled with compile_stack.
+ * \param x The input variables to the acyclic graph. (Eigen::ArrayXXd)
+ * \param constants The constants used in the acyclic graph.
+ *
+ * \return The value of the compiled stack. (Eigen::ArrayXXd)
+ */
+Eigen::ArrayXXd evaluate(const Program& program,
+                         const Eigen::ArrayXXd& x,
+                         const Eigen::VectorXd& constants);
+
+/*!
+ * \brief Evaluates a compiled stack in place using a workspace.
+ *
+ * \param program A stack compiled with compile_stack.
+ * \param x The input variables to the acyclic graph. (Eigen::ArrayXXd)
+ * \param constants The constants used in the acyclic graph.
+ * \param workspace Buffers to evaluate into; the value of the program is
+ *                  available from workspace.result().
+ */
+void evaluate(const Program& program,
+              const Eigen::ArrayXXd& x,
+              const Eigen::VectorXd& constants,
+              EvaluationWorkspace& workspace);
+
+/*!
+ * \brief Evaluates a compiled stack, splitting the samples across threads.
+ *
+ * \param program A stack compiled with compile_stack.
+ * \param x The input variables to the acyclic graph. (Eigen::ArrayXXd)
+ * \param constants The constants used in the acyclic graph.
+ * \param pool The threads evaluating the partitions.
+ *
+ * \return The value of the compiled stack. (Eigen::ArrayXXd)
+ */
+Eigen::ArrayXXd evaluate(const Program& program,
+                         const Eigen::ArrayXXd& x,
+                         const Eigen::VectorXd& constants,
+                         ThreadPool& pool);
+
+/*!
+ * \brief Evaluates the residual of a compiled stack against target values.
+ *
+ * \param program A stack compiled with compile_stack.
+ * \param x The input variables to the acyclic graph. (Eigen::ArrayXXd)
+ * \param constants The constants used in the acyclic graph.
+ * \param y The target value of every sample. (Eigen::ArrayXXd)
+ * \param[out] residual f(x) - y, resized to the number of samples.
+ *
+ * \return The mean absolute residual.
+ */
+double evaluate_residual(const Program& program,
+                         const Eigen::ArrayXXd& x,
+                         const Eigen::VectorXd& constants,
+                         const Eigen::ArrayXXd& y,
+                         Eigen::ArrayXXd& residual);
+
+/*!
+ * \brief Evaluates the residual of a compiled stack with the samples split
+ *        across threads.
+ *
+ * \param program A stack compiled with compile_stack.
+ * \param x The input variables to the acyclic graph. (Eigen::ArrayXXd)
+ * \param constants The constants used in the acyclic graph.
+ * \param y The target value of every sample. (Eigen::ArrayXXd)
+ * \param pool The threads sharing the samples.
+ * \param[out] residual f(x) - y, resized to the number of samples.
+ *
+ * \return The mean absolute residual.
+ */
+double evaluate_residual(const Program& program,
+                         const Eigen::ArrayXXd& x,
+                         const Eigen::VectorXd& constants,
+                         const Eigen::ArrayXXd& y,
+                         ThreadPool& pool,
+                         Eigen::ArrayXXd& residual);
+
+/*!
+ * \brief Evaluates the residual of a stack and its constant derivative.
+ *
+ * The utilized commands are swept forward and then in reverse once per tile
+ * of samples.  The residual, its mean absolute value and the derivative
+ * with respect to the constants come out of the same sweeps, without
+ * intermediate copies of the value of the stack.  The outputs are resized
+ * only when their shape changes, so reusing them across calls does not
+ * allocate.
+ *
+ * \param stack Description of an acyclic graph in stack format.
+ * \param x The input variables to the acyclic graph. (Eigen::ArrayXXd)
+ * \param constants The constants used in the acyclic graph.
+ * \param y The target value of every sample. (Eigen::ArrayXXd)
+ * \param[out] residual f(x) - y, samples by 1.
+ * \param[out] derivative d(residual)/dc, samples by constants.size().
+ *
+ * \return The mean absolute residual.
+ */
+double evaluate_residual_with_derivative(const Eigen::ArrayX3i& stack,
+                                         const Eigen::ArrayXXd& x,
+                                         const Eigen::VectorXd& constants,
+                                         const Eigen::ArrayXXd& y,
+                                         Eigen::ArrayXXd& residual,
+                                         Eigen::ArrayXXd& derivative);
+
+/*!
+ * \brief Evaluates the residual of a stack and its constant derivative with
+ *        the samples split across threads.
+ *
+ * \param stack Description of an acyclic graph in stack format.
+ * \param x The input variables to the acyclic graph. (Eigen::ArrayXXd)
+ * \param constants The constants used in the acyclic graph.
+ * \param y The target value of every sample. (Eigen::ArrayXXd)
+ * \param pool The threads sharing the samples.
+ * \param[out] residual f(x) - y, samples by 1.
+ * \param[out] derivative d(residual)/dc, samples by constants.size().
+ *
+ * \return The mean absolute residual.
+ */
+double evaluate_residual_with_derivative(const Eigen::ArrayX3i& stack,
+                                         const Eigen::ArrayXXd& x,
+                                         const Eigen::VectorXd& constants,
+                                         const Eigen::ArrayXXd& y,
+                                         ThreadPool& pool,
+                                         Eigen::ArrayXXd& residual,
+                                         Eigen::ArrayXXd& derivative);
 
 /*!
  * \brief Evaluates a stack, but only the commands that are utilized.
@@ -111,12 +539,143 @@ std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd> simplify_and_evaluate_with_derivativ
     const Eigen::VectorXd& constants,
     const bool param_x_or_c = true);
 
+/*!
+ * \brief Evaluates only the utilized commands of a stack using a workspace.
+ *
+ * \param stack Description of an acyclic graph in stack format.
+ * \param x The input variables to the acyclic graph. (Eigen::ArrayXXd)
+ * \param constants Vector of the constants used in the stack.
+ * \param workspace Buffers to evaluate into. (EvaluationWorkspace)
+ */
+void simplify_and_evaluate(const Eigen::ArrayX3i& stack,
+                           const Eigen::ArrayXXd& x,
+                           const Eigen::VectorXd& constants,
+                           EvaluationWorkspace& workspace);
+
+/*!
+ * \brief Evaluates the utilized commands and derivative using a workspace.
+ *
+ * \param stack Description of an acyclic graph in stack format.
+ * \param x The input variables to the acyclic graph. (Eigen::ArrayXXd)
+ * \param constants Vector of the constants used in the stack.
+ * \param workspace Buffers to evaluate into. (EvaluationWorkspace)
+ * \param param_x_or_c true: x derivative, false: c derivative
+ */
+void simplify_and_evaluate_with_derivative(const Eigen::ArrayX3i& stack,
+                                           const Eigen::ArrayXXd& x,
+                                           const Eigen::VectorXd& constants,
+                                           EvaluationWorkspace& workspace,
+                                           const bool param_x_or_c = true);
+
+/*!
+ * \brief Evaluates the utilized commands of a stack, reusing cached values.
+ *
+ * Only the commands which differ from the cached evaluation, or depend on
+ * one that does, are computed.  The result is left in cache.result().
+ *
+ * \param stack Description of an acyclic graph in stack format.
+ * \param x The input variables to the acyclic graph. (Eigen::ArrayXXd)
+ * \param constants The constants used in the acyclic graph.
+ * \param cache Values of the previous evaluation, updated in place.
+ */
+void evaluate_incremental(const Eigen::ArrayX3i& stack,
+                          const Eigen::ArrayXXd& x,
+                          const Eigen::VectorXd& constants,
+                          EvaluationCache& cache);
+
+
+/*!
+ * \brief Evaluates the utilized commands of a population of stacks.
+ *
+ * Every stack is evaluated at the same x.  The evaluation buffers are shared
+ * by the whole population and the results are written into one matrix.
+ *
+ * \param stacks Descriptions of acyclic graphs in stack format.
+ * \param x The input variables shared by all stacks. (Eigen::ArrayXXd)
+ * \param constants The constants used by each stack.
+ *
+ * \return Matrix whose i-th column is the value of the i-th stack.
+ *         (Eigen::ArrayXXd)
+ */
+Eigen::ArrayXXd evaluate_population(
+    const std::vector<Eigen::ArrayX3i>& stacks,
+    const Eigen::ArrayXXd& x,
+    const std::vector<Eigen::VectorXd>& constants);
+
+/*!
+ * \brief Evaluates a population of stacks and their derivatives.
+ *
+ * The derivatives of all stacks are written side by side into one matrix.
+ * The gradient of the i-th stack occupies as many columns as it has
+ * parameters (the columns of x, or the size of its constants), starting
+ * after the columns of all preceding stacks.
+ *
+ * \param stacks Descriptions of acyclic graphs in stack format.
+ * \param x The input variables shared by all stacks. (Eigen::ArrayXXd)
+ * \param constants The constants used by each stack.
+ * \param param_x_or_c true: x derivative, false: c derivative
+ *
+ * \return The values of the stacks (one per column) and their gradients.
+ *         (std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd>)
+ */
+std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd>
+evaluate_population_with_derivative(
+    const std::vector<Eigen::ArrayX3i>& stacks,
+    const Eigen::ArrayXXd& x,
+    const std::vector<Eigen::VectorXd>& constants,
+    const bool param_x_or_c = true);
+
+/*!
+ * \brief Evaluates the utilized commands of a population of stacks in
+ *        parallel.
+ *
+ * Each thread of the pool evaluates whole stacks with its own buffers.  The
+ * results are identical to the serial evaluate_population.
+ *
+ * \param stacks Descriptions of acyclic graphs in stack format.
+ * \param x The input variables shared by all stacks. (Eigen::ArrayXXd)
+ * \param constants The constants used by each stack.
+ * \param pool The threads evaluating the stacks.
+ *
+ * \return Matrix whose i-th column is the value of the i-th stack.
+ *         (Eigen::ArrayXXd)
+ */
+Eigen::ArrayXXd evaluate_population(
+    const std::vector<Eigen::ArrayX3i>& stacks,
+    const Eigen::ArrayXXd& x,
+    const std::vector<Eigen::VectorXd>& constants,
+    ThreadPool& pool);
+
+/*!
+ * \brief Evaluates a population of stacks and their derivatives in parallel.
+ *
+ * The layout of the result is that of the serial
+ * evaluate_population_with_derivative.
+ *
+ * \param stacks Descriptions of acyclic graphs in stack format.
+ * \param x The input variables shared by all stacks. (Eigen::ArrayXXd)
+ * \param constants The constants used by each stack.
+ * \param pool The threads evaluating the stacks.
+ * \param param_x_or_c true: x derivative, false: c derivative
+ *
+ * \return The values of the stacks (one per column) and their gradients.
+ *         (std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd>)
+ */
+std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd>
+evaluate_population_with_derivative(
+    const std::vector<Eigen::ArrayX3i>& stacks,
+    const Eigen::ArrayXXd& x,
+    const std::vector<Eigen::VectorXd>& constants,
+    ThreadPool& pool,
+    const bool param_x_or_c = true);
+
 
 /*!
  * \brief Simplifies a stack.
  *
  * An acyclic graph is given in stack form.  The stack is first simplified to
- * consist only of the commands used by the last command.
+ * consist only of the commands used by the last command, then duplicate
+ * commands are merged with merge_common_subexpressions.
  *
  * \param stack Description of an acyclic graph in stack format.
  *
@@ -124,6 +683,22 @@ std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd> simplify_and_evaluate_with_derivativ
  */
 Eigen::ArrayX3i simplify_stack(const Eigen::ArrayX3i& stack);
 
+/*!
+ * \brief Merges structurally identical commands of a stack.
+ *
+ * Commands are hash-consed in stack order: a command with the same node and
+ * (already merged) operands as an earlier one is dropped and its readers are
+ * pointed at the earlier row.  Operands of + and * are ordered, unused
+ * commands are removed and the operand of a unary command is repeated in its
+ * second column, so equivalent stacks share one canonical form.  Constants
+ * which have not been numbered yet (parameter -1) are never merged.
+ *
+ * \param stack Description of an acyclic graph in stack format.
+ *
+ * \return Stack without duplicate commands.
+ */
+Eigen::ArrayX3i merge_common_subexpressions(const Eigen::ArrayX3i& stack);
+
 
 /*!
  * \brief Finds which commands are utilized in a stack.
@@ -137,6 +712,31 @@ Eigen::ArrayX3i simplify_stack(const Eigen::ArrayX3i& stack);
  */
 std::vector<bool> get_utilized_commands(const Eigen::ArrayX3i& stack);
 
+/*!
+ * \brief Finds which commands are utilized in a stack, reusing a vector.
+ *
+ * \param stack Description of an acyclic graph in stack format.
+ * \param used_commands Filled with whether each command is used.
+ */
+void get_utilized_commands(const Eigen::ArrayX3i& stack,
+                           std::vector<bool>& used_commands);
+
+
+/*!
+ * \brief Assigns the commands of a stack to recycled buffers.
+ *
+ * The last use of every evaluated command is found and each command is given
+ * a buffer that is free at that point in the stack.  A command may be given
+ * the buffer of one of its own operands since all operations are element-wise.
+ *
+ * \param stack Description of an acyclic graph in stack format.
+ * \param mask Which commands are evaluated (see get_utilized_commands).
+ * \param allocation Filled with the buffer of each command.
+ */
+void allocate_buffers(const Eigen::ArrayX3i& stack,
+                      const std::vector<bool>& mask,
+                      BufferAllocation& allocation);
+
 
 int get_arity(int node);
 } // namespace bingo
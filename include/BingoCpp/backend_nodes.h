@@ -23,10 +23,10 @@
 
 namespace bingo {
 
-typedef Eigen::ArrayXXd (
+typedef void (
   *forward_operator_function)(
-    int, int, const Eigen::ArrayXXd&,
-    const Eigen::VectorXd&, std::vector<Eigen::ArrayXXd>&
+    int, int, const Eigen::Ref<const Eigen::ArrayXXd>&,
+    const Eigen::VectorXd&, std::vector<Eigen::ArrayXXd>&, int
 );
 
 typedef void (
@@ -37,12 +37,16 @@ typedef void (
 
 /*
  * Maps param1, param2, x, constants, and forward eval to the correct
- * forward eval function corresponding to the operation node.
+ * forward eval function corresponding to the operation node.  The result is
+ * written in place to forward_eval[result_index] so that a buffer which is
+ * already sized is reused rather than reallocated.  x may be a block of rows
+ * of the full input when evaluating one tile of samples.
  */
-Eigen::ArrayXXd forward_eval_function(int node, int param1, int param2,
-                                      const Eigen::ArrayXXd& x, 
-                                      const Eigen::VectorXd& constants,
-                                      std::vector<Eigen::ArrayXXd>& forward_eval);
+void forward_eval_function(int node, int param1, int param2,
+                           const Eigen::Ref<const Eigen::ArrayXXd>& x,
+                           const Eigen::VectorXd& constants,
+                           std::vector<Eigen::ArrayXXd>& forward_eval,
+                           int result_index);
 /*
  * Maps reverse_index, param1, param2, forward evaluation stack and 
  * revese evaluation stack to the corresponding operation node.
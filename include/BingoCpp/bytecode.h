@@ -0,0 +1,149 @@
+/*
+ * Copyright 2018 United States Government as represented by the Administrator
+ * of the National Aeronautics and Space Administration. No copyright is claimed
+ * in the United States under Title 17, U.S. Code. All Other Rights Reserved.
+ *
+ * The Bingo Mini-app platform is licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+*/
+#ifndef INCLUDE_BINGOCPP_BYTECODE_H_
+#define INCLUDE_BINGOCPP_BYTECODE_H_
+
+#include <vector>
+
+#include <Eigen/Dense>
+#include <Eigen/Core>
+
+namespace bingo {
+
+/*! \enum OperandKind
+ *
+ *  Where an instruction reads one of its operands from.
+ */
+enum OperandKind {
+  BUFFER_OPERAND,    //!< a buffer written by an earlier instruction
+  X_OPERAND,         //!< a column of x, read in place
+  CONSTANT_OPERAND   //!< a constant, broadcast to every sample
+};
+
+/*! \enum OpCode
+ *
+ *  Shape of a bytecode instruction.  Every shape may apply a unary operator
+ *  to its result, which fuses a unary command with the command it reads.
+ */
+enum OpCode {
+  UNARY_OP,         //!< dst = unary(a)
+  BINARY_OP,        //!< dst = unary(a op b)
+  MULTIPLY_ADD_OP   //!< dst = unary(a * b + c)
+};
+
+/*! \struct Operand
+ *
+ *  An input of a bytecode instruction.
+ */
+struct Operand {
+  //! OperandKind kind
+  /*! where the operand is read from */
+  OperandKind kind;
+  //! int index
+  /*! buffer, column of x or constant index */
+  int index;
+};
+
+/*! \struct Instruction
+ *
+ *  One superinstruction of a compiled stack.
+ */
+struct Instruction {
+  //! OpCode code
+  /*! shape of the instruction */
+  OpCode code;
+  //! int binary_node
+  /*! node type of the binary operator of a BINARY_OP */
+  int binary_node;
+  //! int unary_node
+  /*! node type of the unary operator applied last, NO_UNARY_NODE for none */
+  int unary_node;
+  //! int dst
+  /*! buffer receiving the result */
+  int dst;
+  //! Operand args[3]
+  /*! inputs of the instruction: a, b and c */
+  Operand args[3];
+};
+
+//! unary_node of an instruction which applies no unary operator
+const int NO_UNARY_NODE = -1;
+
+/*! \struct Program
+ *
+ *  A stack lowered into a straight-line list of superinstructions.
+ *
+ *  Loads of x and of constants are not materialized; instructions read
+ *  columns of x and constants directly.  A multiplication read only by an
+ *  addition becomes a multiply-add, and a command read only by a unary
+ *  command absorbs it, so neither needs a buffer of its own.  Buffers are
+ *  recycled by liveness over the instruction list.
+ *
+ *  Constants are referenced by index, so a program is reused when the
+ *  constants of its stack change.
+ */
+struct Program {
+  //! Eigen::ArrayX3i stack
+  /*! the stack the program was compiled from */
+  Eigen::ArrayX3i stack;
+  //! std::vector<Instruction> instructions
+  /*! instructions in execution order */
+  std::vector<Instruction> instructions;
+  //! int num_buffers
+  /*! number of buffers written by the instructions */
+  int num_buffers;
+  //! int result
+  /*! buffer holding the value of the stack after execution */
+  int result;
+
+  Program() : num_buffers(0), result(0) {}
+};
+
+/*!
+ * \brief Compiles the utilized commands of a stack into a program.
+ *
+ * \param stack Description of an acyclic graph in stack format.
+ *
+ * \return The compiled program. (Program)
+ */
+Program compile_stack(const Eigen::ArrayX3i& stack);
+
+/*!
+ * \brief Checks whether a program was compiled from a stack.
+ *
+ * \param program A compiled program.
+ * \param stack Description of an acyclic graph in stack format.
+ *
+ * \return true if the program evaluates stack.
+ */
+bool is_compiled_from(const Program& program, const Eigen::ArrayX3i& stack);
+
+/*!
+ * \brief Executes the instructions of a program on a block of samples.
+ *
+ * \param program A compiled program.
+ * \param x The input variables. (Eigen::ArrayXXd)
+ * \param constants The constants used by the program.
+ * \param buffers At least program.num_buffers buffers; the value of the
+ *                program is left in buffers[program.result].
+ */
+void run_program(const Program& program,
+                 const Eigen::Ref<const Eigen::ArrayXXd>& x,
+                 const Eigen::VectorXd& constants,
+                 std::vector<Eigen::ArrayXXd>& buffers);
+} // namespace bingo
+#endif
@@ -0,0 +1,99 @@
+/*
+ * Copyright 2018 United States Government as represented by the Administrator
+ * of the National Aeronautics and Space Administration. No copyright is claimed
+ * in the United States under Title 17, U.S. Code. All Other Rights Reserved.
+ *
+ * The Bingo Mini-app platform is licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+*/
+#ifndef INCLUDE_BINGOCPP_DISTANCE_H_
+#define INCLUDE_BINGOCPP_DISTANCE_H_
+
+#include <vector>
+
+#include <Eigen/Dense>
+#include <Eigen/Core>
+
+#include "BingoCpp/acyclic_graph.h"
+#include "BingoCpp/population.h"
+#include "BingoCpp/thread_pool.h"
+
+namespace bingo {
+
+/*! \enum DistanceMode
+ *
+ *  Which parts of two stacks a distance compares.
+ */
+enum DistanceMode {
+  //! every field of every command, as AcyclicGraphManipulator::distance
+  STACK_DISTANCE,
+  //! the utilized commands and the operands they read; a command utilized
+  //! by only one of the stacks counts as entirely different
+  UTILIZED_DISTANCE
+};
+
+/*!
+ * \brief Distances between every pair of individuals of a population.
+ *
+ * The distance of two individuals is the number of differing fields of
+ * their stacks.  The stacks are first packed one after the other, one byte
+ * per field when every field fits, so that pairs are compared by a loop
+ * over contiguous bytes which the compiler vectorizes.  Pairs are computed
+ * in square tiles of individuals which stay in cache.
+ *
+ * \param population Individuals with stacks of equal size.
+ * \param mode What is compared, see DistanceMode.
+ *
+ * \return Symmetric matrix of the distance between individuals i and j.
+ */
+template <typename Command>
+Eigen::ArrayXXi distance_matrix(const BasicPopulation<Command> &population,
+                                DistanceMode mode = STACK_DISTANCE);
+
+/*!
+ * \brief Distances between every pair of individuals, tiles spread across
+ *        threads.
+ *
+ * \param population Individuals with stacks of equal size.
+ * \param mode What is compared, see DistanceMode.
+ * \param pool The threads computing the tiles.
+ *
+ * \return Symmetric matrix of the distance between individuals i and j.
+ */
+template <typename Command>
+Eigen::ArrayXXi distance_matrix(const BasicPopulation<Command> &population,
+                                DistanceMode mode, ThreadPool &pool);
+
+/*!
+ * \brief Distances between every pair of individuals of a population.
+ *
+ * \param population Individuals with stacks of equal size.
+ * \param mode What is compared, see DistanceMode.
+ *
+ * \return Symmetric matrix of the distance between individuals i and j.
+ */
+Eigen::ArrayXXi distance_matrix(const std::vector<AcyclicGraph> &population,
+                                DistanceMode mode = STACK_DISTANCE);
+
+/*!
+ * \brief Distances between every pair of individuals, tiles spread across
+ *        threads.
+ *
+ * \param population Individuals with stacks of equal size.
+ * \param mode What is compared, see DistanceMode.
+ * \param pool The threads computing the tiles.
+ *
+ * \return Symmetric matrix of the distance between individuals i and j.
+ */
+Eigen::ArrayXXi distance_matrix(const std::vector<AcyclicGraph> &population,
+                                DistanceMode mode, ThreadPool &pool);
+} // namespace bingo
+#endif
@@ -0,0 +1,147 @@
+/*
+ * Copyright 2018 United States Government as represented by the Administrator
+ * of the National Aeronautics and Space Administration. No copyright is claimed
+ * in the United States under Title 17, U.S. Code. All Other Rights Reserved.
+ *
+ * The Bingo Mini-app platform is licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+*/
+#ifndef INCLUDE_BINGOCPP_FITNESS_CACHE_H_
+#define INCLUDE_BINGOCPP_FITNESS_CACHE_H_
+
+#include <stdint.h>
+
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+#include <Eigen/Dense>
+#include <Eigen/Core>
+
+#include "BingoCpp/acyclic_graph.h"
+#include "BingoCpp/training_data.h"
+
+namespace bingo {
+
+/*! \struct CachedFitness
+ *
+ *  Fitness of an individual and the constants it was reached with.
+ */
+struct CachedFitness {
+  //! double fitness
+  /*! the fitness metric */
+  double fitness;
+  //! Eigen::VectorXd constants
+  /*! constants of the individual, after optimization if there was one */
+  Eigen::VectorXd constants;
+
+  CachedFitness() : fitness(0.0) {}
+};
+
+/*! \class FitnessCache
+ *
+ *  Fitness of previously evaluated individuals, see fitness_key.
+ *
+ *  Holds at most capacity individuals; the least recently used one is
+ *  dropped first.  All members are thread safe.
+ *
+ *  \note Keys are 64 bit hashes; two different individuals sharing a key
+ *        would share a fitness.
+ *
+ *  \fn bool find(uint64_t key, CachedFitness &cached)
+ *  \fn void insert(uint64_t key, const CachedFitness &cached)
+ *  \fn void clear()
+ *  \fn std::size_t size() const
+ *  \fn std::size_t hits() const
+ *  \fn std::size_t misses() const
+ */
+class FitnessCache {
+ public:
+  /*! \brief Creates an empty cache
+   *
+   *  \param[in] capacity Most individuals held. std::size_t
+   */
+  explicit FitnessCache(std::size_t capacity = 1 << 16);
+  /*! \brief looks up an individual, counting a hit or a miss
+   *
+   *  \param[in] key Key of the individual, see fitness_key. uint64_t
+   *  \param[out] cached Its fitness and constants, on a hit. CachedFitness
+   *  \return true if the individual is held
+   */
+  bool find(uint64_t key, CachedFitness &cached);
+  /*! \brief stores an individual as the most recently used
+   *
+   *  \param[in] key Key of the individual, see fitness_key. uint64_t
+   *  \param[in] cached Its fitness and constants. CachedFitness
+   */
+  void insert(uint64_t key, const CachedFitness &cached);
+  //! \brief drops every individual
+  void clear();
+  //! \brief number of individuals held
+  std::size_t size() const;
+  //! \brief number of lookups which found an individual
+  std::size_t hits() const;
+  //! \brief number of lookups which found nothing
+  std::size_t misses() const;
+
+ private:
+  typedef std::pair<uint64_t, CachedFitness> Entry;
+
+  mutable std::mutex mutex_;
+  std::size_t capacity_;
+  std::size_t hits_;
+  std::size_t misses_;
+  std::list<Entry> entries_;
+  std::unordered_map<uint64_t, std::list<Entry>::iterator> index_;
+};
+
+/*!
+ * \brief Fingerprints the values of a set of training data.
+ *
+ * \param train ExplicitTrainingData or ImplicitTrainingData.
+ *
+ * \return 64 bit hash of the arrays of train, never 0, or 0 for other types
+ *         of training data, which cannot be told apart.
+ */
+uint64_t training_data_hash(TrainingData &train);
+
+/*!
+ * \brief Identifier of a set of training data in fitness keys.
+ *
+ * The training_data_hash of train, computed on first use and kept in
+ * train.dataset_id, so that looking up an individual does not hash the whole
+ * data again.
+ *
+ * \param train The training data.
+ *
+ * \return 64 bit hash of the arrays of train, 0 if it cannot be hashed.
+ */
+uint64_t training_data_id(TrainingData &train);
+
+/*!
+ * \brief Key of the fitness of an individual on a set of training data.
+ *
+ * The key hashes the commands of simple_stack and the values of the
+ * constants it loads, so individuals with the same utilized commands and
+ * constants share a key whatever their unused commands.  The constants of an
+ * individual which needs optimization are left out, since they are about to
+ * be replaced.
+ *
+ * \param indv The individual, with an up to date simple_stack.
+ * \param dataset_id Identifier of the training data, see training_data_hash.
+ *
+ * \return 64 bit key.
+ */
+uint64_t fitness_key(AcyclicGraph &indv, uint64_t dataset_id);
+} // namespace bingo
+#endif
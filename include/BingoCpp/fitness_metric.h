@@ -26,7 +26,11 @@
 #define INCLUDE_BINGOCPP_FITNESS_METRIC_H_
 
 #include "BingoCpp/acyclic_graph.h"
+#include "BingoCpp/fitness_cache.h"
 #include "BingoCpp/training_data.h"
+#include "BingoCpp/memo.h"
+#include "BingoCpp/thread_pool.h"
+#include <vector>
 #include <Eigen/Dense>
 #include <Eigen/Core>
 
@@ -34,6 +38,32 @@ namespace bingo {
 
 struct FitnessMetric;
 
+/*! \struct FitnessEvaluation
+ *
+ *  Results of one evaluation of an individual by a fitness metric: the
+ *  fitness vector, the fitness metric and, on request, the derivative of the
+ *  fitness vector with respect to the constants.
+ *
+ *  \note The arrays keep their storage between evaluations, so reusing an
+ *        evaluation for the same training data does not allocate.
+ */
+struct FitnessEvaluation {
+  //! Eigen::ArrayXXd residual
+  /*! the fitness vector */
+  Eigen::ArrayXXd residual;
+  //! double fitness
+  /*! mean absolute value of the fitness vector */
+  double fitness;
+  //! Eigen::ArrayXXd jacobian
+  /*! derivative of the fitness vector with respect to the constants */
+  Eigen::ArrayXXd jacobian;
+  //! bool has_jacobian
+  /*! whether jacobian holds the derivative of this evaluation */
+  bool has_jacobian;
+
+  FitnessEvaluation() : fitness(0.0), has_jacobian(false) { }
+};
+
 /*! \struct LMFunctor
  *
  *  Used for Levenberg-Marquardt Optimization
@@ -59,6 +89,12 @@ struct LMFunctor {
   //! FitnessMetric* fit
   /*! object that holds fitness metric */
   FitnessMetric* fit;
+  //! FitnessEvaluation evaluation
+  /*! errors and jacobian from the last call to operator() */
+  FitnessEvaluation evaluation;
+  //! Eigen::VectorXd evaluated_constants
+  /*! parameters of the last call to operator() */
+  Eigen::VectorXd evaluated_constants;
   /*! \brief Compute 'm' errors, one for each data point, for the given paramter values in 'x'
    *
    *  \param[in] x contains current estimates for parameters. Eigen::VectorXd (dimensions nx1)
@@ -67,9 +103,15 @@ struct LMFunctor {
    */
   int operator()(const Eigen::VectorXd &x, Eigen::VectorXd &fvec);
   /*! \brief Compute jacobian of the errors
+   *
+   *  The jacobian is analytic when the fitness metric provides one
+   *  (see FitnessMetric::evaluate_fitness_jacobian) and is otherwise
+   *  calculated numerically by central differences.  An analytic jacobian
+   *  at the parameters of the last call to operator() is reused from that
+   *  call, which computed it in the same sweep as the errors.
    *
    *  \param[in] x contains current estimates for parameters. Eigen::VectorXd (dimensions nx1)
-   *  \param[in] fjac contain jacobian of the errors, calculated numerically. Eigen::MatrixXf (dimensions mxn)
+   *  \param[in] fjac contain jacobian of the errors. Eigen::MatrixXd (dimensions mxn)
    *  \return 0
    */
   int df(const Eigen::VectorXd &x, Eigen::MatrixXd &fjac);
@@ -97,12 +139,28 @@ struct LMFunctor {
  *  \note FitnessMetric includes : StandardRegression
  *
  *  \fn virtual Eigen::ArrayXXd evaluate_fitness_vector(AcyclicGraph &indv, TrainingData &train) = 0
+ *  \fn virtual bool evaluate_fitness_jacobian(AcyclicGraph &indv, TrainingData &train, Eigen::MatrixXd &jacobian)
+ *  \fn virtual void evaluate_fused(AcyclicGraph &indv, TrainingData &train, bool with_jacobian, FitnessEvaluation &evaluation)
  *  \fn float evaluate_fitness(AcyclicGraph &indv, TrainingData &train)
  *  \fn void optimize_constants(AcyclicGraph &indv, TrainingData &train)
+ *  \fn void optimize_constants(AcyclicGraph &indv, TrainingData &train, const Eigen::VectorXd &initial_constants)
+ *  \fn std::vector<double> evaluate_population_fitness(std::vector<AcyclicGraph> &population, TrainingData &train, ThreadPool &pool)
+ *  \fn std::vector<double> evaluate_population_fitness(std::vector<AcyclicGraph> &population, TrainingData &train, const std::vector<Eigen::VectorXd> &initial_constants, ThreadPool &pool)
  */
 struct FitnessMetric {
  public:
-  FitnessMetric() { }
+  //! ThreadPool* pool
+  /*! threads sharing the samples of each evaluation, NULL for serial */
+  ThreadPool* pool;
+  //! SubexpressionMemo* memo
+  /*! values of subgraphs shared between evaluations, NULL for none */
+  SubexpressionMemo* memo;
+  //! FitnessCache* fitness_cache
+  /*! fitness of previously evaluated individuals, NULL for none; keys use
+   *  training_data_id, so reset the dataset_id of training data changed in
+   *  place */
+  FitnessCache* fitness_cache;
+  FitnessMetric() : pool(NULL), memo(NULL), fitness_cache(NULL) { }
   /*! \brief f(x) - y where f is defined by indv and x, y are in train
   *
   *  \note Each implementation will need to hard code casting TrainingData
@@ -114,8 +172,37 @@ struct FitnessMetric {
   */
   virtual Eigen::ArrayXXd evaluate_fitness_vector(AcyclicGraph &indv,
       TrainingData &train) = 0;
+  /*! \brief derivative of the fitness vector with respect to the constants
+  *
+  *  \param[in] indv agcpp indv to be evaluated. AcyclicGraph
+  *  \param[in] train The TrainingData to evaluate the fitness. TrainingData
+  *  \param[out] jacobian samples by constants. Eigen::MatrixXd
+  *  \return bool false if the metric has no analytic derivative, in which
+  *          case constant optimization differentiates numerically
+  */
+  virtual bool evaluate_fitness_jacobian(AcyclicGraph &indv,
+                                         TrainingData &train,
+                                         Eigen::MatrixXd &jacobian);
+  /*! \brief fitness vector, fitness metric and jacobian together
+  *
+  *  The default combines evaluate_fitness_vector and
+  *  evaluate_fitness_jacobian; metrics override it to produce all three
+  *  from a single evaluation of the individual.
+  *
+  *  \param[in] indv agcpp indv to be evaluated. AcyclicGraph
+  *  \param[in] train The TrainingData to evaluate the fitness. TrainingData
+  *  \param[in] with_jacobian whether to compute the jacobian. bool
+  *  \param[out] evaluation the results. FitnessEvaluation
+  */
+  virtual void evaluate_fused(AcyclicGraph &indv, TrainingData &train,
+                              bool with_jacobian,
+                              FitnessEvaluation &evaluation);
   /*! \brief Finds the fitness metric
   *
+  *  With a fitness cache, an individual with the same utilized commands
+  *  and constants as one evaluated before on the same training data gets
+  *  its fitness, and its optimized constants, from the cache.
+  *
   *  \param[in] indv agcpp indv to be evaluated. AcyclicGraph
   *  \param[in] train The TrainingData to evaluate the fitness. TrainingData
   *  \return float the fitness metric
@@ -127,6 +214,50 @@ struct FitnessMetric {
   *  \param[in] train The TrainingData used by fitness metric. TrainingData
   */
   void optimize_constants(AcyclicGraph &indv, TrainingData &train);
+  /*! \brief perform levenberg-marquardt optimization from a given start
+  *
+  *  \param[in] indv agcpp indv to be evaluated. AcyclicGraph
+  *  \param[in] train The TrainingData used by fitness metric. TrainingData
+  *  \param[in] initial_constants starting point of the optimization.
+  *             Eigen::VectorXd
+  */
+  void optimize_constants(AcyclicGraph &indv, TrainingData &train,
+                          const Eigen::VectorXd &initial_constants);
+  /*! \brief Finds the fitness metric of every individual of a population
+  *
+  *  Individuals are optimized and evaluated in parallel on the threads of
+  *  pool.  The random starting constants of the optimizations are drawn in
+  *  population order before the work is distributed, so the results do not
+  *  depend on the number of threads.
+  *
+  *  \note evaluate_fitness_vector must be safe to call concurrently for
+  *        different individuals.
+  *
+  *  \param[in] population agcpp indvs to be evaluated. AcyclicGraph
+  *  \param[in] train The TrainingData to evaluate the fitness. TrainingData
+  *  \param[in] pool The threads evaluating the individuals. ThreadPool
+  *  \return std::vector<double> the fitness metric of each individual
+  */
+  std::vector<double> evaluate_population_fitness(
+    std::vector<AcyclicGraph> &population, TrainingData &train,
+    ThreadPool &pool);
+  /*! \brief Finds the fitness metric of every individual of a population
+  *         from given starting constants
+  *
+  *  As above, with the starting constants of the optimizations drawn by the
+  *  caller, e.g. from its own generator.
+  *
+  *  \param[in] population agcpp indvs to be evaluated. AcyclicGraph
+  *  \param[in] train The TrainingData to evaluate the fitness. TrainingData
+  *  \param[in] initial_constants Starting point of the optimization of each
+  *             individual which needs one, count_constants() long.
+  *             std::vector<Eigen::VectorXd>
+  *  \param[in] pool The threads evaluating the individuals. ThreadPool
+  *  \return std::vector<double> the fitness metric of each individual
+  */
+  std::vector<double> evaluate_population_fitness(
+    std::vector<AcyclicGraph> &population, TrainingData &train,
+    const std::vector<Eigen::VectorXd> &initial_constants, ThreadPool &pool);
 };
 
 /*! \struct StandardRegression
@@ -137,6 +268,10 @@ struct StandardRegression : FitnessMetric {
   StandardRegression() : FitnessMetric() {}
   Eigen::ArrayXXd evaluate_fitness_vector(AcyclicGraph &indv,
                                           TrainingData &train);
+  bool evaluate_fitness_jacobian(AcyclicGraph &indv, TrainingData &train,
+                                 Eigen::MatrixXd &jacobian);
+  void evaluate_fused(AcyclicGraph &indv, TrainingData &train,
+                      bool with_jacobian, FitnessEvaluation &evaluation);
 };
 
 /*! \struct ImplicitRegression
@@ -158,6 +293,8 @@ struct ImplicitRegression : FitnessMetric {
                      double acceptable_nans = 0.1);
   Eigen::ArrayXXd evaluate_fitness_vector(AcyclicGraph &indv,
                                           TrainingData &train);
+  bool evaluate_fitness_jacobian(AcyclicGraph &indv, TrainingData &train,
+                                 Eigen::MatrixXd &jacobian);
 };
 } // namespace bingo
 #endif
@@ -34,12 +34,13 @@
 #include <vector>
 #include <string>
 #include <sstream>
-#include <stdlib.h>
 #include <iomanip>
-#include <time.h>
 
 #include "BingoCpp/backend.h"
 #include "BingoCpp/acyclic_graph.h"
+#include "BingoCpp/population.h"
+#include "BingoCpp/random.h"
+#include "BingoCpp/thread_pool.h"
 
 namespace bingo {
 
@@ -47,10 +48,22 @@ namespace bingo {
  *
  *  Manipulates AGraph objects for generation, crossover, mutation, and distance
  *
+ *  Random draws come from the manipulator's own generator, rng, so a
+ *  manipulator is not thread safe but a seeded one is reproducible.  Threads
+ *  varying individuals in parallel should each use a copy whose rng is
+ *  seeded differently or jumped ahead.
+ *
  *  \fn void add_node_type(int node_type)
  *  \fn AcyclicGraph generate()
+ *  \fn Population generate_batch(int n)
+ *  \fn Population generate_batch(int n, ThreadPool &pool)
  *  \fn std::vector<AcyclicGraph> crossover(AcyclicGraph &parent1, AcyclicGraph &parent2)
- *  \fn void mutation(AcyclicGraph &indv)
+ *  \fn void crossover(AcyclicGraph &parent1, AcyclicGraph &parent2, AcyclicGraph &child1, AcyclicGraph &child2)
+ *  \fn void crossover_batch(std::vector<AcyclicGraph> &population, const std::vector<std::pair<int, int> > &pairs, std::vector<AcyclicGraph> &children)
+ *  \fn AcyclicGraph mutation(AcyclicGraph &indv)
+ *  \fn void mutation(AcyclicGraph &parent, AcyclicGraph &child)
+ *  \fn void mutation_batch(std::vector<AcyclicGraph> &population, const std::vector<int> &indices, std::vector<AcyclicGraph> &children)
+ *  \fn bool inherit_fitness(AcyclicGraph &child, AcyclicGraph &parent)
  *  \fn int distance(AcyclicGraph &indv1, AcyclicGraph &indv2)
  *  \fn std::vector<int> rand_operator_params(int arity, int stack_location)
  *  \fn int rand_operator_type()
@@ -87,6 +100,17 @@ class AcyclicGraphManipulator {
    * 5 - Same as 1, but optimize every mutation and crossover
    */
   int opt_rate;
+  //! bool eliminate_common_subexpressions
+  /*! merge duplicate commands of simple_stack when simplifying (off by
+   *  default so that simple_stack keeps one row per utilized command) */
+  bool eliminate_common_subexpressions;
+  //! bool rewrite_identities
+  /*! apply rewrite_stack to simple_stack when simplifying */
+  bool rewrite_identities;
+  //! bool inherit_equivalent_fitness
+  /*! give a child whose simple_stack and constants match a parent the
+   *  fitness and optimized constants of that parent */
+  bool inherit_equivalent_fitness;
   //! std::vector<int> node_type_vec
   /*! vector to hold the types of nodes in the manipulator */
   std::vector<int> node_type_vec;
@@ -99,6 +123,9 @@ class AcyclicGraphManipulator {
   //! int num_node_types
   /*! int to hold the number of node types (matches the python) */
   int num_node_types;
+  //! Xoshiro256 rng
+  /*! generator of every random draw of the manipulator */
+  Xoshiro256 rng;
 
   //! \brief Constructor
   AcyclicGraphManipulator(int nvars = 3, int ag_size = 15, int nloads = 1,
@@ -115,6 +142,32 @@ class AcyclicGraphManipulator {
    *  \returns new AcyclicGraph individual
    */
   AcyclicGraph generate();
+  /*! \brief Generates a population of random individuals
+   *
+   *  Draws the stacks straight into the population, without an
+   *  AcyclicGraph or temporary vectors per individual, and numbers the
+   *  utilized constants of each stack in the same pass as simplify_stack
+   *  does.  Simplification is deferred: the population stores no simplified
+   *  stacks, and Population::individual builds one with the
+   *  eliminate_common_subexpressions and rewrite_identities settings copied
+   *  from the manipulator, so individual(i) matches generate().
+   *  Individuals are drawn in blocks of 256, block b from rng jumped
+   *  b times, so the population depends on the seed only and not on the
+   *  number of threads; the first block matches successive calls to
+   *  generate.  rng is left one jump past the last block.
+   *
+   *  \param[in] n Number of individuals. int
+   *  \returns Population of n individuals of ag_size commands
+   */
+  Population generate_batch(int n);
+  /*! \brief Generates a population of random individuals across threads
+   *
+   *  \param[in] n Number of individuals. int
+   *  \param[in] pool The threads drawing the blocks. ThreadPool
+   *  \returns Population of n individuals of ag_size commands, equal to
+   *           generate_batch(n)
+   */
+  Population generate_batch(int n, ThreadPool &pool);
   /*! \brief simplifies the individual's stack.
    *
    *  \param[in] indv The individual with the stack to simplify. AcyclicGraph
@@ -142,11 +195,64 @@ class AcyclicGraphManipulator {
    */
   std::vector<AcyclicGraph> crossover(AcyclicGraph &parent1,
                                       AcyclicGraph &parent2);
+  /*! \brief Single point crossover into existing children
+   *
+   *  The children are assigned over, so children of the same size as the
+   *  parents (e.g. kept from the previous generation) reuse their storage.
+   *
+   *  \param[in] parent1 the first parent. AcyclicGraph
+   *  \param[in] parent2 the second parent. AcyclicGraph
+   *  \param[out] child1 the first child, not a parent. AcyclicGraph
+   *  \param[out] child2 the second child, not a parent. AcyclicGraph
+   */
+  void crossover(AcyclicGraph &parent1, AcyclicGraph &parent2,
+                 AcyclicGraph &child1, AcyclicGraph &child2);
+  /*! \brief Single point crossover of pairs of a population
+   *
+   *  \param[in] population The parents. std::vector<AcyclicGraph>
+   *  \param[in] pairs Indices of the parents of each crossover.
+   *             std::vector<std::pair<int, int> >
+   *  \param[out] children Resized to two children per pair, children 2k
+   *              and 2k + 1 coming from pairs[k]. std::vector<AcyclicGraph>
+   */
+  void crossover_batch(std::vector<AcyclicGraph> &population,
+                       const std::vector<std::pair<int, int> > &pairs,
+                       std::vector<AcyclicGraph> &children);
   /*! \brief performs 1pt mutation, does not create copy of individual
    *
    *  \param[in] indv The individual to be mutated. AcyclicGraph
    */
   AcyclicGraph mutation(AcyclicGraph &indv);
+  /*! \brief 1pt mutation of a copy of parent into an existing child
+   *
+   *  \param[in] parent The individual to mutate. AcyclicGraph
+   *  \param[out] child Assigned the mutated copy, not parent. AcyclicGraph
+   */
+  void mutation(AcyclicGraph &parent, AcyclicGraph &child);
+  /*! \brief 1pt mutation of individuals of a population
+   *
+   *  \param[in] population The parents. std::vector<AcyclicGraph>
+   *  \param[in] indices Index of the parent of each mutation.
+   *             std::vector<int>
+   *  \param[out] children Resized to one mutated copy per index.
+   *              std::vector<AcyclicGraph>
+   */
+  void mutation_batch(std::vector<AcyclicGraph> &population,
+                      const std::vector<int> &indices,
+                      std::vector<AcyclicGraph> &children);
+  /*! \brief Gives a child the fitness of a phenotypically equal parent
+   *
+   *  Crossover and mutation often change only commands which are not
+   *  utilized.  When the simple_stack of child matches that of parent, and
+   *  the constants it reads match too or are still to be optimized, child
+   *  takes the fitness and the optimized constants of parent and keeps
+   *  fit_set.
+   *
+   *  \param[in] child A simplified child. AcyclicGraph
+   *  \param[in] parent One of its parents. AcyclicGraph
+   *  \return true if child inherited the fitness of parent
+   */
+  bool inherit_fitness(AcyclicGraph &child, AcyclicGraph &parent);
   /*! \brief Computes the distance (a measure of similarity) between two individuals
    *
    *  \param[in] indv1 first individual. AcyclicGraph
@@ -192,12 +298,14 @@ class AcyclicGraphManipulator {
    */
   std::vector<int> rand_terminal();
 
-
+ private:
+  void mutate(AcyclicGraph &indv, AcyclicGraph *parent);
+  void fill_random_stack(Xoshiro256 &rng, Eigen::ArrayX3i &stack) const;
+  void draw_terminal(Xoshiro256 &rng, int &node, int &param) const;
+  void draw_operator_params(Xoshiro256 &rng, int stack_location,
+                            int &param1, int &param2) const;
+  void draw_operator(Xoshiro256 &rng, int stack_location, int &node,
+                     int &param1, int &param2) const;
 };
-
-//! \brief Initializes random seed (for use in python with pybind)
-static void rand_init() {
-  srand (time(NULL));
-}
 } // namespace bingo
 #endif
@@ -0,0 +1,234 @@
+/*
+ * Copyright 2018 United States Government as represented by the Administrator
+ * of the National Aeronautics and Space Administration. No copyright is claimed
+ * in the United States under Title 17, U.S. Code. All Other Rights Reserved.
+ *
+ * The Bingo Mini-app platform is licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+*/
+#ifndef INCLUDE_BINGOCPP_ISLAND_H_
+#define INCLUDE_BINGOCPP_ISLAND_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "BingoCpp/acyclic_graph.h"
+#include "BingoCpp/fitness_metric.h"
+#include "BingoCpp/graph_manip.h"
+#include "BingoCpp/random.h"
+#include "BingoCpp/thread_pool.h"
+#include "BingoCpp/training_data.h"
+
+namespace bingo {
+
+/*! \enum MigrationTopology
+ *
+ *  Which islands send migrants to which.
+ */
+enum MigrationTopology {
+  RING_MIGRATION,            //!< island k receives from island k - 1
+  RANDOM_MIGRATION,          //!< each island receives from a random other
+  FULLY_CONNECTED_MIGRATION  //!< each island receives from all others
+};
+
+/*! \enum MigrantSelection
+ *
+ *  Which individuals of an island migrate.
+ */
+enum MigrantSelection {
+  BEST_MIGRANTS,   //!< the fittest individuals
+  RANDOM_MIGRANTS  //!< individuals drawn at random
+};
+
+/*! \class Island
+ *
+ *  A population evolved by deterministic crowding.
+ *
+ *  Every generation pairs individual i with individual i + size / 2.  Each
+ *  pair produces two children by crossover (or copies) and mutation, and
+ *  each child replaces the parent it is closest to if it is at least as
+ *  fit.  Lower fitness is better.  Children are kept from generation to
+ *  generation, so variation reuses their storage.
+ *
+ *  Random draws come from the island's manipulator, including the starting
+ *  constants of the optimizations, so an island is reproducible once its
+ *  manipulator is seeded.  A fitness cache of the metric breaks this: which
+ *  individuals hit it depends on what was evaluated before.
+ *
+ *  \fn void evaluate(ThreadPool &pool)
+ *  \fn void step(ThreadPool &pool)
+ *  \fn int best_individual() const
+ *  \fn void select_migrants(int num_migrants, MigrantSelection selection, std::vector<AcyclicGraph> &migrants)
+ *  \fn void receive_migrants(const std::vector<AcyclicGraph> &migrants)
+ */
+class Island {
+ public:
+  //! std::vector<AcyclicGraph> population
+  /*! the individuals of the island, of even size */
+  std::vector<AcyclicGraph> population;
+  //! AcyclicGraphManipulator manipulator
+  /*! variation operators and random generator of the island */
+  AcyclicGraphManipulator manipulator;
+  //! FitnessMetric* fitness_metric
+  /*! evaluates the individuals, not owned */
+  FitnessMetric* fitness_metric;
+  //! TrainingData* training_data
+  /*! data the individuals are evaluated on, not owned */
+  TrainingData* training_data;
+  //! float crossover_probability
+  /*! probability that a pair produces its children by crossover */
+  float crossover_probability;
+  //! float mutation_probability
+  /*! probability that a child is mutated */
+  float mutation_probability;
+  //! int generation
+  /*! number of generations evolved */
+  int generation;
+  //! long fitness_evaluations
+  /*! number of individuals evaluated */
+  long fitness_evaluations;
+
+  /*! \brief Creates an island
+   *
+   *  \param[in] population The initial individuals. std::vector<AcyclicGraph>
+   *  \param[in] manipulator The variation operators. AcyclicGraphManipulator
+   *  \param[in] fitness_metric Evaluates the individuals; must outlive the
+   *             island. FitnessMetric
+   *  \param[in] training_data The data of the fitness metric; must outlive
+   *             the island. TrainingData
+   */
+  Island(const std::vector<AcyclicGraph> &population,
+         const AcyclicGraphManipulator &manipulator,
+         FitnessMetric &fitness_metric, TrainingData &training_data);
+  /*! \brief evaluates the individuals whose fitness is not set
+   *
+   *  \param[in] pool The threads evaluating the individuals. ThreadPool
+   */
+  void evaluate(ThreadPool &pool);
+  /*! \brief evolves the population by one generation
+   *
+   *  \param[in] pool The threads evaluating the children. ThreadPool
+   */
+  void step(ThreadPool &pool);
+  /*! \brief finds the fittest individual
+   *
+   *  \return int index of the individual with the lowest fitness, -1 if no
+   *          individual has one
+   */
+  int best_individual() const;
+  /*! \brief copies individuals which are to migrate
+   *
+   *  \param[in] num_migrants Number of migrants, at most the size of the
+   *             population. int
+   *  \param[in] selection How migrants are chosen. MigrantSelection
+   *  \param[out] migrants Assigned the migrants. std::vector<AcyclicGraph>
+   */
+  void select_migrants(int num_migrants, MigrantSelection selection,
+                       std::vector<AcyclicGraph> &migrants);
+  /*! \brief replaces the least fit individuals by migrants
+   *
+   *  \param[in] migrants Evaluated individuals from another island.
+   *             std::vector<AcyclicGraph>
+   */
+  void receive_migrants(const std::vector<AcyclicGraph> &migrants);
+
+ private:
+  void evaluate(std::vector<AcyclicGraph> &individuals, ThreadPool &pool);
+  void sort_by_fitness(bool fittest_first);
+
+  std::vector<AcyclicGraph> children_;
+  std::vector<AcyclicGraph> batch_;
+  std::vector<Eigen::VectorXd> initial_constants_;
+  AcyclicGraph mutant_;
+  std::vector<int> unset_;
+  std::vector<int> order_;
+};
+
+/*! \class Archipelago
+ *
+ *  Islands evolved concurrently, exchanging migrants periodically.
+ *
+ *  Each island runs on one thread of the pool for migration_interval
+ *  generations; then every island copies its migrants to its own outbox and
+ *  every island takes migrants from the outboxes of its sources.  The two
+ *  phases are separated by the end of a parallel loop, so outboxes have a
+ *  single writer and only readers afterwards, and no locks are taken.  The
+ *  islands share the fitness metric and training data, which therefore
+ *  have to be safe to evaluate concurrently.
+ *
+ *  The manipulator of island k is seeded from seed and jumped k times, so
+ *  islands draw independent streams and, without a fitness cache shared by
+ *  the islands, an evolution does not depend on the number of threads.
+ *
+ *  \fn void evolve(int generations, ThreadPool &pool)
+ *  \fn void migrate(ThreadPool &pool)
+ *  \fn long fitness_evaluations() const
+ *  \fn AcyclicGraph best_individual() const
+ */
+class Archipelago {
+ public:
+  //! std::vector<Island> islands
+  /*! the islands */
+  std::vector<Island> islands;
+  //! MigrationTopology topology
+  /*! which islands send migrants to which */
+  MigrationTopology topology;
+  //! MigrantSelection migrant_selection
+  /*! which individuals migrate */
+  MigrantSelection migrant_selection;
+  //! int migration_interval
+  /*! number of generations between migrations */
+  int migration_interval;
+  //! int num_migrants
+  /*! number of individuals each island sends */
+  int num_migrants;
+  //! Xoshiro256 rng
+  /*! draws the sources of random migration */
+  Xoshiro256 rng;
+
+  /*! \brief Creates an archipelago, seeding its islands
+   *
+   *  \param[in] islands The islands. std::vector<Island>
+   *  \param[in] topology Which islands send migrants to which.
+   *             MigrationTopology
+   *  \param[in] migration_interval Generations between migrations. int
+   *  \param[in] num_migrants Individuals each island sends. int
+   *  \param[in] seed Seed of the islands and of random migration. uint64_t
+   */
+  Archipelago(const std::vector<Island> &islands,
+              MigrationTopology topology = RING_MIGRATION,
+              int migration_interval = 10, int num_migrants = 1,
+              uint64_t seed = 0);
+  /*! \brief evolves every island, migrating every migration_interval
+   *         generations
+   *
+   *  \param[in] generations Number of generations. int
+   *  \param[in] pool The threads running the islands. ThreadPool
+   */
+  void evolve(int generations, ThreadPool &pool);
+  /*! \brief exchanges migrants between the islands
+   *
+   *  \param[in] pool The threads running the islands. ThreadPool
+   */
+  void migrate(ThreadPool &pool);
+  //! \brief number of individuals evaluated by all islands
+  long fitness_evaluations() const;
+  //! \brief the fittest individual of all islands
+  AcyclicGraph best_individual() const;
+
+ private:
+  int generations_since_migration_;
+  std::vector<std::vector<AcyclicGraph> > outboxes_;
+  std::vector<std::vector<int> > sources_;
+};
+} // namespace bingo
+#endif
@@ -0,0 +1,170 @@
+/*
+ * Copyright 2018 United States Government as represented by the Administrator
+ * of the National Aeronautics and Space Administration. No copyright is claimed
+ * in the United States under Title 17, U.S. Code. All Other Rights Reserved.
+ *
+ * The Bingo Mini-app platform is licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+*/
+#ifndef INCLUDE_BINGOCPP_JIT_H_
+#define INCLUDE_BINGOCPP_JIT_H_
+
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <utility>
+
+#include <Eigen/Dense>
+#include <Eigen/Core>
+
+namespace bingo {
+
+/*! \struct JitOptions
+ *
+ *  How native kernels are built and where they are cached.
+ *
+ *  The defaults can be changed with the BINGO_JIT_CXX, BINGO_JIT_FLAGS and
+ *  BINGO_JIT_CACHE environment variables.  The compiler is run without a
+ *  shell, with compiler and flags split at whitespace.  The cache defaults
+ *  to $XDG_CACHE_HOME/bingo_jit or ~/.cache/bingo_jit; it is created
+ *  readable by the current user only, and a cache directory or shared
+ *  object owned by another user or writable by others is never used.
+ */
+struct JitOptions {
+  //! std::string compiler
+  /*! compiler used for the generated source, possibly with leading
+   *  arguments */
+  std::string compiler;
+  //! std::string flags
+  /*! flags passed to the compiler, in addition to -shared -fPIC */
+  std::string flags;
+  //! std::string cache_directory
+  /*! directory holding the generated sources and shared objects */
+  std::string cache_directory;
+
+  JitOptions();
+};
+
+/*! \class JitKernel
+ *
+ *  A stack compiled to native code and loaded from a shared object.
+ *
+ *  The generated code evaluates the stack one sample at a time with every
+ *  intermediate value in a local variable, followed by the reverse pass for
+ *  the derivative.  Kernels are cached on disk by structural_hash and shared
+ *  objects are loaded once per kernel object.
+ *
+ *  \fn bool is_compiled_from(const Eigen::ArrayX3i& stack) const
+ */
+class JitKernel {
+ public:
+  typedef void (*forward_kernel)(const double*, long, long, const double*,
+                                 double*);
+  typedef void (*reverse_kernel)(const double*, long, long, const double*, int,
+                                 double*, double*);
+
+  JitKernel(const Eigen::ArrayX3i& stack, void* handle,
+            forward_kernel forward, reverse_kernel reverse);
+  ~JitKernel();
+  /*! \brief checks whether the kernel evaluates a stack
+   *
+   *  \param[in] stack Description of an acyclic graph in stack format.
+   *  \return true if the kernel was compiled from stack
+   */
+  bool is_compiled_from(const Eigen::ArrayX3i& stack) const;
+  //! \brief the stack the kernel was compiled from
+  const Eigen::ArrayX3i& stack() const {
+    return stack_;
+  }
+  //! \brief evaluates the kernel on the rows of x
+  void forward(const Eigen::ArrayXXd& x, const Eigen::VectorXd& constants,
+               Eigen::ArrayXXd& result) const;
+  //! \brief evaluates the kernel and adds its gradient into derivative
+  void reverse(const Eigen::ArrayXXd& x, const Eigen::VectorXd& constants,
+               bool param_x_or_c, Eigen::ArrayXXd& result,
+               Eigen::ArrayXXd& derivative) const;
+
+ private:
+  JitKernel(const JitKernel&);
+  JitKernel& operator=(const JitKernel&);
+
+  Eigen::ArrayX3i stack_;
+  void* handle_;
+  forward_kernel forward_;
+  reverse_kernel reverse_;
+};
+
+/*!
+ * \brief Hashes the structure of the utilized commands of a stack.
+ *
+ * Stacks which simplify to the same commands have the same hash, whatever
+ * their unused commands.
+ *
+ * \param stack Description of an acyclic graph in stack format.
+ *
+ * \return 64 bit structural hash.
+ */
+uint64_t structural_hash(const Eigen::ArrayX3i& stack);
+
+/*!
+ * \brief Generates the C++ source of the native kernel of a stack.
+ *
+ * \param stack Description of an acyclic graph in stack format.
+ *
+ * \return Source defining the forward and reverse kernels.
+ */
+std::string generate_kernel_source(const Eigen::ArrayX3i& stack);
+
+/*!
+ * \brief Compiles a stack to native code, or loads it from the disk cache.
+ *
+ * \param stack Description of an acyclic graph in stack format.
+ * \param options Compiler and cache settings.
+ *
+ * \return The loaded kernel, or an empty pointer if no compiler is available
+ *         or compilation failed.
+ */
+std::shared_ptr<const JitKernel> jit_compile(
+    const Eigen::ArrayX3i& stack,
+    const JitOptions& options = JitOptions());
+
+/*!
+ * \brief Evaluates a native kernel.
+ *
+ * \param kernel A kernel returned by jit_compile.
+ * \param x The input variables to the acyclic graph. (Eigen::ArrayXXd)
+ * \param constants The constants used in the acyclic graph.
+ *
+ * \return The value of the compiled stack. (Eigen::ArrayXXd)
+ */
+Eigen::ArrayXXd evaluate(const JitKernel& kernel,
+                         const Eigen::ArrayXXd& x,
+                         const Eigen::VectorXd& constants);
+
+/*!
+ * \brief Evaluates a native kernel and its derivative.
+ *
+ * \param kernel A kernel returned by jit_compile.
+ * \param x The input variables to the acyclic graph. (Eigen::ArrayXXd)
+ * \param constants The constants used in the acyclic graph.
+ * \param param_x_or_c true: x derivative, false: c derivative
+ *
+ * \return The value of the compiled stack and the gradient.
+ *         (std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd>)
+ */
+std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd> evaluate_with_derivative(
+    const JitKernel& kernel,
+    const Eigen::ArrayXXd& x,
+    const Eigen::VectorXd& constants,
+    const bool param_x_or_c = true);
+} // namespace bingo
+#endif
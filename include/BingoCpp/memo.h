@@ -0,0 +1,231 @@
+/*
+ * Copyright 2018 United States Government as represented by the Administrator
+ * of the National Aeronautics and Space Administration. No copyright is claimed
+ * in the United States under Title 17, U.S. Code. All Other Rights Reserved.
+ *
+ * The Bingo Mini-app platform is licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+*/
+#ifndef INCLUDE_BINGOCPP_MEMO_H_
+#define INCLUDE_BINGOCPP_MEMO_H_
+
+#include <stdint.h>
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <Eigen/Core>
+
+#include "BingoCpp/backend.h"
+#include "BingoCpp/thread_pool.h"
+
+namespace bingo {
+
+/*! \struct MemoStatistics
+ *
+ *  Counters of a SubexpressionMemo since it was built or last reset.
+ *
+ *  \fn double hit_rate() const
+ */
+struct MemoStatistics {
+  //! std::size_t hits
+  /*! lookups which found a value */
+  std::size_t hits;
+  //! std::size_t misses
+  /*! lookups which found nothing; the value was then computed */
+  std::size_t misses;
+  //! std::size_t evictions
+  /*! values dropped to stay within capacity */
+  std::size_t evictions;
+  //! std::size_t entries
+  /*! values currently held */
+  std::size_t entries;
+  //! std::size_t bytes
+  /*! memory held by the values */
+  std::size_t bytes;
+  //! std::size_t capacity_bytes
+  /*! most memory the values may hold */
+  std::size_t capacity_bytes;
+
+  MemoStatistics()
+    : hits(0), misses(0), evictions(0), entries(0), bytes(0),
+      capacity_bytes(0) {}
+  //! \brief fraction of lookups which found a value
+  double hit_rate() const {
+    return hits + misses == 0 ? 0.0
+           : static_cast<double>(hits) / (hits + misses);
+  }
+};
+
+/*! \class SubexpressionMemo
+ *
+ *  Values of evaluated subgraphs, shared across individuals and evaluations.
+ *
+ *  A subgraph is identified by a structural hash of the commands it is made
+ *  of, the values (not the indices) of the constants it reads and a
+ *  fingerprint of the samples it was evaluated at, see subgraph_hashes.  Two
+ *  individuals which share a subgraph, e.g. a common ancestor or a building
+ *  block like X_0 * X_1, then share its value.  The least recently used
+ *  values are evicted once their memory exceeds the capacity.
+ *
+ *  All members are thread safe, so one memo can serve the threads of a
+ *  population evaluation.
+ *
+ *  \note Keys are 64 bit hashes; two different subgraphs sharing a key would
+ *        share a value.
+ *
+ *  \fn std::shared_ptr<const Eigen::ArrayXXd> find(uint64_t key)
+ *  \fn void insert(uint64_t key, const Eigen::ArrayXXd& value)
+ *  \fn void clear()
+ *  \fn MemoStatistics statistics() const
+ *  \fn void reset_statistics()
+ */
+class SubexpressionMemo {
+ public:
+  /*! \brief Creates an empty memo
+   *
+   *  \param[in] capacity_bytes Most memory the values may hold.
+   */
+  explicit SubexpressionMemo(std::size_t capacity_bytes = 256 << 20);
+  /*! \brief looks up the value of a subgraph, counting a hit or a miss
+   *
+   *  \param[in] key Hash of the subgraph. uint64_t
+   *  \return the value, or an empty pointer if it is not held
+   */
+  std::shared_ptr<const Eigen::ArrayXXd> find(uint64_t key);
+  /*! \brief stores the value of a subgraph as the most recently used
+   *
+   *  \param[in] key Hash of the subgraph. uint64_t
+   *  \param[in] value Value of the subgraph at every sample.
+   */
+  void insert(uint64_t key, const Eigen::ArrayXXd& value);
+  //! \brief drops every value
+  void clear();
+  //! \brief gets the counters and the memory in use
+  MemoStatistics statistics() const;
+  //! \brief zeroes the hit, miss and eviction counters
+  void reset_statistics();
+
+ private:
+  typedef std::pair<uint64_t, std::shared_ptr<const Eigen::ArrayXXd> > Entry;
+
+  void evict();
+
+  mutable std::mutex mutex_;
+  std::list<Entry> entries_;
+  std::unordered_map<uint64_t, std::list<Entry>::iterator> index_;
+  MemoStatistics statistics_;
+};
+
+/*!
+ * \brief Fingerprints the values of a set of samples.
+ *
+ * \param x The samples. (Eigen::ArrayXXd)
+ *
+ * \return 64 bit hash of the shape and values of x.
+ */
+uint64_t hash_samples(const Eigen::ArrayXXd& x);
+
+/*!
+ * \brief Hashes the subgraph ending at each utilized command of a stack.
+ *
+ * The hash of a command combines its node with the hashes of its operands,
+ * in either order for + and *, the column of x it loads or the value of the
+ * constant it loads, and samples_hash.
+ *
+ * \param stack Description of an acyclic graph in stack format.
+ * \param constants The constants used in the acyclic graph.
+ * \param mask The commands to hash.
+ * \param samples_hash Fingerprint of the samples, see hash_samples.
+ * \param hashes Filled with the hash of each command in mask.
+ */
+void subgraph_hashes(const Eigen::ArrayX3i& stack,
+                     const Eigen::VectorXd& constants,
+                     const std::vector<bool>& mask,
+                     uint64_t samples_hash,
+                     std::vector<uint64_t>& hashes);
+
+/*!
+ * \brief Evaluates the utilized commands of a stack through a memo table.
+ *
+ * The commands are looked up from the last one down; the operands of a
+ * command found in the memo are not evaluated at all.  Every operator which
+ * is computed is added to the memo.
+ *
+ * \param stack Description of an acyclic graph in stack format.
+ * \param x The input variables to the acyclic graph. (Eigen::ArrayXXd)
+ * \param constants The constants used in the acyclic graph.
+ * \param memo Values of previously evaluated subgraphs.
+ * \param workspace Buffers to evaluate into; the value of the stack is left
+ *                  in workspace.result(). (EvaluationWorkspace)
+ */
+void evaluate(const Eigen::ArrayX3i& stack,
+              const Eigen::ArrayXXd& x,
+              const Eigen::VectorXd& constants,
+              SubexpressionMemo& memo,
+              EvaluationWorkspace& workspace);
+
+/*!
+ * \brief Evaluates the utilized commands of a stack through a memo table.
+ *
+ * \param stack Description of an acyclic graph in stack format.
+ * \param x The input variables to the acyclic graph. (Eigen::ArrayXXd)
+ * \param constants The constants used in the acyclic graph.
+ * \param memo Values of previously evaluated subgraphs.
+ *
+ * \return The value of the stack. (Eigen::ArrayXXd)
+ */
+Eigen::ArrayXXd evaluate(const Eigen::ArrayX3i& stack,
+                         const Eigen::ArrayXXd& x,
+                         const Eigen::VectorXd& constants,
+                         SubexpressionMemo& memo);
+
+/*!
+ * \brief Evaluates a population of stacks through a memo table.
+ *
+ * \param stacks The stacks to evaluate.
+ * \param x The input variables shared by all stacks. (Eigen::ArrayXXd)
+ * \param constants The constants used by each stack.
+ * \param memo Values of previously evaluated subgraphs.
+ *
+ * \return The values of the stacks, one per column. (Eigen::ArrayXXd)
+ */
+Eigen::ArrayXXd evaluate_population(
+    const std::vector<Eigen::ArrayX3i>& stacks,
+    const Eigen::ArrayXXd& x,
+    const std::vector<Eigen::VectorXd>& constants,
+    SubexpressionMemo& memo);
+
+/*!
+ * \brief Evaluates a population of stacks in parallel through a memo table.
+ *
+ * \param stacks The stacks to evaluate.
+ * \param x The input variables shared by all stacks. (Eigen::ArrayXXd)
+ * \param constants The constants used by each stack.
+ * \param memo Values of previously evaluated subgraphs.
+ * \param pool The threads evaluating the stacks.
+ *
+ * \return The values of the stacks, one per column. (Eigen::ArrayXXd)
+ */
+Eigen::ArrayXXd evaluate_population(
+    const std::vector<Eigen::ArrayX3i>& stacks,
+    const Eigen::ArrayXXd& x,
+    const std::vector<Eigen::VectorXd>& constants,
+    SubexpressionMemo& memo,
+    ThreadPool& pool);
+} // namespace bingo
+#endif
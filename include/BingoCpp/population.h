@@ -0,0 +1,228 @@
+/*
+ * Copyright 2018 United States Government as represented by the Administrator
+ * of the National Aeronautics and Space Administration. No copyright is claimed
+ * in the United States under Title 17, U.S. Code. All Other Rights Reserved.
+ *
+ * The Bingo Mini-app platform is licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+*/
+#ifndef INCLUDE_BINGOCPP_POPULATION_H_
+#define INCLUDE_BINGOCPP_POPULATION_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include <Eigen/Dense>
+#include <Eigen/Core>
+
+#include "BingoCpp/acyclic_graph.h"
+
+namespace bingo {
+
+/*! \class BasicPopulation
+ *
+ *  A population of acyclic graphs stored as structure of arrays.
+ *
+ *  The stacks of all individuals share one contiguous buffer of
+ *  size() x stack_size() x 3 commands, row major, so that individual i
+ *  occupies stack_size() * 3 consecutive values.  Command is the integer
+ *  type of the buffer: int, or int16_t for half the memory when stacks have
+ *  fewer than 32768 commands.  Constants are packed back to back in one
+ *  arena and fitness, age and flags are parallel arrays indexed by
+ *  individual.  Copying a population copies a handful of flat buffers.
+ *
+ *  Individuals are accessed through views into the buffers; individual and
+ *  set_individual convert to and from AcyclicGraph.
+ *
+ *  \fn StackView stack(int i)
+ *  \fn ConstantsView constants(int i)
+ *  \fn void set_constants(int i, const Eigen::VectorXd &constants)
+ *  \fn void reset_constants(const std::vector<int> &counts)
+ *  \fn AcyclicGraph individual(int i) const
+ *  \fn void set_individual(int i, const AcyclicGraph &indv)
+ *  \fn void copy_individual(int from, int to)
+ *  \fn void set_command(int i, int row, int node, int param1, int param2)
+ *  \fn void crossover(int parent1, int parent2, int child1, int child2, int cross_point)
+ */
+template <typename Command>
+class BasicPopulation {
+ public:
+  typedef Eigen::Array<Command, Eigen::Dynamic, 3, Eigen::RowMajor>
+    StackArray;
+  typedef Eigen::Map<StackArray> StackView;
+  typedef Eigen::Map<const StackArray> ConstStackView;
+  typedef Eigen::Map<Eigen::VectorXd> ConstantsView;
+  typedef Eigen::Map<const Eigen::VectorXd> ConstConstantsView;
+
+  //! std::vector<double> fitness
+  /*! fitness of each individual, meaningful where fit_set */
+  std::vector<double> fitness;
+  //! std::vector<int> genetic_age
+  /*! genetic age of each individual */
+  std::vector<int> genetic_age;
+  //! std::vector<char> fit_set
+  /*! whether the fitness of each individual is set */
+  std::vector<char> fit_set;
+  //! std::vector<char> needs_opt
+  /*! whether the constants of each individual need optimization */
+  std::vector<char> needs_opt;
+  //! int opt_rate
+  /*! optimization rate of the individuals, see AcyclicGraph::opt_rate */
+  int opt_rate;
+  //! bool eliminate_common_subexpressions
+  /*! merge duplicate commands of the simple_stack built by individual, see
+   *  AcyclicGraphManipulator::eliminate_common_subexpressions */
+  bool eliminate_common_subexpressions;
+  //! bool rewrite_identities
+  /*! apply rewrite_stack to the simple_stack built by individual, see
+   *  AcyclicGraphManipulator::rewrite_identities */
+  bool rewrite_identities;
+
+  /*! \brief Creates a population of empty individuals
+   *
+   *  Every stack is filled with X_0 loads and has no constants.
+   *
+   *  \param[in] pop_size Number of individuals. int
+   *  \param[in] stack_size Number of commands per stack. int
+   */
+  explicit BasicPopulation(int pop_size = 0, int stack_size = 0);
+  //! \brief number of individuals
+  int size() const {
+    return fitness.size();
+  }
+  //! \brief number of commands per stack
+  int stack_size() const {
+    return stack_size_;
+  }
+  //! \brief the buffer holding every stack, individual after individual
+  const std::vector<Command> &commands() const {
+    return commands_;
+  }
+  //! \brief view of the stack of an individual
+  StackView stack(int i) {
+    return StackView(commands_.data() + offset(i), stack_size_, 3);
+  }
+  //! \brief view of the stack of an individual
+  ConstStackView stack(int i) const {
+    return ConstStackView(commands_.data() + offset(i), stack_size_, 3);
+  }
+  //! \brief view of the constants of an individual
+  ConstantsView constants(int i) {
+    return ConstantsView(constant_values_.data() + constant_offsets_[i],
+                         num_constants(i));
+  }
+  //! \brief view of the constants of an individual
+  ConstConstantsView constants(int i) const {
+    return ConstConstantsView(constant_values_.data() + constant_offsets_[i],
+                              num_constants(i));
+  }
+  //! \brief number of constants of an individual
+  int num_constants(int i) const {
+    return constant_offsets_[i + 1] - constant_offsets_[i];
+  }
+  /*! \brief replaces the constants of an individual
+   *
+   *  Changing the number of constants moves the constants of the following
+   *  individuals within the arena.
+   *
+   *  \param[in] i The individual. int
+   *  \param[in] constants Its new constants. Eigen::VectorXd
+   */
+  void set_constants(int i, const Eigen::VectorXd &constants);
+  /*! \brief replaces the constants of every individual by zeros
+   *
+   *  Lays out the whole arena in one pass, e.g. after filling the stacks of
+   *  a new population.
+   *
+   *  \param[in] counts Number of constants of each individual.
+   *             std::vector<int>
+   */
+  void reset_constants(const std::vector<int> &counts);
+  /*! \brief copies an individual out of the population
+   *
+   *  The population stores no simplified stacks; the simplified stack is
+   *  built here, merged or rewritten as eliminate_common_subexpressions and
+   *  rewrite_identities ask, as AcyclicGraphManipulator::simplify_stack
+   *  does.
+   *
+   *  \param[in] i The individual. int
+   *  \return AcyclicGraph with the stack, simplified stack, constants,
+   *          fitness and flags of the individual
+   */
+  AcyclicGraph individual(int i) const;
+  /*! \brief copies an individual into the population
+   *
+   *  \param[in] i The slot to fill. int
+   *  \param[in] indv An individual with a stack of stack_size() commands.
+   *             AcyclicGraph
+   */
+  void set_individual(int i, const AcyclicGraph &indv);
+  /*! \brief copies one individual over another
+   *
+   *  \param[in] from The individual to copy. int
+   *  \param[in] to The slot to overwrite. int
+   */
+  void copy_individual(int from, int to);
+  /*! \brief overwrites one command of an individual, clearing its fitness
+   *
+   *  \param[in] i The individual. int
+   *  \param[in] row The command. int
+   *  \param[in] node The new node. int
+   *  \param[in] param1 The new first parameter. int
+   *  \param[in] param2 The new second parameter. int
+   */
+  void set_command(int i, int row, int node, int param1, int param2);
+  /*! \brief single point crossover within the population
+   *
+   *  \param[in] parent1 The first parent. int
+   *  \param[in] parent2 The second parent. int
+   *  \param[in] child1 The slot of the first child. int
+   *  \param[in] child2 The slot of the second child. int
+   *  \param[in] cross_point First exchanged command. int
+   *
+   *  The children are the parents with the commands from cross_point on
+   *  exchanged.  child1 may be parent1 and child2 may be parent2, in which
+   *  case the parents are replaced in place; otherwise the children must be
+   *  distinct from both parents.  The utilized constants of each child are
+   *  renumbered in stack order and take their values from the parent their
+   *  command came from, as AcyclicGraphManipulator::crossover does with
+   *  opt_rate 2; a child needs optimization if one of them has no value, or
+   *  always with opt_rate 3 or 5.  Children take the older genetic age and
+   *  lose their fitness.
+   */
+  void crossover(int parent1, int parent2, int child1, int child2,
+                 int cross_point);
+
+ private:
+  int offset(int i) const {
+    return i * stack_size_ * 3;
+  }
+  void resize_constants(int i, int count);
+  void merge_constants(int child, int cross_point,
+                       const Eigen::VectorXd &head, bool head_needs_opt,
+                       const Eigen::VectorXd &tail, bool tail_needs_opt);
+
+  int stack_size_;
+  std::vector<Command> commands_;
+  std::vector<double> constant_values_;
+  std::vector<int> constant_offsets_;
+};
+
+//! population with int commands
+typedef BasicPopulation<int> Population;
+//! population with int16_t commands, for stacks of fewer than 32768 commands
+typedef BasicPopulation<int16_t> CompactPopulation;
+
+extern template class BasicPopulation<int>;
+extern template class BasicPopulation<int16_t>;
+} // namespace bingo
+#endif
@@ -0,0 +1,110 @@
+/*
+ * Copyright 2018 United States Government as represented by the Administrator
+ * of the National Aeronautics and Space Administration. No copyright is claimed
+ * in the United States under Title 17, U.S. Code. All Other Rights Reserved.
+ *
+ * The Bingo Mini-app platform is licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+*/
+#ifndef INCLUDE_BINGOCPP_RANDOM_H_
+#define INCLUDE_BINGOCPP_RANDOM_H_
+
+#include <stdint.h>
+
+namespace bingo {
+
+/*! \class Xoshiro256
+ *
+ *  The xoshiro256** pseudo random number generator.
+ *
+ *  Each generator is a 256 bit state without locks, so every thread (or
+ *  every manipulator) can own one and draw numbers reproducibly.  jump
+ *  advances a generator by 2^128 draws; a copy jumped k times gives an
+ *  independent stream for the k-th of several threads.  The class meets the
+ *  requirements of a uniform random bit generator, so it can also drive the
+ *  distributions of <random>.
+ *
+ *  \fn void seed(uint64_t seed)
+ *  \fn void jump()
+ *  \fn uint64_t operator()()
+ *  \fn int uniform_int(int n)
+ *  \fn float uniform_float()
+ */
+class Xoshiro256 {
+ public:
+  typedef uint64_t result_type;
+
+  /*! \brief Creates a generator from a seed
+   *
+   *  \param[in] seed Any value; equal seeds give equal streams. uint64_t
+   */
+  explicit Xoshiro256(uint64_t seed = 0) {
+    this->seed(seed);
+  }
+  /*! \brief restarts the generator from a seed
+   *
+   *  The state is filled from seed with splitmix64, so that nearby seeds
+   *  give unrelated streams.
+   *
+   *  \param[in] seed Any value; equal seeds give equal streams. uint64_t
+   */
+  void seed(uint64_t seed);
+  /*! \brief advances the generator by 2^128 draws
+   *
+   *  Streams a jump apart do not overlap for any practical run length.
+   */
+  void jump();
+  //! \brief smallest value drawn
+  static constexpr uint64_t min() {
+    return 0;
+  }
+  //! \brief largest value drawn
+  static constexpr uint64_t max() {
+    return ~static_cast<uint64_t>(0);
+  }
+  //! \brief draws 64 random bits
+  uint64_t operator()() {
+    uint64_t result = rotate(state_[1] * 5, 7) * 9;
+    uint64_t t = state_[1] << 17;
+    state_[2] ^= state_[0];
+    state_[3] ^= state_[1];
+    state_[1] ^= state_[2];
+    state_[0] ^= state_[3];
+    state_[2] ^= t;
+    state_[3] = rotate(state_[3], 45);
+    return result;
+  }
+  /*! \brief draws an integer uniformly from [0, n)
+   *
+   *  \param[in] n Number of possible values, positive. int
+   *  \return int the value drawn
+   */
+  int uniform_int(int n) {
+    return static_cast<int>(((*this)() >> 32) * static_cast<uint64_t>(n) >>
+                            32);
+  }
+  /*! \brief draws a float uniformly from [0, 1)
+   *
+   *  \return float the value drawn
+   */
+  float uniform_float() {
+    return static_cast<float>((*this)() >> 40) * (1.0f / 16777216.0f);
+  }
+
+ private:
+  static uint64_t rotate(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+  }
+
+  uint64_t state_[4];
+};
+} // namespace bingo
+#endif
@@ -0,0 +1,54 @@
+/*
+ * Copyright 2018 United States Government as represented by the Administrator
+ * of the National Aeronautics and Space Administration. No copyright is claimed
+ * in the United States under Title 17, U.S. Code. All Other Rights Reserved.
+ *
+ * The Bingo Mini-app platform is licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+*/
+#ifndef INCLUDE_BINGOCPP_REWRITE_H_
+#define INCLUDE_BINGOCPP_REWRITE_H_
+
+#include <Eigen/Dense>
+#include <Eigen/Core>
+
+namespace bingo {
+
+/*!
+ * \brief Applies algebraic identities to shrink a stack.
+ *
+ * The stack is simplified, then every command is rewritten bottom-up with
+ * the identities of the backend's operators, as defined for the node types
+ * of AcyclicGraph::stack_print_map.  Among others:
+ *
+ *   - a - a = 0, and the neutral and absorbing elements 0 and 1 of +, -, *,
+ *     a / 1 and pow, with sin, cos, exp, log, abs and sqrt of 0 and 1 folded
+ *     to 0 or 1 where exact;
+ *   - abs of a value which is never negative (exp, pow, abs, sqrt) is that
+ *     value, and abs is dropped under log, pow (base), sqrt, cos and abs,
+ *     which only read the magnitude of their operand;
+ *   - exp(log|a|) = |a|, log|exp(a)| = a and sqrt|a| * sqrt|a| = |a|.
+ *
+ * Zero and one have no command of their own; they are recognized from
+ * commands such as a - a and cos(a - a), which are kept to produce them.
+ * The identities hold for finite values: a - a is 0 even where a is
+ * infinite.  0 / b and a / a are not rewritten, since a finite zero makes
+ * them NaN.
+ * Constants keep their indices, so the constants of the stack still apply
+ * (some may no longer be used).
+ *
+ * \param stack Description of an acyclic graph in stack format.
+ *
+ * \return Simplified stack computing the same function.
+ */
+Eigen::ArrayX3i rewrite_stack(const Eigen::ArrayX3i& stack);
+} // namespace bingo
+#endif
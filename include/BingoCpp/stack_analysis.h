@@ -0,0 +1,110 @@
+/*
+ * Copyright 2018 United States Government as represented by the Administrator
+ * of the National Aeronautics and Space Administration. No copyright is claimed
+ * in the United States under Title 17, U.S. Code. All Other Rights Reserved.
+ *
+ * The Bingo Mini-app platform is licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+*/
+#ifndef INCLUDE_BINGOCPP_STACK_ANALYSIS_H_
+#define INCLUDE_BINGOCPP_STACK_ANALYSIS_H_
+
+#include <vector>
+
+#include <Eigen/Dense>
+#include <Eigen/Core>
+
+namespace bingo {
+
+/*! \struct StackAnalysis
+ *
+ *  The utilized commands of a stack and where they go when it is simplified.
+ *
+ *  All members are flat arrays indexed by row (or by utilized command) and
+ *  are filled in one pass over the stack by analyze_stack.  Arrays only grow,
+ *  so once an analysis has seen the largest stack it is used with, further
+ *  analyses do not allocate.  An analysis is not thread safe; each thread
+ *  should own its own.
+ *
+ *  \fn bool is_utilized(int row) const
+ *  \fn int utilized_row(int index) const
+ */
+struct StackAnalysis {
+  //! std::vector<bool> mask
+  /*! whether each command is utilized, see get_utilized_commands */
+  std::vector<bool> mask;
+  //! std::vector<int> remap
+  /*! row of each utilized command in the simplified stack, -1 if unused */
+  std::vector<int> remap;
+  //! std::vector<int> utilized_rows
+  /*! rows of the utilized commands, in stack order */
+  std::vector<int> utilized_rows;
+  //! std::vector<int> constant_number
+  /*! number of each utilized constant in stack order, -1 otherwise */
+  std::vector<int> constant_number;
+  //! int num_utilized
+  /*! number of utilized commands */
+  int num_utilized;
+  //! int num_constants
+  /*! number of utilized constant loads */
+  int num_constants;
+
+  StackAnalysis() : num_utilized(0), num_constants(0) {}
+  /*! \brief whether a command is utilized
+   *
+   *  \param[in] row Row of the command. int
+   */
+  bool is_utilized(int row) const {
+    return mask[row];
+  }
+  /*! \brief row of a utilized command, e.g. to pick one at random
+   *
+   *  \param[in] index Which utilized command, from 0 to num_utilized - 1. int
+   *  \return int the row of the command in the stack
+   */
+  int utilized_row(int index) const {
+    return utilized_rows[index];
+  }
+};
+
+/*!
+ * \brief Finds the utilized commands of a stack and their simplified layout.
+ *
+ * \param stack Description of an acyclic graph in stack format.
+ * \param analysis Filled with the analysis of stack.
+ */
+void analyze_stack(const Eigen::ArrayX3i& stack, StackAnalysis& analysis);
+
+/*!
+ * \brief The analysis owned by the calling thread.
+ *
+ * Lets callers which analyze a stack on every variation reuse one set of
+ * buffers per thread.
+ *
+ * \return The analysis of this thread.
+ */
+StackAnalysis& thread_stack_analysis();
+
+/*!
+ * \brief Copies the utilized commands of a stack into a simplified stack.
+ *
+ * Operands are renumbered with analysis.remap and the second operand of a
+ * unary command is set to its first.  Terminals are copied as is.
+ *
+ * \param stack Description of an acyclic graph in stack format.
+ * \param analysis The analysis of stack, see analyze_stack.
+ * \param simple_stack Filled with the utilized commands.
+ */
+void simplify_stack(const Eigen::ArrayX3i& stack,
+                    const StackAnalysis& analysis,
+                    Eigen::ArrayX3i& simple_stack);
+} // namespace bingo
+#endif
@@ -0,0 +1,115 @@
+/*!
+ * \file thread_pool.h
+ *
+ * This file contains a work-stealing thread pool used to evaluate
+ * populations of individuals in parallel.
+ *
+ * Copyright 2018 United States Government as represented by the Administrator
+ * of the National Aeronautics and Space Administration. No copyright is claimed
+ * in the United States under Title 17, U.S. Code. All Other Rights Reserved.
+ *
+ * The Bingo Mini-app platform is licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with the
+ * License. You may obtain a copy of the License at
+ * http://www.apache.org/licenses/LICENSE-2.0.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+#ifndef INCLUDE_BINGOCPP_THREAD_POOL_H_
+#define INCLUDE_BINGOCPP_THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace bingo {
+
+/*! \class ThreadPool
+ *
+ *  A fixed set of worker threads that run the iterations of a parallel loop.
+ *
+ *  Every thread owns a deque of task indices.  The iterations of a loop are
+ *  split into contiguous blocks, one per deque.  A thread takes work from the
+ *  back of its own deque and, once that is empty, steals from the front of
+ *  the others, so uneven task costs (e.g. constant optimization of some
+ *  individuals only) are balanced across the threads.
+ *
+ *  The thread calling parallel_for takes part in the loop, so a pool of n
+ *  threads starts n - 1 workers.  Callers write the result of task i into
+ *  slot i of their output, which keeps results in a deterministic order
+ *  whatever thread ran the task.
+ *
+ *  \note parallel_for called from inside one of the pool's own tasks runs
+ *        its loop serially on the calling thread.  Loops started by
+ *        different outside threads take turns.
+ *
+ *  \fn int num_threads() const
+ *  \fn void parallel_for(int num_tasks, const std::function<void(int)>& task)
+ */
+class ThreadPool {
+ public:
+  /*! \brief Starts the worker threads
+   *
+   *  \param[in] num_threads Number of threads running tasks, including the
+   *                         calling thread.  0 uses one per hardware thread.
+   */
+  explicit ThreadPool(int num_threads = 0);
+  ~ThreadPool();
+  /*! \brief gets the number of threads running tasks
+   *
+   *  \return the number of threads, including the calling thread
+   */
+  int num_threads() const {
+    return static_cast<int>(queues_.size());
+  }
+  /*! \brief Runs task(i) for every i in [0, num_tasks) and waits for them
+   *
+   *  If a task throws, the tasks not started yet are skipped and the first
+   *  exception is rethrown once every thread has left the loop.
+   *
+   *  \param[in] num_tasks The number of iterations. int
+   *  \param[in] task The body of the loop, called with the iteration index.
+   */
+  void parallel_for(int num_tasks, const std::function<void(int)>& task);
+
+ private:
+  struct TaskQueue {
+    std::mutex mutex;
+    std::deque<int> tasks;
+  };
+
+  ThreadPool(const ThreadPool&);
+  ThreadPool& operator=(const ThreadPool&);
+
+  void worker_loop(int thread_id);
+  void run_tasks(int thread_id, const std::function<void(int)>& task);
+  bool pop_task(int thread_id, int& task_index);
+  bool steal_task(int thread_id, int& task_index);
+
+  std::vector<std::unique_ptr<TaskQueue> > queues_;
+  std::vector<std::thread> workers_;
+  std::mutex caller_mutex_;
+  std::mutex mutex_;
+  std::condition_variable start_condition_;
+  std::condition_variable done_condition_;
+  const std::function<void(int)>* task_;
+  std::exception_ptr exception_;
+  long generation_;
+  int active_workers_;
+  bool stop_;
+  std::atomic<int> pending_tasks_;
+  std::atomic<bool> failed_;
+};
+} // namespace bingo
+#endif
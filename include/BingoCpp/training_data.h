@@ -25,8 +25,11 @@
 #ifndef INCLUDE_BINGOCPP_TRAINING_DATA_H_
 #define INCLUDE_BINGOCPP_TRAINING_DATA_H_
 
+#include <stdint.h>
+
 #include <Eigen/Dense>
 #include <Eigen/Core>
+#include <atomic>
 #include <vector>
 #include <list>
 
@@ -44,7 +47,18 @@ namespace bingo {
  */
 struct TrainingData {
  public:
-  TrainingData() { }
+  //! std::atomic<uint64_t> dataset_id
+  /*! hash of the data once computed by training_data_id, 0 before; reset
+   *  it to 0 after changing the data in place */
+  std::atomic<uint64_t> dataset_id;
+  TrainingData() : dataset_id(0) { }
+  //! \brief copies are hashed again on first use
+  TrainingData(const TrainingData &) : dataset_id(0) { }
+  TrainingData &operator=(const TrainingData &) {
+    dataset_id = 0;
+    return *this;
+  }
+  virtual ~TrainingData() { }
   /*! \brief gets a new training data with certain rows
   *
   *  \param[in] items The rows to retrieve. std::list<int>
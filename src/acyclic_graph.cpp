@@ -9,10 +9,12 @@
  */
 #include <iostream>
 #include <iomanip>
+#include <utility>
 
 #include "BingoCpp/acyclic_graph.h"
 #include "BingoCpp/backend.h"
 #include "BingoCpp/acyclic_graph_nodes.h"
+#include "BingoCpp/stack_analysis.h"
 
 namespace bingo {
 
@@ -36,19 +38,55 @@ AcyclicGraph::AcyclicGraph(const AcyclicGraph &ag) {
   needs_opt = ag.needs_opt;
   opt_rate = ag.opt_rate;
   genetic_age = ag.genetic_age;
+  program = ag.program;
+  native_kernel = ag.native_kernel;
+  evaluation_cache = ag.evaluation_cache;
+}
+
+AcyclicGraph::AcyclicGraph(AcyclicGraph &&ag) noexcept
+  : stack(std::move(ag.stack)), simple_stack(std::move(ag.simple_stack)),
+    constants(std::move(ag.constants)), fitness(std::move(ag.fitness)),
+    fit_set(ag.fit_set), needs_opt(ag.needs_opt), opt_rate(ag.opt_rate),
+    genetic_age(ag.genetic_age), program(std::move(ag.program)),
+    native_kernel(std::move(ag.native_kernel)),
+    evaluation_cache(std::move(ag.evaluation_cache)) {}
+
+AcyclicGraph &AcyclicGraph::operator=(const AcyclicGraph &ag) {
+  if (this != &ag) {
+    stack = ag.stack;
+    constants = ag.constants;
+    simple_stack = ag.simple_stack;
+    fitness = ag.fitness;
+    fit_set = ag.fit_set;
+    needs_opt = ag.needs_opt;
+    opt_rate = ag.opt_rate;
+    genetic_age = ag.genetic_age;
+    program = ag.program;
+    native_kernel = ag.native_kernel;
+    evaluation_cache = ag.evaluation_cache;
+  }
+  return *this;
+}
+
+AcyclicGraph &AcyclicGraph::operator=(AcyclicGraph &&ag) noexcept {
+  if (this != &ag) {
+    stack = std::move(ag.stack);
+    constants = std::move(ag.constants);
+    simple_stack = std::move(ag.simple_stack);
+    fitness = std::move(ag.fitness);
+    fit_set = ag.fit_set;
+    needs_opt = ag.needs_opt;
+    opt_rate = ag.opt_rate;
+    genetic_age = ag.genetic_age;
+    program = std::move(ag.program);
+    native_kernel = std::move(ag.native_kernel);
+    evaluation_cache = std::move(ag.evaluation_cache);
+  }
+  return *this;
 }
 
 AcyclicGraph AcyclicGraph::copy() {
-  AcyclicGraph temp = AcyclicGraph();
-  temp.stack = stack;
-  temp.constants = constants;
-  temp.simple_stack = simple_stack;
-  temp.fitness = fitness;
-  temp.fit_set = fit_set;
-  temp.needs_opt = needs_opt;
-  temp.opt_rate = opt_rate;
-  temp.genetic_age = genetic_age;
-  return temp;
+  return AcyclicGraph(*this);
 }
 
 const char *AcyclicGraph::stack_print_map[13] = {
@@ -121,21 +159,29 @@ void AcyclicGraph::set_constants(Eigen::VectorXd con) {
 
 int AcyclicGraph::count_constants() {
   if (opt_rate == 0) {
-    std::set<int> util = utilized_commands();
-    std::set<int>::iterator it = util.begin();
-    int const_num = 0;
-
-    for (int i = 0; i < simple_stack.rows(); ++i, ++it) {
-      if (simple_stack(i, 0) == 1) {
-        simple_stack(i, 1) = const_num;
-        simple_stack(i, 2) = const_num;
-        stack(*it, 1) = const_num;
-        stack(*it, 2) = const_num;
-        const_num += 1;
+    StackAnalysis& analysis = thread_stack_analysis();
+    analyze_stack(stack, analysis);
+
+    for (int row = 0; row < stack.rows(); ++row) {
+      if (stack(row, 0) == 1 && analysis.is_utilized(row)) {
+        stack(row, 1) = analysis.constant_number[row];
+        stack(row, 2) = analysis.constant_number[row];
+      }
+    }
+
+    // a merged or rewritten simple_stack has fewer rows than there are
+    // utilized commands; its constants were numbered before merging
+    if (simple_stack.rows() == analysis.num_utilized) {
+      for (int i = 0; i < simple_stack.rows(); ++i) {
+        if (simple_stack(i, 0) == 1) {
+          int row = analysis.utilized_row(i);
+          simple_stack(i, 1) = analysis.constant_number[row];
+          simple_stack(i, 2) = analysis.constant_number[row];
+        }
       }
     }
 
-    return const_num;
+    return analysis.num_constants;
 
   } else {
     return constants.size();
@@ -175,21 +221,82 @@ int AcyclicGraph::count_constants() {
 //     constants.conservativeResize(const_num);
 // }
 
+const Program &AcyclicGraph::compiled_program() {
+  if (!program || !is_compiled_from(*program, simple_stack)) {
+    program = std::make_shared<const Program>(compile_stack(simple_stack));
+  }
+
+  return *program;
+}
+
+bool AcyclicGraph::compile_native(const JitOptions &options) {
+  if (!native_kernel || !native_kernel->is_compiled_from(simple_stack)) {
+    native_kernel = jit_compile(simple_stack, options);
+  }
+
+  return static_cast<bool>(native_kernel);
+}
+
+void AcyclicGraph::enable_evaluation_cache() {
+  if (!evaluation_cache) {
+    evaluation_cache = std::make_shared<EvaluationCache>();
+  }
+}
+
 Eigen::ArrayXXd AcyclicGraph::evaluate(Eigen::ArrayXXd &eval_x) {
-  return bingo::evaluate(simple_stack, eval_x, constants);
+  if (native_kernel && native_kernel->is_compiled_from(simple_stack)) {
+    return bingo::evaluate(*native_kernel, eval_x, constants);
+  }
+
+  if (evaluation_cache && stack.rows() > 0) {
+    // the cache of a copy is cloned before it diverges from the original
+    if (evaluation_cache.use_count() > 1) {
+      evaluation_cache = std::make_shared<EvaluationCache>(*evaluation_cache);
+    }
+
+    evaluate_incremental(stack, eval_x, constants, *evaluation_cache);
+    return evaluation_cache->result();
+  }
+
+  return bingo::evaluate(compiled_program(), eval_x, constants);
 }
 
 std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd> AcyclicGraph::evaluate_deriv(
   Eigen::ArrayXXd &eval_x) {
+  if (native_kernel && native_kernel->is_compiled_from(simple_stack)) {
+    return evaluate_with_derivative(*native_kernel, eval_x, constants);
+  }
+
   return evaluate_with_derivative(simple_stack, eval_x, constants);
 }
 
 std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd>
 AcyclicGraph::evaluate_with_const_deriv(
   Eigen::ArrayXXd &eval_x) {
+  if (native_kernel && native_kernel->is_compiled_from(simple_stack)) {
+    return evaluate_with_derivative(*native_kernel, eval_x, constants, false);
+  }
+
   return evaluate_with_derivative(simple_stack, eval_x, constants, false);
 }
 
+Eigen::ArrayXXd AcyclicGraph::evaluate(Eigen::ArrayXXd &eval_x,
+                                       ThreadPool &pool) {
+  return bingo::evaluate(compiled_program(), eval_x, constants, pool);
+}
+
+std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd> AcyclicGraph::evaluate_deriv(
+  Eigen::ArrayXXd &eval_x, ThreadPool &pool) {
+  return evaluate_with_derivative(simple_stack, eval_x, constants, pool);
+}
+
+std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd>
+AcyclicGraph::evaluate_with_const_deriv(
+  Eigen::ArrayXXd &eval_x, ThreadPool &pool) {
+  return evaluate_with_derivative(simple_stack, eval_x, constants, pool,
+                                  false);
+}
+
 
 // TODO: remove iterator interface
 std::string AcyclicGraph::latexstring() {
@@ -267,17 +374,10 @@ std::string AcyclicGraph::latexstring() {
 }
 
 std::set<int> AcyclicGraph::utilized_commands() {
-  std::set<int> util;
-  util.insert(stack.rows() - 1);
-
-  for (int i = stack.rows() - 1; i >= 0; --i) {
-    if (stack(i, 0) > 1 && util.count(i) == 1) {
-      util.insert(stack(i, 1));
-      util.insert(stack(i, 2));
-    }
-  }
-
-  return util;
+  StackAnalysis& analysis = thread_stack_analysis();
+  analyze_stack(stack, analysis);
+  return std::set<int>(analysis.utilized_rows.begin(),
+                       analysis.utilized_rows.begin() + analysis.num_utilized);
 }
 
 int AcyclicGraph::complexity() {
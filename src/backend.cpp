@@ -1,11 +1,15 @@
+#include <algorithm>
 #include <map>
 #include <numeric>
+#include <tuple>
 
 #include <Eigen/Dense>
 
 #include "BingoCpp/acyclic_graph.h"
 #include "BingoCpp/backend.h"
 #include "BingoCpp/backend_nodes.h"
+#include "BingoCpp/bytecode.h"
+#include "BingoCpp/stack_analysis.h"
 
 const int NODE_IDX = 0;
 const int OP_1 = 1;
@@ -14,52 +18,55 @@ const int OP_2 = 2;
 namespace bingo {
 namespace {
 
-Eigen::ArrayXXd reverse_eval(const std::pair<int, int>& deriv_shape,
-                             const int deriv_wrt_node,
-                             const std::vector<Eigen::ArrayXXd>& forward_eval,
-                             const Eigen::ArrayX3i& stack) {
-  int num_samples = deriv_shape.first;
-  int num_features = deriv_shape.second;
-  int stack_depth = stack.rows();
+// Size of the cache a tile of intermediate values should fit in.
+const int TILE_CACHE_BYTES = 256 * 1024;
+// Tiles are a whole number of cache lines (of doubles) and never tiny.
+const int TILE_ALIGNMENT = 64;
+// Rows of x below which splitting them across threads does not pay off.
+const int MIN_PARTITION_ROWS = 4096;
 
-  Eigen::ArrayXXd derivative = Eigen::ArrayXXd::Zero(num_samples, num_features);
-  std::vector<Eigen::ArrayXXd> reverse_eval(stack_depth); 
-  for (int row = 0; row < stack_depth; row++) {
-      reverse_eval[row] = Eigen::ArrayXd::Zero(num_samples);
-  }
+const int X_LOAD = 0;
+const int C_LOAD = 1;
+const int ADDITION = 2;
+const int SUBTRACTION = 3;
+const int MULTIPLICATION = 4;
+const int DIVISION = 5;
+const int SIN = 6;
+const int COS = 7;
+const int EXP = 8;
+const int LOG = 9;
+const int POWER = 10;
+const int ABSOLUTE = 11;
+const int SQRT = 12;
 
-  reverse_eval[stack_depth-1] = Eigen::ArrayXd::Ones(num_samples);
-  for (int i = stack_depth - 1; i >= 0; i--) {
-    int node = stack(i, NODE_IDX);
-    int param1 = stack(i, OP_1);
-    int param2 = stack(i, OP_2);
-    if (node == deriv_wrt_node) {
-      derivative.col(param1) += reverse_eval[i];
-    } else {
-      reverse_eval_function(node, i, param1, param2, forward_eval, reverse_eval);
-    }
+typedef Eigen::Ref<const Eigen::ArrayXXd> XTile;
+
+int tile_rows(const EvaluationWorkspace& workspace, int num_samples,
+              int arrays_per_sample) {
+  int tile = workspace.tile_size;
+  if (tile <= 0) {
+    tile = TILE_CACHE_BYTES / (sizeof(double) * std::max(arrays_per_sample, 1));
+    tile = std::max(tile - tile % TILE_ALIGNMENT, TILE_ALIGNMENT);
   }
-  return derivative;
+  return std::min(tile, num_samples);
 }
 
-Eigen::ArrayXXd reverse_eval_with_mask(const std::pair<int, int>& deriv_shape,
-                                       const int deriv_wrt_node,
-                                       const std::vector<Eigen::ArrayXXd>& forward_eval,
-                                       const Eigen::ArrayX3i& stack,
-                                       const std::vector<bool>& mask) {
-  int num_samples = deriv_shape.first;
-  int num_features = deriv_shape.second;
+void reverse_eval_with_mask(const int deriv_wrt_node,
+                            const Eigen::ArrayX3i& stack,
+                            const std::vector<bool>& mask,
+                            EvaluationWorkspace& workspace,
+                            Eigen::Ref<Eigen::ArrayXXd> derivative) {
+  int num_samples = derivative.rows();
   int stack_depth = stack.rows();
+  std::vector<Eigen::ArrayXXd>& reverse_eval = workspace.reverse_eval;
 
-  Eigen::ArrayXXd derivative = Eigen::ArrayXXd::Zero(num_samples, num_features);
-  std::vector<Eigen::ArrayXXd> reverse_eval(stack_depth); 
   for (int row = 0; row < stack_depth; row++) {
     if (mask[row]) {
-      reverse_eval[row] = Eigen::ArrayXd::Zero(num_samples);
+      reverse_eval[row].setZero(num_samples, 1);
     }
   }
 
-  reverse_eval[stack_depth-1] = Eigen::ArrayXd::Ones(num_samples);
+  reverse_eval[stack_depth-1].setOnes();
   for (int i = stack_depth - 1; i >= 0; i--) {
     if (mask[i]) {
       int node = stack(i, NODE_IDX);
@@ -68,96 +75,491 @@ Eigen::ArrayXXd reverse_eval_with_mask(const std::pair<int, int>& deriv_shape,
       if (node == deriv_wrt_node) {
         derivative.col(param1) += reverse_eval[i];
       } else {
-        reverse_eval_function(node, i, param1, param2, forward_eval, reverse_eval);
+        reverse_eval_function(node, i, param1, param2, workspace.forward_eval,
+                              reverse_eval);
       }
     }
   }
-  return derivative;
 }
 
-std::vector<Eigen::ArrayXXd> forward_eval(
-    const Eigen::ArrayX3i& stack,
-    const Eigen::ArrayXXd& x,
-    const Eigen::VectorXd& constants) {
-  std::vector<Eigen::ArrayXXd> _forward_eval(stack.rows());
-
+void forward_eval_with_mask(const Eigen::ArrayX3i& stack,
+                            const XTile& x,
+                            const Eigen::VectorXd& constants,
+                            const std::vector<bool>& mask,
+                            EvaluationWorkspace& workspace) {
   for (int i = 0; i < stack.rows(); ++i) {
-    int node = stack(i, NODE_IDX);
-    int op1 = stack(i, OP_1);
-    int op2 = stack(i, OP_2);
-    _forward_eval[i] = forward_eval_function(
-      node, op1, op2, x, constants, _forward_eval);
+    if (mask[i]) {
+      int node = stack(i, NODE_IDX);
+      int op1 = stack(i, OP_1);
+      int op2 = stack(i, OP_2);
+      forward_eval_function(node, op1, op2, x, constants,
+                            workspace.forward_eval, i);
+    }
   }
-  return _forward_eval;
 }
 
-std::vector<Eigen::ArrayXXd> forward_eval_with_mask(
-    const Eigen::ArrayX3i& stack,
-    const Eigen::ArrayXXd& x,
-    const Eigen::VectorXd& constants,
-    const std::vector<bool>& mask) {
-  std::vector<Eigen::ArrayXXd> _forward_eval(stack.rows());
-
+void forward_eval_with_allocation(const Eigen::ArrayX3i& stack,
+                                  const XTile& x,
+                                  const Eigen::VectorXd& constants,
+                                  EvaluationWorkspace& workspace) {
+  const std::vector<int>& buffer = workspace.allocation.buffer_index;
   for (int i = 0; i < stack.rows(); ++i) {
-    if (mask[i]) {
+    if (buffer[i] >= 0) {
       int node = stack(i, NODE_IDX);
       int op1 = stack(i, OP_1);
       int op2 = stack(i, OP_2);
-      _forward_eval[i] = forward_eval_function(
-        node, op1, op2, x, constants, _forward_eval);
+      if (!AcyclicGraph::is_terminal(node)) {
+        op1 = buffer[op1];
+        op2 = AcyclicGraph::has_arity_two(node) ? buffer[op2] : op1;
+      }
+      forward_eval_function(node, op1, op2, x, constants,
+                            workspace.forward_eval, buffer[i]);
     }
   }
-  return _forward_eval;
 }
 
-std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd> _evaluate_with_derivative(
-    const Eigen::ArrayX3i& stack,
-    const Eigen::ArrayXXd& x,
-    const Eigen::VectorXd& constants,
-    const bool param_x_or_c) {
-  std::vector<Eigen::ArrayXXd> _forward_eval = forward_eval(
-      stack, x, constants);
+// Evaluates the commands in workspace.mask one tile of samples at a time.
+// The last tile is shifted back to overlap its neighbour so that every tile
+// has the same size and the buffers are never resized.
+void tiled_forward_eval_unfolded(const Eigen::ArrayX3i& stack,
+                        const XTile& x,
+                        const Eigen::VectorXd& constants,
+                        EvaluationWorkspace& workspace) {
+  BufferAllocation& allocation = workspace.allocation;
+  allocate_buffers(stack, workspace.mask, allocation);
+  int result_buffer = allocation.buffer_index[stack.rows() - 1];
+  int num_samples = x.rows();
+  int tile = tile_rows(workspace, num_samples, allocation.num_buffers);
 
-  std::pair<int, int> deriv_shape;
-  int deriv_wrt_node;
-  if (param_x_or_c) {  // true = x
-    deriv_shape = std::make_pair(x.rows(), x.cols());
-    deriv_wrt_node = 0;
-  } else {  // false = c
-    deriv_shape = std::make_pair(x.rows(), constants.size());
-    deriv_wrt_node = 1;
+  if (tile == num_samples) {
+    workspace.reserve(allocation.num_buffers);
+    forward_eval_with_allocation(stack, x, constants, workspace);
+    workspace.result_index = result_buffer;
+    return;
   }
 
-  Eigen::ArrayXXd derivative = reverse_eval(
-      deriv_shape, deriv_wrt_node, _forward_eval, stack);
-  return std::make_pair(_forward_eval.back(), derivative);
+  workspace.reserve(allocation.num_buffers + 1);
+  Eigen::ArrayXXd& result = workspace.forward_eval[allocation.num_buffers];
+  result.resize(num_samples, 1);
+  for (int start = 0; start < num_samples; start += tile) {
+    int tile_start = std::min(start, num_samples - tile);
+    forward_eval_with_allocation(stack, x.middleRows(tile_start, tile),
+                                 constants, workspace);
+    result.middleRows(tile_start, tile) = workspace.forward_eval[result_buffer];
+  }
+  workspace.result_index = allocation.num_buffers;
 }
 
-std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd> evaluate_with_derivative_and_mask(
-    const Eigen::ArrayX3i& stack,
-    const Eigen::ArrayXXd& x,
-    const Eigen::VectorXd& constants,
-    const std::vector<bool>& mask,
-    const bool param_x_or_c) {
-  std::vector<Eigen::ArrayXXd> forward_eval = forward_eval_with_mask(
-      stack, x, constants, mask);
+void tiled_program_eval(const Program& program,
+                        const XTile& x,
+                        const Eigen::VectorXd& constants,
+                        EvaluationWorkspace& workspace) {
+  int num_samples = x.rows();
+  int tile = tile_rows(workspace, num_samples, program.num_buffers);
+
+  if (tile == num_samples) {
+    workspace.reserve(program.num_buffers);
+    run_program(program, x, constants, workspace.forward_eval);
+    workspace.result_index = program.result;
+    return;
+  }
+
+  workspace.reserve(program.num_buffers + 1);
+  Eigen::ArrayXXd& result = workspace.forward_eval[program.num_buffers];
+  result.resize(num_samples, 1);
+  for (int start = 0; start < num_samples; start += tile) {
+    int tile_start = std::min(start, num_samples - tile);
+    run_program(program, x.middleRows(tile_start, tile), constants,
+                workspace.forward_eval);
+    result.middleRows(tile_start, tile) = workspace.forward_eval[program.result];
+  }
+  workspace.result_index = program.num_buffers;
+}
+
+void tiled_derivative_unfolded(const Eigen::ArrayX3i& stack,
+                               const XTile& x,
+                               const Eigen::VectorXd& constants,
+                               const bool param_x_or_c,
+                               EvaluationWorkspace& workspace) {
+  int stack_depth = stack.rows();
+  int num_samples = x.rows();
+  int deriv_wrt_node = param_x_or_c ? 0 : 1;
+  int num_params = param_x_or_c ? x.cols() : constants.size();
+  int tile = tile_rows(workspace, num_samples, 2 * stack_depth + num_params);
+
+  if (tile == num_samples) {
+    workspace.reserve(stack_depth);
+    workspace.derivative.setZero(num_samples, num_params);
+    forward_eval_with_mask(stack, x, constants, workspace.mask, workspace);
+    reverse_eval_with_mask(deriv_wrt_node, stack, workspace.mask, workspace,
+                           workspace.derivative);
+    workspace.result_index = stack_depth - 1;
+    return;
+  }
+
+  workspace.reserve(stack_depth + 1);
+  Eigen::ArrayXXd& result = workspace.forward_eval[stack_depth];
+  result.resize(num_samples, 1);
+  workspace.derivative.resize(num_samples, num_params);
+  for (int start = 0; start < num_samples; start += tile) {
+    int tile_start = std::min(start, num_samples - tile);
+    workspace.derivative_tile.setZero(tile, num_params);
+    forward_eval_with_mask(stack, x.middleRows(tile_start, tile), constants,
+                           workspace.mask, workspace);
+    reverse_eval_with_mask(deriv_wrt_node, stack, workspace.mask, workspace,
+                           workspace.derivative_tile);
+    result.middleRows(tile_start, tile) = workspace.forward_eval[stack_depth - 1];
+    workspace.derivative.middleRows(tile_start, tile) =
+      workspace.derivative_tile;
+  }
+  workspace.result_index = stack_depth;
+}
+
+// Evaluates the sample-invariant commands in mask once, on scalars, and
+// rewrites the stack into folding so that only sample-dependent commands are
+// left in its mask.  Returns false, leaving the stack to be evaluated as is,
+// when no operator is sample-invariant.
+bool fold_constant_commands(const Eigen::ArrayX3i& stack,
+                            const std::vector<bool>& mask,
+                            const Eigen::VectorXd& constants,
+                            bool with_jacobian,
+                            ConstantFolding& folding) {
+  int stack_depth = stack.rows();
+  std::vector<bool>& invariant = folding.invariant;
+  invariant.assign(stack_depth, false);
+  bool foldable = false;
+  for (int row = 0; row < stack_depth; ++row) {
+    int node = stack(row, NODE_IDX);
+    if (!mask[row]) {
+      continue;
+    } else if (AcyclicGraph::is_terminal(node)) {
+      invariant[row] = node == C_LOAD;
+    } else {
+      invariant[row] = invariant[stack(row, OP_1)] &&
+                       (!AcyclicGraph::has_arity_two(node) ||
+                        invariant[stack(row, OP_2)]);
+      foldable = foldable || invariant[row];
+    }
+  }
+  if (!foldable) {
+    return false;
+  }
+
+  std::vector<bool>& frontier = folding.frontier;
+  frontier.assign(stack_depth, false);
+  frontier[stack_depth - 1] = invariant[stack_depth - 1];
+  for (int row = 0; row < stack_depth; ++row) {
+    int node = stack(row, NODE_IDX);
+    if (mask[row] && !invariant[row] && !AcyclicGraph::is_terminal(node)) {
+      frontier[stack(row, OP_1)] = invariant[stack(row, OP_1)];
+      if (AcyclicGraph::has_arity_two(node)) {
+        frontier[stack(row, OP_2)] = invariant[stack(row, OP_2)];
+      }
+    }
+  }
+
+  // a single sample is enough: invariant commands never read x
+  Eigen::ArrayXXd no_x(1, 0);
+  int num_constants = constants.size();
+  folding.stack = stack;
+  folding.mask = mask;
+  folding.folded_rows.clear();
+  folding.scalar_eval.resize(std::max<std::size_t>(folding.scalar_eval.size(),
+                                                   stack_depth));
+  for (int row = 0; row < stack_depth; ++row) {
+    if (!invariant[row]) {
+      continue;
+    }
+    int node = stack(row, NODE_IDX);
+    forward_eval_function(node, stack(row, OP_1), stack(row, OP_2), no_x,
+                          constants, folding.scalar_eval, row);
+    if (!frontier[row]) {
+      folding.mask[row] = false;
+    } else if (node != C_LOAD) {
+      int index = num_constants + folding.folded_rows.size();
+      folding.stack.row(row) << C_LOAD, index, index;
+      folding.folded_rows.push_back(row);
+    }
+  }
+
+  int num_folded = folding.folded_rows.size();
+  folding.constants.resize(num_constants + num_folded);
+  folding.constants.head(num_constants) = constants;
+  for (int i = 0; i < num_folded; ++i) {
+    folding.constants[num_constants + i] =
+      folding.scalar_eval[folding.folded_rows[i]](0, 0);
+  }
+  if (!with_jacobian) {
+    return true;
+  }
 
-  std::pair<int, int> deriv_shape;
-  int deriv_wrt_node;
-  if (param_x_or_c) {  // true = x
-    deriv_shape = std::make_pair(x.rows(), x.cols());
-    deriv_wrt_node = 0;
-  } else {  // false = c
-    deriv_shape = std::make_pair(x.rows(), constants.size());
-    deriv_wrt_node = 1;
+  // one scalar reverse sweep per folded constant, restricted to the commands
+  // it was computed from so that unrelated infinities cannot leak in
+  std::vector<Eigen::ArrayXXd>& scalar_reverse = folding.scalar_reverse;
+  scalar_reverse.resize(std::max<std::size_t>(scalar_reverse.size(),
+                                              stack_depth));
+  folding.jacobian.setZero(num_folded, num_constants);
+  for (int i = 0; i < num_folded; ++i) {
+    int top = folding.folded_rows[i];
+    std::vector<bool>& reads = folding.subgraph;
+    reads.assign(top + 1, false);
+    reads[top] = true;
+    for (int row = top; row >= 0; --row) {
+      if (reads[row]) {
+        scalar_reverse[row].setZero(1, 1);
+        int node = stack(row, NODE_IDX);
+        if (!AcyclicGraph::is_terminal(node)) {
+          reads[stack(row, OP_1)] = true;
+          if (AcyclicGraph::has_arity_two(node)) {
+            reads[stack(row, OP_2)] = true;
+          }
+        }
+      }
+    }
+    scalar_reverse[top].setOnes();
+    for (int row = top; row >= 0; --row) {
+      if (!reads[row]) {
+        continue;
+      }
+      int node = stack(row, NODE_IDX);
+      if (node == C_LOAD) {
+        folding.jacobian(i, stack(row, OP_1)) += scalar_reverse[row](0, 0);
+      } else {
+        reverse_eval_function(node, row, stack(row, OP_1), stack(row, OP_2),
+                              folding.scalar_eval, scalar_reverse);
+      }
+    }
   }
+  return true;
+}
 
-  Eigen::ArrayXXd derivative = reverse_eval_with_mask(
-      deriv_shape, deriv_wrt_node, forward_eval, stack, mask);
-  return std::make_pair(forward_eval.back(), derivative);
+// Reduces a gradient wrt the original and folded constants onto the original
+// constants.
+void reduce_folded_derivative(const ConstantFolding& folding,
+                              const Eigen::ArrayXXd& folded_derivative,
+                              Eigen::Ref<Eigen::ArrayXXd> derivative) {
+  int num_constants = derivative.cols();
+  derivative = folded_derivative.leftCols(num_constants);
+  derivative.matrix().noalias() +=
+    folded_derivative.rightCols(folding.folded_rows.size()).matrix() *
+    folding.jacobian;
+}
+
+void tiled_forward_eval(const Eigen::ArrayX3i& stack,
+                        const XTile& x,
+                        const Eigen::VectorXd& constants,
+                        EvaluationWorkspace& workspace) {
+  ConstantFolding& folding = workspace.folding;
+  if (!fold_constant_commands(stack, workspace.mask, constants, false,
+                              folding)) {
+    tiled_forward_eval_unfolded(stack, x, constants, workspace);
+    return;
+  }
+  workspace.mask.swap(folding.mask);
+  tiled_forward_eval_unfolded(folding.stack, x, folding.constants, workspace);
+  workspace.mask.swap(folding.mask);
+}
+
+void tiled_evaluate_with_derivative(const Eigen::ArrayX3i& stack,
+                                    const XTile& x,
+                                    const Eigen::VectorXd& constants,
+                                    const bool param_x_or_c,
+                                    EvaluationWorkspace& workspace) {
+  ConstantFolding& folding = workspace.folding;
+  if (!fold_constant_commands(stack, workspace.mask, constants, !param_x_or_c,
+                              folding)) {
+    tiled_derivative_unfolded(stack, x, constants, param_x_or_c, workspace);
+    return;
+  }
+  workspace.mask.swap(folding.mask);
+  tiled_derivative_unfolded(folding.stack, x, folding.constants, param_x_or_c,
+                            workspace);
+  workspace.mask.swap(folding.mask);
+  if (!param_x_or_c) {
+    workspace.derivative.swap(folding.derivative);
+    workspace.derivative.resize(x.rows(), constants.size());
+    reduce_folded_derivative(folding, folding.derivative,
+                             workspace.derivative);
+  }
+}
+
+// Computes f(x) - y and its constant derivative one tile at a time, writing
+// both straight into the outputs.  Returns the sum of the absolute residuals.
+// Rows shared by the shifted last tile and its neighbour are recomputed but
+// counted once.
+double tiled_residual_with_derivative(const Eigen::ArrayX3i& stack,
+                                      const XTile& x,
+                                      const Eigen::VectorXd& constants,
+                                      const XTile& y,
+                                      EvaluationWorkspace& workspace,
+                                      Eigen::Ref<Eigen::ArrayXXd> residual,
+                                      Eigen::Ref<Eigen::ArrayXXd> derivative) {
+  ConstantFolding& folding = workspace.folding;
+  get_utilized_commands(stack, workspace.mask);
+  bool folded = fold_constant_commands(stack, workspace.mask, constants, true,
+                                       folding);
+  const Eigen::ArrayX3i& eval_stack = folded ? folding.stack : stack;
+  const Eigen::VectorXd& eval_constants =
+    folded ? folding.constants : constants;
+  const std::vector<bool>& mask = folded ? folding.mask : workspace.mask;
+
+  int stack_depth = stack.rows();
+  int num_samples = x.rows();
+  int tile = tile_rows(workspace, num_samples,
+                       2 * stack_depth + eval_constants.size());
+  workspace.reserve(stack_depth);
+  double abs_sum = 0.0;
+
+  for (int start = 0; start < num_samples; start += tile) {
+    int tile_start = std::min(start, num_samples - tile);
+    Eigen::Ref<Eigen::ArrayXXd> derivative_tile =
+      derivative.middleRows(tile_start, tile);
+    forward_eval_with_mask(eval_stack, x.middleRows(tile_start, tile),
+                           eval_constants, mask, workspace);
+    if (folded) {
+      workspace.derivative_tile.setZero(tile, eval_constants.size());
+      reverse_eval_with_mask(1, eval_stack, mask, workspace,
+                             workspace.derivative_tile);
+      reduce_folded_derivative(folding, workspace.derivative_tile,
+                               derivative_tile);
+    } else {
+      derivative_tile.setZero();
+      reverse_eval_with_mask(1, stack, mask, workspace, derivative_tile);
+    }
+    residual.middleRows(tile_start, tile) =
+      workspace.forward_eval[stack_depth - 1] - y.middleRows(tile_start, tile);
+    abs_sum += residual.middleRows(start, tile_start + tile - start)
+               .abs().sum();
+  }
+  return abs_sum;
+}
+
+// Splits num_samples rows into contiguous partitions, one per thread at most.
+int num_partitions(const ThreadPool& pool, int num_samples) {
+  return std::max(1, std::min(pool.num_threads(),
+                              num_samples / MIN_PARTITION_ROWS));
+}
+
+int partition_start(int partition, int num_partitions, int num_samples) {
+  return static_cast<long>(num_samples) * partition / num_partitions;
+}
+
+// Buffers used by the entry points which return their results by value.
+EvaluationWorkspace& thread_workspace() {
+  static thread_local EvaluationWorkspace workspace;
+  return workspace;
+}
+
+// Derivatives of a command with respect to x and the constants, carried
+// forward through the stack.  dxc holds one block of dx.cols() columns per
+// constant.
+struct MixedJet {
+  Eigen::ArrayXXd dx;
+  Eigen::ArrayXXd dc;
+  Eigen::ArrayXXd dxc;
+};
+
+// First and second partial derivatives of a command with respect to its
+// operands a and b.
+struct Partials {
+  Eigen::ArrayXd a, b, aa, ab, bb;
+};
+
+void operand_partials(int node, const Eigen::ArrayXd& a,
+                      const Eigen::ArrayXd& b, const Eigen::ArrayXd& h,
+                      Partials& p) {
+  Eigen::ArrayXd zero = Eigen::ArrayXd::Zero(h.size());
+  p.a = zero;
+  p.b = zero;
+  p.aa = zero;
+  p.ab = zero;
+  p.bb = zero;
+
+  switch (node) {
+    case ADDITION:
+      p.a.setOnes();
+      p.b.setOnes();
+      break;
+    case SUBTRACTION:
+      p.a.setOnes();
+      p.b.setConstant(-1.0);
+      break;
+    case MULTIPLICATION:
+      p.a = b;
+      p.b = a;
+      p.ab.setOnes();
+      break;
+    case DIVISION:
+      p.a = 1.0 / b;
+      p.b = -h / b;
+      p.ab = -1.0 / b.square();
+      p.bb = 2.0 * h / b.square();
+      break;
+    case SIN:
+      p.a = a.cos();
+      p.aa = -h;
+      break;
+    case COS:
+      p.a = -a.sin();
+      p.aa = -h;
+      break;
+    case EXP:
+      p.a = h;
+      p.aa = h;
+      break;
+    case LOG:
+      p.a = 1.0 / a;
+      p.aa = -1.0 / a.square();
+      break;
+    case POWER:
+      p.a = h * b / a;
+      p.b = h * a.abs().log();
+      p.aa = b * (b - 1.0) * h / a.square();
+      p.ab = h / a * (1.0 + b * a.abs().log());
+      p.bb = p.b * a.abs().log();
+      break;
+    case ABSOLUTE:
+      p.a = a.sign();
+      break;
+    case SQRT:
+      p.a = 0.5 / h * a.sign();
+      p.aa = -0.25 / h.cube();
+      break;
+  }
+}
+
+// Chain rule for the first and mixed second derivatives of h(a, b).
+void chain_mixed_jet(const MixedJet& a, const MixedJet& b, const Partials& p,
+                     bool binary, MixedJet& h) {
+  int x_dim = a.dx.cols();
+  h.dx = a.dx.colwise() * p.a;
+  h.dc = a.dc.colwise() * p.a;
+  h.dxc = a.dxc.colwise() * p.a;
+  if (binary) {
+    h.dx += b.dx.colwise() * p.b;
+    h.dc += b.dc.colwise() * p.b;
+    h.dxc += b.dxc.colwise() * p.b;
+  }
+
+  for (int k = 0; k < a.dc.cols(); ++k) {
+    h.dxc.middleCols(k * x_dim, x_dim) +=
+        a.dx.colwise() * (p.aa * a.dc.col(k));
+    if (binary) {
+      h.dxc.middleCols(k * x_dim, x_dim) +=
+          a.dx.colwise() * (p.ab * b.dc.col(k)) +
+          b.dx.colwise() * (p.ab * a.dc.col(k) + p.bb * b.dc.col(k));
+    }
+  }
 }
 } // namespace
 
+void EvaluationWorkspace::reserve(int stack_depth) {
+  if (static_cast<int>(forward_eval.size()) < stack_depth) {
+    forward_eval.resize(stack_depth);
+    reverse_eval.resize(stack_depth);
+  }
+}
+
 bool is_cpp() {
     return true;
 }
@@ -165,9 +567,9 @@ bool is_cpp() {
 Eigen::ArrayXXd evaluate(const Eigen::ArrayX3i& stack,
                          const Eigen::ArrayXXd& x,
                          const Eigen::VectorXd& constants) {
-  std::vector<Eigen::ArrayXXd> _forward_eval = forward_eval(
-      stack, x, constants);
-  return _forward_eval.back();  
+  EvaluationWorkspace& workspace = thread_workspace();
+  evaluate(stack, x, constants, workspace);
+  return workspace.result();
 }
 
 std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd> evaluate_with_derivative(
@@ -175,16 +577,227 @@ std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd> evaluate_with_derivative(
     const Eigen::ArrayXXd& x,
     const Eigen::VectorXd& constants,
     const bool param_x_or_c) {
-  return _evaluate_with_derivative(stack, x, constants, param_x_or_c);
+  EvaluationWorkspace& workspace = thread_workspace();
+  evaluate_with_derivative(stack, x, constants, workspace, param_x_or_c);
+  return std::make_pair(workspace.result(), workspace.derivative);
+}
+
+void evaluate(const Eigen::ArrayX3i& stack,
+              const Eigen::ArrayXXd& x,
+              const Eigen::VectorXd& constants,
+              EvaluationWorkspace& workspace) {
+  workspace.mask.assign(stack.rows(), true);
+  tiled_forward_eval(stack, x, constants, workspace);
+}
+
+void evaluate_with_derivative(const Eigen::ArrayX3i& stack,
+                              const Eigen::ArrayXXd& x,
+                              const Eigen::VectorXd& constants,
+                              EvaluationWorkspace& workspace,
+                              const bool param_x_or_c) {
+  workspace.mask.assign(stack.rows(), true);
+  tiled_evaluate_with_derivative(stack, x, constants, param_x_or_c, workspace);
+}
+
+Eigen::ArrayXXd evaluate(const Eigen::ArrayX3i& stack,
+                         const Eigen::ArrayXXd& x,
+                         const Eigen::VectorXd& constants,
+                         ThreadPool& pool) {
+  int num_samples = x.rows();
+  int partitions = num_partitions(pool, num_samples);
+  Eigen::ArrayXXd values(num_samples, 1);
+  pool.parallel_for(partitions, [&](int p) {
+    int start = partition_start(p, partitions, num_samples);
+    int rows = partition_start(p + 1, partitions, num_samples) - start;
+    EvaluationWorkspace& workspace = thread_workspace();
+    workspace.mask.assign(stack.rows(), true);
+    tiled_forward_eval(stack, x.middleRows(start, rows), constants, workspace);
+    values.middleRows(start, rows) = workspace.result();
+  });
+  return values;
+}
+
+std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd> evaluate_with_derivative(
+    const Eigen::ArrayX3i& stack,
+    const Eigen::ArrayXXd& x,
+    const Eigen::VectorXd& constants,
+    ThreadPool& pool,
+    const bool param_x_or_c) {
+  int num_samples = x.rows();
+  int partitions = num_partitions(pool, num_samples);
+  Eigen::ArrayXXd values(num_samples, 1);
+  Eigen::ArrayXXd derivative(num_samples,
+                             param_x_or_c ? x.cols() : constants.size());
+  pool.parallel_for(partitions, [&](int p) {
+    int start = partition_start(p, partitions, num_samples);
+    int rows = partition_start(p + 1, partitions, num_samples) - start;
+    EvaluationWorkspace& workspace = thread_workspace();
+    workspace.mask.assign(stack.rows(), true);
+    tiled_evaluate_with_derivative(stack, x.middleRows(start, rows), constants,
+                                   param_x_or_c, workspace);
+    values.middleRows(start, rows) = workspace.result();
+    derivative.middleRows(start, rows) = workspace.derivative;
+  });
+  return std::make_pair(values, derivative);
+}
+
+std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd> evaluate_mixed_derivative(
+    const Eigen::ArrayX3i& stack,
+    const Eigen::ArrayXXd& x,
+    const Eigen::VectorXd& constants) {
+  int num_samples = x.rows();
+  int x_dim = x.cols();
+  int c_dim = constants.size();
+  std::vector<bool> used;
+  get_utilized_commands(stack, used);
+  std::vector<Eigen::ArrayXXd> values(stack.rows());
+  std::vector<MixedJet> jets(stack.rows());
+  Partials partials;
+
+  for (int row = 0; row < stack.rows(); ++row) {
+    if (!used[row]) {
+      continue;
+    }
+
+    int node = stack(row, NODE_IDX);
+    int param1 = stack(row, OP_1);
+    int param2 = stack(row, OP_2);
+    forward_eval_function(node, param1, param2, x, constants, values, row);
+    MixedJet& jet = jets[row];
+
+    if (node == X_LOAD || node == C_LOAD) {
+      jet.dx.setZero(num_samples, x_dim);
+      jet.dc.setZero(num_samples, c_dim);
+      jet.dxc.setZero(num_samples, x_dim * c_dim);
+      if (node == X_LOAD) {
+        jet.dx.col(param1).setOnes();
+      } else {
+        jet.dc.col(param1).setOnes();
+      }
+      continue;
+    }
+
+    bool binary = AcyclicGraph::has_arity_two(node);
+    const Eigen::ArrayXXd& b = values[binary ? param2 : param1];
+    operand_partials(node, values[param1].col(0), b.col(0),
+                     values[row].col(0), partials);
+    chain_mixed_jet(jets[param1], jets[binary ? param2 : param1], partials,
+                    binary, jet);
+  }
+
+  MixedJet& result = jets[stack.rows() - 1];
+  return std::make_pair(result.dx, result.dxc);
+}
+
+Eigen::ArrayXXd evaluate(const Program& program,
+                         const Eigen::ArrayXXd& x,
+                         const Eigen::VectorXd& constants) {
+  EvaluationWorkspace& workspace = thread_workspace();
+  evaluate(program, x, constants, workspace);
+  return workspace.result();
+}
+
+void evaluate(const Program& program,
+              const Eigen::ArrayXXd& x,
+              const Eigen::VectorXd& constants,
+              EvaluationWorkspace& workspace) {
+  tiled_program_eval(program, x, constants, workspace);
+}
+
+Eigen::ArrayXXd evaluate(const Program& program,
+                         const Eigen::ArrayXXd& x,
+                         const Eigen::VectorXd& constants,
+                         ThreadPool& pool) {
+  int num_samples = x.rows();
+  int partitions = num_partitions(pool, num_samples);
+  Eigen::ArrayXXd values(num_samples, 1);
+  pool.parallel_for(partitions, [&](int p) {
+    int start = partition_start(p, partitions, num_samples);
+    int rows = partition_start(p + 1, partitions, num_samples) - start;
+    EvaluationWorkspace& workspace = thread_workspace();
+    tiled_program_eval(program, x.middleRows(start, rows), constants,
+                       workspace);
+    values.middleRows(start, rows) = workspace.result();
+  });
+  return values;
+}
+
+double evaluate_residual(const Program& program,
+                         const Eigen::ArrayXXd& x,
+                         const Eigen::VectorXd& constants,
+                         const Eigen::ArrayXXd& y,
+                         Eigen::ArrayXXd& residual) {
+  EvaluationWorkspace& workspace = thread_workspace();
+  tiled_program_eval(program, x, constants, workspace);
+  residual = workspace.result() - y;
+  return residual.abs().mean();
+}
+
+double evaluate_residual(const Program& program,
+                         const Eigen::ArrayXXd& x,
+                         const Eigen::VectorXd& constants,
+                         const Eigen::ArrayXXd& y,
+                         ThreadPool& pool,
+                         Eigen::ArrayXXd& residual) {
+  int num_samples = x.rows();
+  int partitions = num_partitions(pool, num_samples);
+  residual.resize(num_samples, 1);
+  pool.parallel_for(partitions, [&](int p) {
+    int start = partition_start(p, partitions, num_samples);
+    int rows = partition_start(p + 1, partitions, num_samples) - start;
+    EvaluationWorkspace& workspace = thread_workspace();
+    tiled_program_eval(program, x.middleRows(start, rows), constants,
+                       workspace);
+    residual.middleRows(start, rows) = workspace.result() -
+                                       y.middleRows(start, rows);
+  });
+  return residual.abs().mean();
+}
+
+double evaluate_residual_with_derivative(const Eigen::ArrayX3i& stack,
+                                         const Eigen::ArrayXXd& x,
+                                         const Eigen::VectorXd& constants,
+                                         const Eigen::ArrayXXd& y,
+                                         Eigen::ArrayXXd& residual,
+                                         Eigen::ArrayXXd& derivative) {
+  residual.resize(x.rows(), 1);
+  derivative.resize(x.rows(), constants.size());
+  double abs_sum = tiled_residual_with_derivative(stack, x, constants, y,
+                                                  thread_workspace(),
+                                                  residual, derivative);
+  return abs_sum / x.rows();
+}
+
+double evaluate_residual_with_derivative(const Eigen::ArrayX3i& stack,
+                                         const Eigen::ArrayXXd& x,
+                                         const Eigen::VectorXd& constants,
+                                         const Eigen::ArrayXXd& y,
+                                         ThreadPool& pool,
+                                         Eigen::ArrayXXd& residual,
+                                         Eigen::ArrayXXd& derivative) {
+  int num_samples = x.rows();
+  int partitions = num_partitions(pool, num_samples);
+  residual.resize(num_samples, 1);
+  derivative.resize(num_samples, constants.size());
+  std::vector<double> abs_sums(partitions);
+  pool.parallel_for(partitions, [&](int p) {
+    int start = partition_start(p, partitions, num_samples);
+    int rows = partition_start(p + 1, partitions, num_samples) - start;
+    abs_sums[p] = tiled_residual_with_derivative(
+                    stack, x.middleRows(start, rows), constants,
+                    y.middleRows(start, rows), thread_workspace(),
+                    residual.middleRows(start, rows),
+                    derivative.middleRows(start, rows));
+  });
+  return std::accumulate(abs_sums.begin(), abs_sums.end(), 0.0) / num_samples;
 }
 
 Eigen::ArrayXXd simplify_and_evaluate(const Eigen::ArrayX3i& stack,
                                     const Eigen::ArrayXXd& x,
                                     const Eigen::VectorXd& constants) {
-  std::vector<bool> mask = get_utilized_commands(stack);
-  std::vector<Eigen::ArrayXXd> forward_eval = forward_eval_with_mask(
-      stack, x, constants, mask);
-  return forward_eval.back();
+  EvaluationWorkspace& workspace = thread_workspace();
+  simplify_and_evaluate(stack, x, constants, workspace);
+  return workspace.result();
 }
 
 std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd> simplify_and_evaluate_with_derivative(
@@ -192,12 +805,169 @@ std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd> simplify_and_evaluate_with_derivativ
     const Eigen::ArrayXXd& x,
     const Eigen::VectorXd& constants,
     const bool param_x_or_c) {
-  std::vector<bool> mask = get_utilized_commands(stack);
-  return evaluate_with_derivative_and_mask(stack, x, constants, mask, param_x_or_c);
+  EvaluationWorkspace& workspace = thread_workspace();
+  simplify_and_evaluate_with_derivative(stack, x, constants, workspace,
+                                        param_x_or_c);
+  return std::make_pair(workspace.result(), workspace.derivative);
+}
+
+void simplify_and_evaluate(const Eigen::ArrayX3i& stack,
+                           const Eigen::ArrayXXd& x,
+                           const Eigen::VectorXd& constants,
+                           EvaluationWorkspace& workspace) {
+  get_utilized_commands(stack, workspace.mask);
+  tiled_forward_eval(stack, x, constants, workspace);
+}
+
+void simplify_and_evaluate_with_derivative(const Eigen::ArrayX3i& stack,
+                                           const Eigen::ArrayXXd& x,
+                                           const Eigen::VectorXd& constants,
+                                           EvaluationWorkspace& workspace,
+                                           const bool param_x_or_c) {
+  get_utilized_commands(stack, workspace.mask);
+  tiled_evaluate_with_derivative(stack, x, constants, param_x_or_c, workspace);
+}
+
+void evaluate_incremental(const Eigen::ArrayX3i& stack,
+                          const Eigen::ArrayXXd& x,
+                          const Eigen::VectorXd& constants,
+                          EvaluationCache& cache) {
+  int stack_depth = stack.rows();
+  std::vector<bool>& valid = cache.valid;
+  if (cache.x.rows() != x.rows() || cache.x.cols() != x.cols() ||
+      !(cache.x == x).all()) {
+    cache.x = x;
+    valid.assign(stack_depth, false);
+  }
+  valid.resize(stack_depth, false);
+  if (static_cast<int>(cache.forward_eval.size()) < stack_depth) {
+    cache.forward_eval.resize(stack_depth);
+  }
+
+  get_utilized_commands(stack, cache.mask);
+  std::vector<bool>& changed = cache.changed;
+  changed.assign(stack_depth, false);
+  int cached_depth = cache.stack.rows();
+  cache.num_recomputed = 0;
+  for (int row = 0; row < stack_depth; ++row) {
+    int node = stack(row, NODE_IDX);
+    int param1 = stack(row, OP_1);
+    int param2 = stack(row, OP_2);
+    bool arity_two = AcyclicGraph::has_arity_two(node);
+    bool changed_row = !valid[row] || row >= cached_depth ||
+                       cache.stack(row, NODE_IDX) != node ||
+                       cache.stack(row, OP_1) != param1 ||
+                       (arity_two && cache.stack(row, OP_2) != param2);
+    if (!changed_row && node == C_LOAD) {
+      changed_row = param1 >= cache.constants.size() ||
+                    cache.constants[param1] != constants[param1];
+    } else if (!changed_row && !AcyclicGraph::is_terminal(node)) {
+      changed_row = changed[param1] || (arity_two && changed[param2]);
+    }
+    changed[row] = changed_row;
+
+    if (!changed_row) {
+      continue;
+    } else if (!cache.mask[row]) {
+      valid[row] = false;
+      continue;
+    }
+    forward_eval_function(node, param1, param2, x, constants,
+                          cache.forward_eval, row);
+    valid[row] = true;
+    ++cache.num_recomputed;
+  }
+  cache.stack = stack;
+  cache.constants = constants;
+}
+
+Eigen::ArrayXXd evaluate_population(
+    const std::vector<Eigen::ArrayX3i>& stacks,
+    const Eigen::ArrayXXd& x,
+    const std::vector<Eigen::VectorXd>& constants) {
+  EvaluationWorkspace& workspace = thread_workspace();
+  Eigen::ArrayXXd values(x.rows(), stacks.size());
+  for (std::size_t i = 0; i < stacks.size(); ++i) {
+    simplify_and_evaluate(stacks[i], x, constants[i], workspace);
+    values.col(i) = workspace.result();
+  }
+  return values;
+}
+
+std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd>
+evaluate_population_with_derivative(
+    const std::vector<Eigen::ArrayX3i>& stacks,
+    const Eigen::ArrayXXd& x,
+    const std::vector<Eigen::VectorXd>& constants,
+    const bool param_x_or_c) {
+  int num_columns = 0;
+  for (std::size_t i = 0; i < stacks.size(); ++i) {
+    num_columns += param_x_or_c ? x.cols() : constants[i].size();
+  }
+
+  EvaluationWorkspace& workspace = thread_workspace();
+  Eigen::ArrayXXd values(x.rows(), stacks.size());
+  Eigen::ArrayXXd derivatives(x.rows(), num_columns);
+  for (std::size_t i = 0, column = 0; i < stacks.size(); ++i) {
+    simplify_and_evaluate_with_derivative(stacks[i], x, constants[i],
+                                          workspace, param_x_or_c);
+    values.col(i) = workspace.result();
+    derivatives.middleCols(column, workspace.derivative.cols()) =
+      workspace.derivative;
+    column += workspace.derivative.cols();
+  }
+  return std::make_pair(values, derivatives);
+}
+
+Eigen::ArrayXXd evaluate_population(
+    const std::vector<Eigen::ArrayX3i>& stacks,
+    const Eigen::ArrayXXd& x,
+    const std::vector<Eigen::VectorXd>& constants,
+    ThreadPool& pool) {
+  Eigen::ArrayXXd values(x.rows(), stacks.size());
+  pool.parallel_for(stacks.size(), [&](int i) {
+    EvaluationWorkspace& workspace = thread_workspace();
+    simplify_and_evaluate(stacks[i], x, constants[i], workspace);
+    values.col(i) = workspace.result();
+  });
+  return values;
+}
+
+std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd>
+evaluate_population_with_derivative(
+    const std::vector<Eigen::ArrayX3i>& stacks,
+    const Eigen::ArrayXXd& x,
+    const std::vector<Eigen::VectorXd>& constants,
+    ThreadPool& pool,
+    const bool param_x_or_c) {
+  std::vector<int> first_column(stacks.size() + 1, 0);
+  for (std::size_t i = 0; i < stacks.size(); ++i) {
+    first_column[i + 1] = first_column[i] +
+                          (param_x_or_c ? x.cols() : constants[i].size());
+  }
+
+  Eigen::ArrayXXd values(x.rows(), stacks.size());
+  Eigen::ArrayXXd derivatives(x.rows(), first_column.back());
+  pool.parallel_for(stacks.size(), [&](int i) {
+    EvaluationWorkspace& workspace = thread_workspace();
+    simplify_and_evaluate_with_derivative(stacks[i], x, constants[i],
+                                          workspace, param_x_or_c);
+    values.col(i) = workspace.result();
+    derivatives.middleCols(first_column[i], workspace.derivative.cols()) =
+      workspace.derivative;
+  });
+  return std::make_pair(values, derivatives);
 }
 
 std::vector<bool> get_utilized_commands(const Eigen::ArrayX3i& stack) {
-  std::vector<bool> used_commands(stack.rows());
+  std::vector<bool> used_commands;
+  get_utilized_commands(stack, used_commands);
+  return used_commands;
+}
+
+void get_utilized_commands(const Eigen::ArrayX3i& stack,
+                           std::vector<bool>& used_commands) {
+  used_commands.assign(stack.rows(), false);
   used_commands.back() = true;
   int stack_size = stack.rows();
   for (int i = 1; i < stack_size; i++) {
@@ -212,35 +982,113 @@ std::vector<bool> get_utilized_commands(const Eigen::ArrayX3i& stack) {
       }
     }
   }
-  return used_commands;
+}
+
+void allocate_buffers(const Eigen::ArrayX3i& stack,
+                      const std::vector<bool>& mask,
+                      BufferAllocation& allocation) {
+  int stack_size = stack.rows();
+  std::vector<int>& last_use = allocation.last_use;
+  std::vector<int>& buffer = allocation.buffer_index;
+  std::vector<int>& free_buffers = allocation.free_buffers;
+  last_use.assign(stack_size, -1);
+  buffer.assign(stack_size, -1);
+  free_buffers.clear();
+
+  for (int i = 0; i < stack_size; ++i) {
+    if (mask[i]) {
+      last_use[i] = i;
+      int node = stack(i, NODE_IDX);
+      if (!AcyclicGraph::is_terminal(node)) {
+        last_use[stack(i, OP_1)] = i;
+        if (AcyclicGraph::has_arity_two(node)) {
+          last_use[stack(i, OP_2)] = i;
+        }
+      }
+    }
+  }
+  last_use[stack_size - 1] = stack_size;
+
+  int num_buffers = 0;
+  for (int i = 0; i < stack_size; ++i) {
+    if (!mask[i]) {
+      continue;
+    }
+    int node = stack(i, NODE_IDX);
+    if (!AcyclicGraph::is_terminal(node)) {
+      int param1 = stack(i, OP_1);
+      if (last_use[param1] == i) {
+        free_buffers.push_back(buffer[param1]);
+      }
+      int param2 = stack(i, OP_2);
+      if (AcyclicGraph::has_arity_two(node) && param2 != param1 &&
+          last_use[param2] == i) {
+        free_buffers.push_back(buffer[param2]);
+      }
+    }
+    if (free_buffers.empty()) {
+      buffer[i] = num_buffers++;
+    } else {
+      buffer[i] = free_buffers.back();
+      free_buffers.pop_back();
+    }
+    if (last_use[i] == i) {
+      free_buffers.push_back(buffer[i]);
+    }
+  }
+  allocation.num_buffers = num_buffers;
 }
 
 Eigen::ArrayX3i simplify_stack(const Eigen::ArrayX3i& stack) {
+  StackAnalysis& analysis = thread_stack_analysis();
+  analyze_stack(stack, analysis);
+  Eigen::ArrayX3i new_stack;
+  simplify_stack(stack, analysis, new_stack);
+  return merge_common_subexpressions(new_stack);
+}
+
+Eigen::ArrayX3i merge_common_subexpressions(const Eigen::ArrayX3i& stack) {
   std::vector<bool> used_command = get_utilized_commands(stack);
-  std::map<int, int> reduced_param_map;
+  std::vector<int> merged_row(stack.rows(), -1);
+  std::map<std::tuple<int, int, int>, int> commands;
+  Eigen::ArrayX3i new_stack(stack.rows(), 3);
   int num_commands = 0;
-  num_commands = std::accumulate(used_command.begin(), used_command.end(), 0);
-  Eigen::ArrayX3i new_stack(num_commands, 3);
-
-  for (int i = 0, j = 0; i < stack.rows(); ++i) {
-    if (used_command[i]) {
-      new_stack(j, 0) = stack(i, 0);
-      if (AcyclicGraph::is_terminal(new_stack(j, 0))) {
-        new_stack(j, 1) = stack(i, 1);
-        new_stack(j, 2) = stack(i, 2);
-      } else {
-        new_stack(j, 1) = reduced_param_map[stack(i, 1)];
-        if (AcyclicGraph::has_arity_two(new_stack(j, 0))) {
-          new_stack(j, 2) = reduced_param_map[stack(i, 2)];
-        } else {
-          new_stack(j, 2) = new_stack(j, 1);
-        }
+
+  for (int i = 0; i < stack.rows(); ++i) {
+    if (!used_command[i]) {
+      continue;
+    }
+    int node = stack(i, NODE_IDX);
+    int param1 = stack(i, OP_1);
+    int param2 = stack(i, OP_2);
+    if (AcyclicGraph::is_terminal(node)) {
+      // constants which are not numbered yet are distinct commands
+      if (node == C_LOAD && param1 < 0) {
+        new_stack.row(num_commands) << node, param1, param2;
+        merged_row[i] = num_commands++;
+        continue;
+      }
+      param2 = param1;
+    } else {
+      param1 = merged_row[param1];
+      param2 = AcyclicGraph::has_arity_two(node) ? merged_row[param2] : param1;
+      if ((node == ADDITION || node == MULTIPLICATION) && param2 < param1) {
+        std::swap(param1, param2);
       }
-      reduced_param_map[i] = j;
-      ++j;
+    }
+
+    std::tuple<int, int, int> command(node, param1, param2);
+    std::map<std::tuple<int, int, int>, int>::iterator found =
+      commands.find(command);
+    if (found != commands.end()) {
+      merged_row[i] = found->second;
+    } else {
+      new_stack.row(num_commands) << node, param1, param2;
+      commands[command] = num_commands;
+      merged_row[i] = num_commands++;
     }
   }
-  return new_stack;
+  return new_stack.topRows(num_commands);
 }
 
 int get_arity(int node) {
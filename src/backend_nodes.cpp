@@ -5,11 +5,12 @@ namespace bingo {
 namespace { 
 
 // Load x
-Eigen::ArrayXXd loadx_forward_eval(int param1, int param2, 
-                                    const Eigen::ArrayXXd& x, 
-                                    const Eigen::VectorXd& constants, 
-                                    std::vector<Eigen::ArrayXXd>& forward_eval) {
-  return x.col(param1);
+void loadx_forward_eval(int param1, int param2,
+                        const Eigen::Ref<const Eigen::ArrayXXd>& x,
+                        const Eigen::VectorXd& constants,
+                        std::vector<Eigen::ArrayXXd>& forward_eval,
+                        int result_index) {
+  forward_eval[result_index] = x.col(param1);
 }
 void loadx_reverse_eval(int reverse_index, int param1, int param2,
                         const std::vector<Eigen::ArrayXXd>& forward_eval,
@@ -18,11 +19,13 @@ void loadx_reverse_eval(int reverse_index, int param1, int param2,
 }
 
 // Load c
-Eigen::ArrayXXd loadc_forward_eval(int param1, int param2, 
-                                   const Eigen::ArrayXXd& x, 
-                                   const Eigen::VectorXd& constants, 
-                                   std::vector<Eigen::ArrayXXd>& forward_eval) {
-  return Eigen::ArrayXd::Constant(x.rows(), constants[param1]);
+void loadc_forward_eval(int param1, int param2,
+                        const Eigen::Ref<const Eigen::ArrayXXd>& x,
+                        const Eigen::VectorXd& constants,
+                        std::vector<Eigen::ArrayXXd>& forward_eval,
+                        int result_index) {
+  forward_eval[result_index] = Eigen::ArrayXd::Constant(x.rows(),
+                                                       constants[param1]);
 }
 void loadc_reverse_eval(int reverse_index, int param1, int param2,
                         const std::vector<Eigen::ArrayXXd>& forward_eval,
@@ -31,11 +34,12 @@ void loadc_reverse_eval(int reverse_index, int param1, int param2,
 }
 
 // Addition
-Eigen::ArrayXXd add_forward_eval(int param1, int param2, 
-                                 const Eigen::ArrayXXd& x, 
-                                 const Eigen::VectorXd& constants, 
-                                 std::vector<Eigen::ArrayXXd>& forward_eval) {
-  return forward_eval[param1] + forward_eval[param2]; 
+void add_forward_eval(int param1, int param2,
+                      const Eigen::Ref<const Eigen::ArrayXXd>& x,
+                      const Eigen::VectorXd& constants,
+                      std::vector<Eigen::ArrayXXd>& forward_eval,
+                      int result_index) {
+  forward_eval[result_index] = forward_eval[param1] + forward_eval[param2];
 } 
 void add_reverse_eval(int reverse_index, int param1, int param2, 
                       const std::vector<Eigen::ArrayXXd>& forward_eval, 
@@ -45,11 +49,12 @@ void add_reverse_eval(int reverse_index, int param1, int param2,
 } 
 
 // Subtraction
-Eigen::ArrayXXd subtract_forward_eval(int param1, int param2, 
-                                      const Eigen::ArrayXXd& x,
-                                      const Eigen::VectorXd& constants, 
-                                      std::vector<Eigen::ArrayXXd>& forward_eval) {
-  return forward_eval[param1] - forward_eval[param2]; 
+void subtract_forward_eval(int param1, int param2,
+                           const Eigen::Ref<const Eigen::ArrayXXd>& x,
+                           const Eigen::VectorXd& constants,
+                           std::vector<Eigen::ArrayXXd>& forward_eval,
+                           int result_index) {
+  forward_eval[result_index] = forward_eval[param1] - forward_eval[param2];
 } 
 void subtract_reverse_eval(int reverse_index, int param1, int param2, 
                            const std::vector<Eigen::ArrayXXd>& forward_eval, 
@@ -59,11 +64,12 @@ void subtract_reverse_eval(int reverse_index, int param1, int param2,
 }
 
 // Multiplication
-Eigen::ArrayXXd multiply_forward_eval(int param1, int param2, 
-                                      const Eigen::ArrayXXd& x, 
-                                      const Eigen::VectorXd& constants, 
-                                      std::vector<Eigen::ArrayXXd>& forward_eval) {
-  return forward_eval[param1] * forward_eval[param2]; 
+void multiply_forward_eval(int param1, int param2,
+                           const Eigen::Ref<const Eigen::ArrayXXd>& x,
+                           const Eigen::VectorXd& constants,
+                           std::vector<Eigen::ArrayXXd>& forward_eval,
+                           int result_index) {
+  forward_eval[result_index] = forward_eval[param1] * forward_eval[param2];
 } 
 void multiply_reverse_eval(int reverse_index, int param1, int param2, 
                            const std::vector<Eigen::ArrayXXd>& forward_eval, 
@@ -75,11 +81,12 @@ void multiply_reverse_eval(int reverse_index, int param1, int param2,
 } 
 
 // Division
-Eigen::ArrayXXd divide_forward_eval(int param1, int param2, 
-                                    const Eigen::ArrayXXd& x, 
-                                    const Eigen::VectorXd& constants, 
-                                    std::vector<Eigen::ArrayXXd>& forward_eval) {
-  return forward_eval[param1] / forward_eval[param2]; 
+void divide_forward_eval(int param1, int param2,
+                         const Eigen::Ref<const Eigen::ArrayXXd>& x,
+                         const Eigen::VectorXd& constants,
+                         std::vector<Eigen::ArrayXXd>& forward_eval,
+                         int result_index) {
+  forward_eval[result_index] = forward_eval[param1] / forward_eval[param2];
 } 
 void divide_reverse_eval(int reverse_index, int param1, int param2, 
                          const std::vector<Eigen::ArrayXXd>& forward_eval, 
@@ -92,11 +99,12 @@ void divide_reverse_eval(int reverse_index, int param1, int param2,
 }
 
 // Sine
-Eigen::ArrayXXd sin_forward_eval(int param1, int param2, 
-                                 const Eigen::ArrayXXd& x, 
-                                 const Eigen::VectorXd& constants, 
-                                 std::vector<Eigen::ArrayXXd>& forward_eval) {
-  return forward_eval.at(param1).sin(); 
+void sin_forward_eval(int param1, int param2,
+                      const Eigen::Ref<const Eigen::ArrayXXd>& x,
+                      const Eigen::VectorXd& constants,
+                      std::vector<Eigen::ArrayXXd>& forward_eval,
+                      int result_index) {
+  forward_eval[result_index] = forward_eval[param1].sin();
 } 
 void sin_reverse_eval(int reverse_index, int param1, int param2, 
                       const std::vector<Eigen::ArrayXXd>& forward_eval, 
@@ -106,11 +114,12 @@ void sin_reverse_eval(int reverse_index, int param1, int param2,
 }
 
 // Cosine
-Eigen::ArrayXXd cos_forward_eval(int param1, int param2, 
-                                 const Eigen::ArrayXXd& x, 
-                                 const Eigen::VectorXd& constants, 
-                                 std::vector<Eigen::ArrayXXd>& forward_eval) {
-  return forward_eval[param1].cos(); 
+void cos_forward_eval(int param1, int param2,
+                      const Eigen::Ref<const Eigen::ArrayXXd>& x,
+                      const Eigen::VectorXd& constants,
+                      std::vector<Eigen::ArrayXXd>& forward_eval,
+                      int result_index) {
+  forward_eval[result_index] = forward_eval[param1].cos();
 } 
 void cos_reverse_eval(int reverse_index, int param1, int param2, 
                       const std::vector<Eigen::ArrayXXd>& forward_eval, 
@@ -120,11 +129,12 @@ void cos_reverse_eval(int reverse_index, int param1, int param2,
 }
 
 // Exponential 
-Eigen::ArrayXXd exp_forward_eval(int param1, int param2,
-                                 const Eigen::ArrayXXd& x,
-                                 const Eigen::VectorXd& constants,
-                                 std::vector<Eigen::ArrayXXd>& forward_eval) {
-  return forward_eval[param1].exp();
+void exp_forward_eval(int param1, int param2,
+                      const Eigen::Ref<const Eigen::ArrayXXd>& x,
+                      const Eigen::VectorXd& constants,
+                      std::vector<Eigen::ArrayXXd>& forward_eval,
+                      int result_index) {
+  forward_eval[result_index] = forward_eval[param1].exp();
 }
 void exp_reverse_eval(int reverse_index, int param1, int param2, 
                       const std::vector<Eigen::ArrayXXd>& forward_eval, 
@@ -134,11 +144,12 @@ void exp_reverse_eval(int reverse_index, int param1, int param2,
 }
 
 // Logarithm
-Eigen::ArrayXXd log_forward_eval(int param1, int param2,
-                                 const Eigen::ArrayXXd& x,
-                                 const Eigen::VectorXd& constants,
-                                 std::vector<Eigen::ArrayXXd>& forward_eval) {
-  return forward_eval[param1].abs().log();
+void log_forward_eval(int param1, int param2,
+                      const Eigen::Ref<const Eigen::ArrayXXd>& x,
+                      const Eigen::VectorXd& constants,
+                      std::vector<Eigen::ArrayXXd>& forward_eval,
+                      int result_index) {
+  forward_eval[result_index] = forward_eval[param1].abs().log();
 }
 void log_reverse_eval(int reverse_index, int param1, int param2, 
                       const std::vector<Eigen::ArrayXXd>& forward_eval, 
@@ -148,11 +159,12 @@ void log_reverse_eval(int reverse_index, int param1, int param2,
 }
 
 // Power
-Eigen::ArrayXXd pow_forward_eval(int param1, int param2,
-                                 const Eigen::ArrayXXd& x,
-                                 const Eigen::VectorXd& constants,
-                                 std::vector<Eigen::ArrayXXd>& forward_eval) {
-  return forward_eval[param1].abs().pow(forward_eval[param2]);
+void pow_forward_eval(int param1, int param2,
+                      const Eigen::Ref<const Eigen::ArrayXXd>& x,
+                      const Eigen::VectorXd& constants,
+                      std::vector<Eigen::ArrayXXd>& forward_eval,
+                      int result_index) {
+  forward_eval[result_index] = forward_eval[param1].abs().pow(forward_eval[param2]);
 }
 void pow_reverse_eval(int reverse_index, int param1, int param2, 
                       const std::vector<Eigen::ArrayXXd>& forward_eval, 
@@ -167,11 +179,12 @@ void pow_reverse_eval(int reverse_index, int param1, int param2,
 }
 
 // Absolute Value
-Eigen::ArrayXXd abs_forward_eval(int param1, int param2,
-                                 const Eigen::ArrayXXd& x,
-                                 const Eigen::VectorXd& constants,
-                                 std::vector<Eigen::ArrayXXd>& forward_eval) {
-  return forward_eval[param1].abs();
+void abs_forward_eval(int param1, int param2,
+                      const Eigen::Ref<const Eigen::ArrayXXd>& x,
+                      const Eigen::VectorXd& constants,
+                      std::vector<Eigen::ArrayXXd>& forward_eval,
+                      int result_index) {
+  forward_eval[result_index] = forward_eval[param1].abs();
 }
 void abs_reverse_eval(int reverse_index, int param1, int param2, 
                       const std::vector<Eigen::ArrayXXd>& forward_eval, 
@@ -181,11 +194,12 @@ void abs_reverse_eval(int reverse_index, int param1, int param2,
 }
 
 // Sqruare root
-Eigen::ArrayXXd sqrt_forward_eval(int param1, int param2,
-                                  const Eigen::ArrayXXd& x,
-                                  const Eigen::VectorXd& constants,
-                                  std::vector<Eigen::ArrayXXd>& forward_eval) {
-  return forward_eval[param1].abs().sqrt();
+void sqrt_forward_eval(int param1, int param2,
+                       const Eigen::Ref<const Eigen::ArrayXXd>& x,
+                       const Eigen::VectorXd& constants,
+                       std::vector<Eigen::ArrayXXd>& forward_eval,
+                       int result_index) {
+  forward_eval[result_index] = forward_eval[param1].abs().sqrt();
 }
 void sqrt_reverse_eval(int reverse_index, int param1, int param2, 
                        const std::vector<Eigen::ArrayXXd>& forward_eval, 
@@ -228,11 +242,13 @@ const std::vector<reverse_operator_function> reverse_eval_map {
 };
 } //namespace
 
-Eigen::ArrayXXd forward_eval_function(int node, int param1, int param2,
-                                      const Eigen::ArrayXXd& x, 
-                                      const Eigen::VectorXd& constants,
-                                      std::vector<Eigen::ArrayXXd>& forward_eval) {
-  return forward_eval_map.at(node)(param1, param2, x, constants, forward_eval);
+void forward_eval_function(int node, int param1, int param2,
+                           const Eigen::Ref<const Eigen::ArrayXXd>& x,
+                           const Eigen::VectorXd& constants,
+                           std::vector<Eigen::ArrayXXd>& forward_eval,
+                           int result_index) {
+  forward_eval_map.at(node)(param1, param2, x, constants, forward_eval,
+                            result_index);
 }
 
 void reverse_eval_function(int node, int reverse_index, int param1, int param2,
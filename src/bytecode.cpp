@@ -0,0 +1,353 @@
+#include <limits>
+
+#include "BingoCpp/acyclic_graph.h"
+#include "BingoCpp/backend.h"
+#include "BingoCpp/bytecode.h"
+
+namespace bingo {
+namespace {
+
+const int NODE_IDX = 0;
+const int OP_1 = 1;
+const int OP_2 = 2;
+
+const int X_LOAD = 0;
+const int ADDITION = 2;
+const int SUBTRACTION = 3;
+const int MULTIPLICATION = 4;
+const int DIVISION = 5;
+const int SIN = 6;
+const int COS = 7;
+const int EXP = 8;
+const int LOG = 9;
+const int POWER = 10;
+const int ABSOLUTE = 11;
+const int SQRT = 12;
+
+typedef Eigen::Map<const Eigen::ArrayXd> Column;
+typedef Eigen::ArrayXd::ConstantReturnType Broadcast;
+typedef Eigen::Map<Eigen::ArrayXd> Output;
+
+// ---------------------------------------------------------------------------
+// Execution
+// ---------------------------------------------------------------------------
+
+// Operands of one execution of a program.
+struct Operands {
+  const Eigen::Ref<const Eigen::ArrayXXd>& x;
+  const Eigen::VectorXd& constants;
+  std::vector<Eigen::ArrayXXd>& buffers;
+  int rows;
+
+  Operands(const Eigen::Ref<const Eigen::ArrayXXd>& x,
+           const Eigen::VectorXd& constants,
+           std::vector<Eigen::ArrayXXd>& buffers)
+    : x(x), constants(constants), buffers(buffers), rows(x.rows()) {}
+
+  Column column(const Operand& operand) const {
+    if (operand.kind == X_OPERAND) {
+      return Column(x.col(operand.index).data(), rows);
+    }
+    return Column(buffers[operand.index].data(), rows);
+  }
+
+  Broadcast broadcast(const Operand& operand) const {
+    return Eigen::ArrayXd::Constant(rows, constants[operand.index]);
+  }
+};
+
+template <typename Value>
+void store(int unary_node, const Value& value, Output& out) {
+  switch (unary_node) {
+    case SIN:
+      out = value.sin();
+      break;
+    case COS:
+      out = value.cos();
+      break;
+    case EXP:
+      out = value.exp();
+      break;
+    case LOG:
+      out = value.abs().log();
+      break;
+    case ABSOLUTE:
+      out = value.abs();
+      break;
+    case SQRT:
+      out = value.abs().sqrt();
+      break;
+    default:
+      out = value;
+  }
+}
+
+template <typename A, typename B>
+void binary(const Instruction& instruction, const A& a, const B& b,
+            Output& out) {
+  switch (instruction.binary_node) {
+    case ADDITION:
+      store(instruction.unary_node, a + b, out);
+      break;
+    case SUBTRACTION:
+      store(instruction.unary_node, a - b, out);
+      break;
+    case MULTIPLICATION:
+      store(instruction.unary_node, a * b, out);
+      break;
+    case DIVISION:
+      store(instruction.unary_node, a / b, out);
+      break;
+    case POWER:
+      store(instruction.unary_node, a.abs().pow(b), out);
+      break;
+  }
+}
+
+template <typename A, typename B>
+void multiply_add(const Instruction& instruction, const A& a, const B& b,
+                  const Operands& operands, Output& out) {
+  const Operand& c = instruction.args[2];
+  if (c.kind == CONSTANT_OPERAND) {
+    store(instruction.unary_node, a * b + operands.broadcast(c), out);
+  } else {
+    store(instruction.unary_node, a * b + operands.column(c), out);
+  }
+}
+
+template <typename A, typename B>
+void execute_ab(const Instruction& instruction, const A& a, const B& b,
+                const Operands& operands, Output& out) {
+  if (instruction.code == MULTIPLY_ADD_OP) {
+    multiply_add(instruction, a, b, operands, out);
+  } else {
+    binary(instruction, a, b, out);
+  }
+}
+
+template <typename A>
+void execute_a(const Instruction& instruction, const A& a,
+               const Operands& operands, Output& out) {
+  if (instruction.code == UNARY_OP) {
+    store(instruction.unary_node, a, out);
+    return;
+  }
+
+  const Operand& b = instruction.args[1];
+  if (b.kind == CONSTANT_OPERAND) {
+    execute_ab(instruction, a, operands.broadcast(b), operands, out);
+  } else {
+    execute_ab(instruction, a, operands.column(b), operands, out);
+  }
+}
+
+void execute(const Instruction& instruction, Operands& operands) {
+  Eigen::ArrayXXd& dst = operands.buffers[instruction.dst];
+  dst.resize(operands.rows, 1);
+  Output out(dst.data(), operands.rows);
+
+  const Operand& a = instruction.args[0];
+  if (a.kind == CONSTANT_OPERAND) {
+    execute_a(instruction, operands.broadcast(a), operands, out);
+  } else {
+    execute_a(instruction, operands.column(a), operands, out);
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Compilation
+// ---------------------------------------------------------------------------
+
+bool is_unary(int node) {
+  return !AcyclicGraph::is_terminal(node) && !AcyclicGraph::has_arity_two(node);
+}
+
+Operand make_operand(OperandKind kind, int index) {
+  Operand operand;
+  operand.kind = kind;
+  operand.index = index;
+  return operand;
+}
+
+Instruction make_instruction(OpCode code, int binary_node, int unary_node) {
+  Instruction instruction;
+  instruction.code = code;
+  instruction.binary_node = binary_node;
+  instruction.unary_node = unary_node;
+  instruction.dst = -1;
+  for (int i = 0; i < 3; ++i) {
+    instruction.args[i] = make_operand(BUFFER_OPERAND, -1);
+  }
+  return instruction;
+}
+
+int num_args(const Instruction& instruction) {
+  switch (instruction.code) {
+    case UNARY_OP:
+      return 1;
+    case BINARY_OP:
+      return 2;
+    default:
+      return 3;
+  }
+}
+
+// Replaces the row numbers written and read by the instructions with a small
+// set of recycled buffers.  A buffer is released after the last instruction
+// reading it, before the destination of that instruction is assigned.
+void allocate_program_buffers(Program& program, int stack_size) {
+  std::vector<Instruction>& instructions = program.instructions;
+  std::vector<int> last_use(stack_size, -1);
+  for (std::size_t i = 0; i < instructions.size(); ++i) {
+    for (int arg = 0; arg < num_args(instructions[i]); ++arg) {
+      const Operand& operand = instructions[i].args[arg];
+      if (operand.kind == BUFFER_OPERAND) {
+        last_use[operand.index] = i;
+      }
+    }
+  }
+  last_use[stack_size - 1] = std::numeric_limits<int>::max();
+
+  std::vector<int> buffer(stack_size, -1);
+  std::vector<int> free_buffers;
+  program.num_buffers = 0;
+  for (std::size_t i = 0; i < instructions.size(); ++i) {
+    Instruction& instruction = instructions[i];
+    for (int arg = 0; arg < num_args(instruction); ++arg) {
+      Operand& operand = instruction.args[arg];
+      if (operand.kind == BUFFER_OPERAND) {
+        int row = operand.index;
+        operand.index = buffer[row];
+        if (last_use[row] == static_cast<int>(i)) {
+          free_buffers.push_back(buffer[row]);
+          last_use[row] = -1;
+        }
+      }
+    }
+
+    int row = instruction.dst;
+    if (free_buffers.empty()) {
+      buffer[row] = program.num_buffers++;
+    } else {
+      buffer[row] = free_buffers.back();
+      free_buffers.pop_back();
+    }
+    instruction.dst = buffer[row];
+  }
+  program.result = buffer[stack_size - 1];
+}
+} // namespace
+
+Program compile_stack(const Eigen::ArrayX3i& stack) {
+  Program program;
+  program.stack = stack;
+  int stack_size = stack.rows();
+
+  std::vector<bool> used;
+  get_utilized_commands(stack, used);
+  std::vector<int> num_uses(stack_size, 0);
+  std::vector<int> consumer(stack_size, -1);
+  for (int row = 0; row < stack_size; ++row) {
+    int node = stack(row, NODE_IDX);
+    if (used[row] && !AcyclicGraph::is_terminal(node)) {
+      ++num_uses[stack(row, OP_1)];
+      consumer[stack(row, OP_1)] = row;
+      if (AcyclicGraph::has_arity_two(node)) {
+        ++num_uses[stack(row, OP_2)];
+        consumer[stack(row, OP_2)] = row;
+      }
+    }
+  }
+  ++num_uses[stack_size - 1];
+
+  // multiplications which can be folded into the addition reading them
+  std::vector<bool> fusable_product(stack_size, false);
+  for (int row = 0; row < stack_size; ++row) {
+    fusable_product[row] = used[row] && num_uses[row] == 1 &&
+                           consumer[row] >= 0 &&
+                           stack(row, NODE_IDX) == MULTIPLICATION &&
+                           stack(consumer[row], NODE_IDX) == ADDITION;
+  }
+
+  std::vector<Operand> operands(stack_size);
+  std::vector<Instruction> pending(stack_size);
+  std::vector<bool> folded(stack_size, false);
+  for (int row = 0; row < stack_size; ++row) {
+    if (!used[row]) {
+      continue;
+    }
+
+    int node = stack(row, NODE_IDX);
+    int param1 = stack(row, OP_1);
+    int param2 = stack(row, OP_2);
+    Instruction instruction;
+
+    if (AcyclicGraph::is_terminal(node)) {
+      operands[row] = make_operand(node == X_LOAD ? X_OPERAND
+                                                  : CONSTANT_OPERAND, param1);
+      if (row < stack_size - 1) {
+        continue;
+      }
+      instruction = make_instruction(UNARY_OP, -1, NO_UNARY_NODE);
+      instruction.args[0] = operands[row];
+
+    } else if (is_unary(node)) {
+      if (folded[param1]) {
+        instruction = pending[param1];
+      } else {
+        instruction = make_instruction(UNARY_OP, -1, NO_UNARY_NODE);
+        instruction.args[0] = operands[param1];
+      }
+      instruction.unary_node = node;
+
+    } else if (node == ADDITION && (fusable_product[param1] ||
+                                    fusable_product[param2])) {
+      int product = fusable_product[param1] ? param1 : param2;
+      int addend = fusable_product[param1] ? param2 : param1;
+      instruction = make_instruction(MULTIPLY_ADD_OP, -1, NO_UNARY_NODE);
+      instruction.args[0] = pending[product].args[0];
+      instruction.args[1] = pending[product].args[1];
+      instruction.args[2] = operands[addend];
+
+    } else {
+      instruction = make_instruction(BINARY_OP, node, NO_UNARY_NODE);
+      instruction.args[0] = operands[param1];
+      instruction.args[1] = operands[param2];
+    }
+
+    // the value of the row is only computed inside the instruction reading it
+    folded[row] = num_uses[row] == 1 && consumer[row] >= 0 &&
+                  instruction.code != UNARY_OP &&
+                  instruction.unary_node == NO_UNARY_NODE &&
+                  (is_unary(stack(consumer[row], NODE_IDX)) ||
+                   (fusable_product[row] &&
+                    (stack(consumer[row], OP_1) == row ||
+                     !fusable_product[stack(consumer[row], OP_1)])));
+    if (folded[row]) {
+      pending[row] = instruction;
+    } else {
+      instruction.dst = row;
+      program.instructions.push_back(instruction);
+      operands[row] = make_operand(BUFFER_OPERAND, row);
+    }
+  }
+
+  allocate_program_buffers(program, stack_size);
+  return program;
+}
+
+bool is_compiled_from(const Program& program, const Eigen::ArrayX3i& stack) {
+  return program.stack.rows() == stack.rows() &&
+         (program.stack == stack).all();
+}
+
+void run_program(const Program& program,
+                 const Eigen::Ref<const Eigen::ArrayXXd>& x,
+                 const Eigen::VectorXd& constants,
+                 std::vector<Eigen::ArrayXXd>& buffers) {
+  Operands operands(x, constants, buffers);
+  for (std::size_t i = 0; i < program.instructions.size(); ++i) {
+    execute(program.instructions[i], operands);
+  }
+}
+} // namespace bingo
@@ -0,0 +1,170 @@
+/*!
+ * \file distance.cpp
+ *
+ * This file contains the pairwise distances of the stacks of a population.
+ */
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <utility>
+
+#include "BingoCpp/distance.h"
+#include "BingoCpp/stack_analysis.h"
+
+namespace bingo {
+namespace {
+
+const int TILE = 64;
+// fields of commands which are not utilized
+const int UNUSED = -2;
+// largest field which still packs into a byte along with UNUSED and -1
+const int MAX_BYTE_FIELD = 253;
+
+// Writes the fields of stack which mode compares.
+void pack_stack(const Eigen::ArrayX3i &stack, DistanceMode mode,
+                int* packed) {
+  if (mode == STACK_DISTANCE) {
+    for (int row = 0; row < stack.rows(); ++row) {
+      packed[3 * row] = stack(row, 0);
+      packed[3 * row + 1] = stack(row, 1);
+      packed[3 * row + 2] = stack(row, 2);
+    }
+    return;
+  }
+
+  StackAnalysis &analysis = thread_stack_analysis();
+  analyze_stack(stack, analysis);
+
+  for (int row = 0; row < stack.rows(); ++row) {
+    int node = stack(row, 0);
+
+    if (!analysis.is_utilized(row)) {
+      packed[3 * row] = UNUSED;
+      packed[3 * row + 1] = UNUSED;
+      packed[3 * row + 2] = UNUSED;
+
+    } else {
+      packed[3 * row] = node;
+      packed[3 * row + 1] = stack(row, 1);
+      packed[3 * row + 2] = AcyclicGraph::has_arity_two(node) ?
+                            stack(row, 2) : stack(row, 1);
+    }
+  }
+}
+
+template <typename T>
+int hamming(const T* a, const T* b, int length) {
+  int count = 0;
+
+  for (int k = 0; k < length; ++k) {
+    count += a[k] != b[k];
+  }
+
+  return count;
+}
+
+template <typename T>
+void fill_distances(const T* packed, int n, int length, ThreadPool &pool,
+                    Eigen::ArrayXXi &distances) {
+  int num_tiles = (n + TILE - 1) / TILE;
+  std::vector<std::pair<int, int> > tiles;
+
+  for (int ti = 0; ti < num_tiles; ++ti) {
+    for (int tj = ti; tj < num_tiles; ++tj) {
+      tiles.push_back(std::make_pair(ti, tj));
+    }
+  }
+
+  pool.parallel_for(tiles.size(), [&](int task) {
+    int i_end = std::min(n, (tiles[task].first + 1) * TILE);
+    int j_end = std::min(n, (tiles[task].second + 1) * TILE);
+
+    for (int i = tiles[task].first * TILE; i < i_end; ++i) {
+      const T* a = packed + static_cast<std::size_t>(i) * length;
+
+      for (int j = std::max(i + 1, tiles[task].second * TILE); j < j_end;
+           ++j) {
+        int distance = hamming(a, packed + static_cast<std::size_t>(j) *
+                               length, length);
+        distances(i, j) = distance;
+        distances(j, i) = distance;
+      }
+    }
+  });
+}
+
+// Packs the stack of every individual, stack_of(i, stack) giving the stack
+// of individual i, then compares every pair.
+template <typename StackOf>
+Eigen::ArrayXXi pairwise_distances(int n, int stack_size, StackOf stack_of,
+                                   DistanceMode mode, ThreadPool &pool) {
+  int length = 3 * stack_size;
+  std::vector<int> packed(static_cast<std::size_t>(n) * length);
+  pool.parallel_for(n, [&](int i) {
+    static thread_local Eigen::ArrayX3i stack;
+    stack_of(i, stack);
+    pack_stack(stack, mode, packed.data() + static_cast<std::size_t>(i) *
+               length);
+  });
+
+  Eigen::ArrayXXi distances = Eigen::ArrayXXi::Zero(n, n);
+  if (packed.empty()) {
+    return distances;
+  }
+
+  std::pair<std::vector<int>::iterator, std::vector<int>::iterator> range =
+    std::minmax_element(packed.begin(), packed.end());
+
+  if (*range.first >= UNUSED && *range.second <= MAX_BYTE_FIELD) {
+    // UNUSED and -1 become 254 and 255, which no other field takes
+    std::vector<uint8_t> bytes(packed.begin(), packed.end());
+    fill_distances(bytes.data(), n, length, pool, distances);
+  } else {
+    fill_distances(packed.data(), n, length, pool, distances);
+  }
+
+  return distances;
+}
+} // namespace
+
+template <typename Command>
+Eigen::ArrayXXi distance_matrix(const BasicPopulation<Command> &population,
+                                DistanceMode mode) {
+  ThreadPool serial(1);
+  return distance_matrix(population, mode, serial);
+}
+
+template <typename Command>
+Eigen::ArrayXXi distance_matrix(const BasicPopulation<Command> &population,
+                                DistanceMode mode, ThreadPool &pool) {
+  return pairwise_distances(population.size(), population.stack_size(),
+  [&population](int i, Eigen::ArrayX3i &stack) {
+    stack = population.stack(i).template cast<int>();
+  }, mode, pool);
+}
+
+Eigen::ArrayXXi distance_matrix(const std::vector<AcyclicGraph> &population,
+                                DistanceMode mode) {
+  ThreadPool serial(1);
+  return distance_matrix(population, mode, serial);
+}
+
+Eigen::ArrayXXi distance_matrix(const std::vector<AcyclicGraph> &population,
+                                DistanceMode mode, ThreadPool &pool) {
+  int stack_size = population.empty() ? 0 : population[0].stack.rows();
+  return pairwise_distances(population.size(), stack_size,
+  [&population](int i, Eigen::ArrayX3i &stack) {
+    stack = population[i].stack;
+  }, mode, pool);
+}
+
+template Eigen::ArrayXXi distance_matrix(const Population &population,
+                                         DistanceMode mode);
+template Eigen::ArrayXXi distance_matrix(const Population &population,
+                                         DistanceMode mode, ThreadPool &pool);
+template Eigen::ArrayXXi distance_matrix(
+  const CompactPopulation &population, DistanceMode mode);
+template Eigen::ArrayXXi distance_matrix(
+  const CompactPopulation &population, DistanceMode mode, ThreadPool &pool);
+} // namespace bingo
@@ -0,0 +1,146 @@
+/*!
+ * \file fitness_cache.cpp
+ *
+ * This file contains the cache of the fitness of evaluated individuals.
+ */
+
+#include <cstring>
+
+#include "BingoCpp/fitness_cache.h"
+#include "BingoCpp/memo.h"
+
+namespace bingo {
+namespace {
+
+const int NODE_IDX = 0;
+const int OP_1 = 1;
+const int OP_2 = 2;
+
+const int C_LOAD = 1;
+
+uint64_t combine(uint64_t hash, uint64_t value) {
+  hash ^= value + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+  hash ^= hash >> 30;
+  hash *= 0xbf58476d1ce4e5b9ULL;
+  hash ^= hash >> 27;
+  hash *= 0x94d049bb133111ebULL;
+  hash ^= hash >> 31;
+  return hash;
+}
+
+uint64_t bits(double value) {
+  uint64_t result;
+  std::memcpy(&result, &value, sizeof(result));
+  return result;
+}
+} // namespace
+
+FitnessCache::FitnessCache(std::size_t capacity)
+  : capacity_(capacity), hits_(0), misses_(0) {}
+
+bool FitnessCache::find(uint64_t key, CachedFitness &cached) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::unordered_map<uint64_t, std::list<Entry>::iterator>::iterator found =
+    index_.find(key);
+  if (found == index_.end()) {
+    ++misses_;
+    return false;
+  }
+  ++hits_;
+  entries_.splice(entries_.begin(), entries_, found->second);
+  cached = found->second->second;
+  return true;
+}
+
+void FitnessCache::insert(uint64_t key, const CachedFitness &cached) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (capacity_ == 0) {
+    return;
+  }
+  std::unordered_map<uint64_t, std::list<Entry>::iterator>::iterator found =
+    index_.find(key);
+  if (found != index_.end()) {
+    found->second->second = cached;
+    entries_.splice(entries_.begin(), entries_, found->second);
+    return;
+  }
+  entries_.push_front(Entry(key, cached));
+  index_[key] = entries_.begin();
+  if (entries_.size() > capacity_) {
+    index_.erase(entries_.back().first);
+    entries_.pop_back();
+  }
+}
+
+void FitnessCache::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.clear();
+  index_.clear();
+}
+
+std::size_t FitnessCache::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return entries_.size();
+}
+
+std::size_t FitnessCache::hits() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return hits_;
+}
+
+std::size_t FitnessCache::misses() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return misses_;
+}
+
+uint64_t training_data_hash(TrainingData &train) {
+  uint64_t hash;
+  ExplicitTrainingData* explicit_data =
+    dynamic_cast<ExplicitTrainingData*>(&train);
+  ImplicitTrainingData* implicit_data =
+    dynamic_cast<ImplicitTrainingData*>(&train);
+  if (explicit_data != NULL) {
+    hash = combine(hash_samples(explicit_data->x),
+                   hash_samples(explicit_data->y));
+  } else if (implicit_data != NULL) {
+    hash = combine(combine(hash_samples(implicit_data->x),
+                           hash_samples(implicit_data->dx_dt)), 1);
+  } else {
+    return 0;
+  }
+  // 0 is kept for data which cannot be hashed
+  return hash != 0 ? hash : 1;
+}
+
+uint64_t training_data_id(TrainingData &train) {
+  uint64_t id = train.dataset_id;
+  if (id == 0) {
+    // threads racing here compute and store the same value
+    id = training_data_hash(train);
+    train.dataset_id = id;
+  }
+  return id;
+}
+
+uint64_t fitness_key(AcyclicGraph &indv, uint64_t dataset_id) {
+  bool needs_optimization = indv.needs_optimization();
+  const Eigen::ArrayX3i& stack = indv.simple_stack;
+  uint64_t hash = combine(dataset_id, needs_optimization);
+  for (int row = 0; row < stack.rows(); ++row) {
+    int node = stack(row, NODE_IDX);
+    hash = combine(hash, node);
+    if (node == C_LOAD) {
+      // constants are numbered in stack order, so only the values matter
+      int param = stack(row, OP_1);
+      if (!needs_optimization && param >= 0 && param < indv.constants.size()) {
+        hash = combine(hash, bits(indv.constants[param]));
+      }
+    } else if (AcyclicGraph::has_arity_two(node)) {
+      hash = combine(combine(hash, stack(row, OP_1)), stack(row, OP_2));
+    } else {
+      hash = combine(hash, stack(row, OP_1));
+    }
+  }
+  return hash;
+}
+} // namespace bingo
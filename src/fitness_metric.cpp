@@ -7,6 +7,7 @@
  * This file contains the cpp version of FitnessMetric.py
  */
 
+#include "BingoCpp/backend.h"
 #include "BingoCpp/fitness_metric.h"
 #include <iostream>
 #include <stdlib.h>
@@ -18,11 +19,24 @@ namespace bingo {
   
 int LMFunctor::operator()(const Eigen::VectorXd &x, Eigen::VectorXd &fvec) {
   agraphIndv.set_constants(x);
-  fvec = fit->evaluate_fitness_vector(agraphIndv, *train);
+  fit->evaluate_fused(agraphIndv, *train, true, evaluation);
+  evaluated_constants = x;
+  fvec = evaluation.residual;
   return 0;
 }
 
 int LMFunctor::df(const Eigen::VectorXd &x, Eigen::MatrixXd &fjac) {
+  if (evaluated_constants.size() != x.size() || evaluated_constants != x) {
+    agraphIndv.set_constants(x);
+    fit->evaluate_fused(agraphIndv, *train, true, evaluation);
+    evaluated_constants = x;
+  }
+
+  if (evaluation.has_jacobian) {
+    fjac = evaluation.jacobian.matrix();
+    return 0;
+  }
+
   double epsilon;
   epsilon = 1e-5f;
 
@@ -43,25 +57,153 @@ int LMFunctor::df(const Eigen::VectorXd &x, Eigen::MatrixXd &fjac) {
   return 0;
 }
 
+bool FitnessMetric::evaluate_fitness_jacobian(AcyclicGraph &,
+                                              TrainingData &,
+                                              Eigen::MatrixXd &) {
+  return false;
+}
+
+void FitnessMetric::evaluate_fused(AcyclicGraph &indv, TrainingData &train,
+                                   bool with_jacobian,
+                                   FitnessEvaluation &evaluation) {
+  evaluation.residual = evaluate_fitness_vector(indv, train);
+  evaluation.fitness = evaluation.residual.abs().mean();
+  evaluation.has_jacobian = false;
+
+  if (with_jacobian) {
+    Eigen::MatrixXd jacobian;
+    evaluation.has_jacobian = evaluate_fitness_jacobian(indv, train, jacobian);
+    evaluation.jacobian = jacobian.array();
+  }
+}
+
+namespace {
+
+// On a hit the individual takes the constants the fitness was reached with,
+// so it no longer needs optimization.
+bool find_cached_fitness(FitnessCache &cache, uint64_t key,
+                         AcyclicGraph &indv, double &fitness) {
+  CachedFitness cached;
+  if (!cache.find(key, cached)) {
+    return false;
+  }
+  if (indv.needs_optimization()) {
+    indv.count_constants();
+    indv.needs_opt = false;
+  }
+  indv.set_constants(cached.constants);
+  fitness = cached.fitness;
+  return true;
+}
+
+// Stores the fitness under the key the individual was looked up with and,
+// if optimization changed its key, under the new key too.
+void cache_fitness(FitnessCache &cache, uint64_t key, AcyclicGraph &indv,
+                   uint64_t dataset_id, double fitness) {
+  CachedFitness cached;
+  cached.fitness = fitness;
+  cached.constants = indv.constants;
+  cache.insert(key, cached);
+  uint64_t optimized_key = fitness_key(indv, dataset_id);
+  if (optimized_key != key) {
+    cache.insert(optimized_key, cached);
+  }
+}
+} // namespace
+
 double FitnessMetric::evaluate_fitness(AcyclicGraph &indv,
                                        TrainingData &train) {
+  uint64_t dataset_id = fitness_cache != NULL ? training_data_id(train) : 0;
+  uint64_t key = 0;
+  double fitness;
+  if (dataset_id != 0) {
+    key = fitness_key(indv, dataset_id);
+    if (find_cached_fitness(*fitness_cache, key, indv, fitness)) {
+      return fitness;
+    }
+  }
+
   if (indv.needs_optimization()) {
     optimize_constants(indv, train);
   }
 
-  return ((evaluate_fitness_vector(indv, train)).abs()).mean();
+  FitnessEvaluation evaluation;
+  evaluate_fused(indv, train, false, evaluation);
+  if (dataset_id != 0) {
+    cache_fitness(*fitness_cache, key, indv, dataset_id, evaluation.fitness);
+  }
+  return evaluation.fitness;
+}
+
+std::vector<double> FitnessMetric::evaluate_population_fitness(
+  std::vector<AcyclicGraph> &population, TrainingData &train,
+  ThreadPool &pool) {
+  std::vector<Eigen::VectorXd> initial_constants(population.size());
+
+  for (std::size_t i = 0; i < population.size(); ++i) {
+    if (population[i].needs_optimization()) {
+      initial_constants[i] = Eigen::VectorXd::Random(
+                               population[i].count_constants());
+    }
+  }
+
+  return evaluate_population_fitness(population, train, initial_constants,
+                                     pool);
+}
+
+std::vector<double> FitnessMetric::evaluate_population_fitness(
+  std::vector<AcyclicGraph> &population, TrainingData &train,
+  const std::vector<Eigen::VectorXd> &initial_constants, ThreadPool &pool) {
+  std::vector<bool> needs_optimization(population.size());
+
+  for (std::size_t i = 0; i < population.size(); ++i) {
+    needs_optimization[i] = population[i].needs_optimization();
+  }
+
+  uint64_t dataset_id = fitness_cache != NULL ? training_data_id(train) : 0;
+  std::vector<double> fitness(population.size());
+  pool.parallel_for(population.size(), [&](int i) {
+    uint64_t key = 0;
+    if (dataset_id != 0) {
+      key = fitness_key(population[i], dataset_id);
+      if (find_cached_fitness(*fitness_cache, key, population[i],
+                              fitness[i])) {
+        return;
+      }
+    }
+
+    if (needs_optimization[i]) {
+      optimize_constants(population[i], train, initial_constants[i]);
+    }
+
+    FitnessEvaluation evaluation;
+    evaluate_fused(population[i], train, false, evaluation);
+    fitness[i] = evaluation.fitness;
+    if (dataset_id != 0) {
+      cache_fitness(*fitness_cache, key, population[i], dataset_id,
+                    fitness[i]);
+    }
+  });
+  return fitness;
 }
 
 void FitnessMetric::optimize_constants(AcyclicGraph &indv,
                                        TrainingData &train) {
+  // indv.input_constants();
+  Eigen::VectorXd vec = Eigen::VectorXd::Random(indv.count_constants());
+  optimize_constants(indv, train, vec);
+}
+
+void FitnessMetric::optimize_constants(AcyclicGraph &indv,
+                                       TrainingData &train,
+                                       const Eigen::VectorXd &initial_constants) {
   LMFunctor functor;
   functor.train = &train;
   functor.fit = this;
   functor.m = functor.train->size();
-  // indv.input_constants();
-  functor.n = indv.count_constants();
+  functor.n = initial_constants.size();
   functor.agraphIndv = indv;
-  Eigen::VectorXd vec = Eigen::VectorXd::Random(functor.n);
+  Eigen::VectorXd vec = initial_constants;
   Eigen::LevenbergMarquardt<LMFunctor, double> lm(functor);
   lm.minimize(vec);
   indv.set_constants(vec);
@@ -71,9 +213,68 @@ void FitnessMetric::optimize_constants(AcyclicGraph &indv,
 Eigen::ArrayXXd StandardRegression::evaluate_fitness_vector(AcyclicGraph &indv,
     TrainingData &train) {
   ExplicitTrainingData* temp = dynamic_cast<ExplicitTrainingData*>(&train);
+
+  if (pool != NULL) {
+    return (indv.evaluate(temp->x, *pool)) - temp->y;
+  }
+
   return (indv.evaluate(temp->x)) - temp->y;
 }
 
+bool StandardRegression::evaluate_fitness_jacobian(AcyclicGraph &indv,
+    TrainingData &train, Eigen::MatrixXd &jacobian) {
+  ExplicitTrainingData* temp = dynamic_cast<ExplicitTrainingData*>(&train);
+  std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd> deriv = pool == NULL ?
+      indv.evaluate_with_const_deriv(temp->x) :
+      indv.evaluate_with_const_deriv(temp->x, *pool);
+  jacobian = deriv.second.matrix();
+  return true;
+}
+
+// The residual and its constant derivative come from one forward and one
+// reverse sweep of simple_stack; value-only evaluations run the bytecode,
+// or the evaluation cache of the individual when it has one, or go through
+// the memo when the metric has one.
+void StandardRegression::evaluate_fused(AcyclicGraph &indv,
+                                        TrainingData &train,
+                                        bool with_jacobian,
+                                        FitnessEvaluation &evaluation) {
+  bool use_cache = !with_jacobian && pool == NULL && indv.evaluation_cache;
+
+  if (use_cache || (indv.native_kernel &&
+                    indv.native_kernel->is_compiled_from(indv.simple_stack))) {
+    FitnessMetric::evaluate_fused(indv, train, with_jacobian, evaluation);
+    return;
+  }
+
+  ExplicitTrainingData* temp = dynamic_cast<ExplicitTrainingData*>(&train);
+  evaluation.has_jacobian = with_jacobian;
+
+  if (!with_jacobian && memo != NULL) {
+    evaluation.residual = evaluate(indv.simple_stack, temp->x, indv.constants,
+                                   *memo) - temp->y;
+    evaluation.fitness = evaluation.residual.abs().mean();
+
+  } else if (!with_jacobian) {
+    evaluation.fitness = pool == NULL ?
+      evaluate_residual(indv.compiled_program(), temp->x, indv.constants,
+                        temp->y, evaluation.residual) :
+      evaluate_residual(indv.compiled_program(), temp->x, indv.constants,
+                        temp->y, *pool, evaluation.residual);
+
+  } else {
+    evaluation.fitness = pool == NULL ?
+      evaluate_residual_with_derivative(indv.simple_stack, temp->x,
+                                        indv.constants, temp->y,
+                                        evaluation.residual,
+                                        evaluation.jacobian) :
+      evaluate_residual_with_derivative(indv.simple_stack, temp->x,
+                                        indv.constants, temp->y, *pool,
+                                        evaluation.residual,
+                                        evaluation.jacobian);
+  }
+}
+
 ImplicitRegression::ImplicitRegression(int required_params, bool normalize_dot,
                                        double acceptable_nans) {
   this->required_params = required_params;
@@ -84,14 +285,15 @@ ImplicitRegression::ImplicitRegression(int required_params, bool normalize_dot,
 Eigen::ArrayXXd ImplicitRegression::evaluate_fitness_vector(AcyclicGraph &indv,
     TrainingData &train) {
   ImplicitTrainingData* temp = dynamic_cast<ImplicitTrainingData*>(&train);
-  std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd> deriv = indv.evaluate_deriv(
-        temp->x);
+  std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd> deriv = pool == NULL ?
+      indv.evaluate_deriv(temp->x) : indv.evaluate_deriv(temp->x, *pool);
   Eigen::ArrayXXd dot(deriv.second.rows(), deriv.second.cols());
   double infinity = std::numeric_limits<double>::infinity();
 
   if (normalize_dot) {
-    dot = (deriv.second / (deriv.second.square().rowwise().sum().sqrt())) *
-          (temp->dx_dt / (temp->dx_dt.square().rowwise().sum().sqrt()));
+    dot = (deriv.second.colwise() /
+           deriv.second.square().rowwise().sum().sqrt()) *
+          (temp->dx_dt.colwise() / temp->dx_dt.square().rowwise().sum().sqrt());
 
   } else {
     dot = deriv.second * temp->dx_dt;
@@ -119,4 +321,58 @@ Eigen::ArrayXXd ImplicitRegression::evaluate_fitness_vector(AcyclicGraph &indv,
   fit = dot.rowwise().sum() / dot.abs().rowwise().sum();
   return fit;
 }
+
+// The fitness of a sample is sum(dot) / sum(|dot|), where dot is the
+// elementwise product of the x gradient g (optionally divided by its norm)
+// and dx_dt.  Its constant derivative follows from the mixed derivative
+// dg/dc of the stack.
+bool ImplicitRegression::evaluate_fitness_jacobian(AcyclicGraph &indv,
+    TrainingData &train, Eigen::MatrixXd &jacobian) {
+  ImplicitTrainingData* temp = dynamic_cast<ImplicitTrainingData*>(&train);
+  std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd> deriv =
+    evaluate_mixed_derivative(indv.simple_stack, temp->x, indv.constants);
+  const Eigen::ArrayXXd &grad = deriv.first;
+  int x_dim = grad.cols();
+  int c_dim = indv.constants.size();
+  Eigen::ArrayXXd weight = temp->dx_dt;
+  Eigen::ArrayXd norm = Eigen::ArrayXd::Ones(grad.rows());
+
+  if (normalize_dot) {
+    weight = temp->dx_dt.colwise() / temp->dx_dt.square().rowwise().sum().sqrt();
+    norm = grad.square().rowwise().sum().sqrt();
+  }
+
+  Eigen::ArrayXXd dot = (grad.colwise() / norm) * weight;
+  jacobian.resize(grad.rows(), c_dim);
+
+  if (required_params != 0) {
+    for (int i = 0; i < dot.rows(); ++i) {
+      if ((dot.row(i) > 0).count() >= required_params) {
+        jacobian.setZero();
+        return true;
+      }
+    }
+  }
+
+  Eigen::ArrayXd sum = dot.rowwise().sum();
+  Eigen::ArrayXd abs_sum = dot.abs().rowwise().sum();
+
+  for (int k = 0; k < c_dim; ++k) {
+    Eigen::ArrayXXd dgrad = deriv.second.middleCols(k * x_dim, x_dim);
+
+    if (normalize_dot) {
+      Eigen::ArrayXd projection = (grad * dgrad).rowwise().sum() /
+                                  norm.square();
+      dgrad -= grad.colwise() * projection;
+    }
+
+    Eigen::ArrayXXd ddot = (dgrad.colwise() / norm) * weight;
+    Eigen::ArrayXd dsum = ddot.rowwise().sum();
+    Eigen::ArrayXd dabs_sum = (dot.sign() * ddot).rowwise().sum();
+    jacobian.col(k) = ((dsum * abs_sum - sum * dabs_sum) /
+                       abs_sum.square()).matrix();
+  }
+
+  return true;
+}
 } // namespace bingo 
\ No newline at end of file
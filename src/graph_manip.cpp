@@ -7,14 +7,46 @@
  * This file contains the cpp version of AGraphCpp.py
  */
 
+#include <algorithm>
 #include <iostream>
+#include <utility>
 
 #include "BingoCpp/graph_manip.h"
 #include "BingoCpp/backend.h"
 #include "BingoCpp/acyclic_graph.h"
 #include "BingoCpp/fitness_metric.h"
+#include "BingoCpp/rewrite.h"
+#include "BingoCpp/stack_analysis.h"
 
 namespace bingo {
+namespace {
+
+const int GENERATE_BLOCK = 256;
+
+// Numbers the utilized constants of stack in stack order and forgets the
+// others.  Returns whether a utilized constant had no value yet.
+bool number_constants(Eigen::ArrayX3i &stack, const StackAnalysis &analysis) {
+  bool unset = false;
+
+  for (int i = 0; i < stack.rows(); ++i) {
+    if (stack(i, 0) == 1) {
+      if (analysis.is_utilized(i) && stack(i, 1) == -1) {
+        unset = true;
+      }
+
+      stack(i, 1) = analysis.constant_number[i];
+      stack(i, 2) = analysis.constant_number[i];
+    }
+  }
+
+  return unset;
+}
+
+Eigen::ArrayX3i &thread_generate_stack() {
+  static thread_local Eigen::ArrayX3i stack;
+  return stack;
+}
+} // namespace
 
 AcyclicGraphManipulator::AcyclicGraphManipulator(int nvars, int ag_size,
     int nloads, float float_lim, float terminal_prob, int opt_rate) {
@@ -24,6 +56,9 @@ AcyclicGraphManipulator::AcyclicGraphManipulator(int nvars, int ag_size,
   this->float_lim = float_lim;
   this->terminal_prob = terminal_prob;
   this->opt_rate = opt_rate;
+  eliminate_common_subexpressions = false;
+  rewrite_identities = false;
+  inherit_equivalent_fitness = true;
   num_node_types = 0;
   add_node_type(0);
 
@@ -59,107 +94,93 @@ void AcyclicGraphManipulator::add_node_type(int node_type) {
 
 AcyclicGraph AcyclicGraphManipulator::generate() {
   AcyclicGraph indv = AcyclicGraph();
-  Eigen::ArrayX3i array(ag_size, 3);
-  float r = 0;
-  std::vector<int> vec;
-
-  for (int i = 0; i < ag_size; ++i) {
-    r = static_cast <float> (rand()) / static_cast < float> (RAND_MAX);
-
-    if (i < nloads || r < terminal_prob) {
-      vec = rand_terminal();
-      array(i, 0) = vec[0];
-      array(i, 1) = vec[1];
-      array(i, 2) = vec[2];
-
-    } else {
-      vec = rand_operator(i);
-      array(i, 0) = vec[0];
-      array(i, 1) = vec[1];
-      array(i, 2) = vec[2];
-    }
-  }
-
-  indv.stack = array;
+  fill_random_stack(rng, indv.stack);
   indv.opt_rate = opt_rate;
   simplify_stack(indv);
   return indv;
 }
 
-void AcyclicGraphManipulator::simplify_stack(AcyclicGraph &indv) {
-  std::set<int> util = indv.utilized_commands();
-  std::map<int, int> reduced;
-  Eigen::ArrayX3i temp(util.size(), 3);
-
-  if (opt_rate == 0) {
-    int i = 0;
+Population AcyclicGraphManipulator::generate_batch(int n) {
+  ThreadPool serial(1);
+  return generate_batch(n, serial);
+}
 
-    for (std::set<int>::iterator it = util.begin(); it != util.end(); ++it) {
-      reduced[*it] = i;
-      temp(i, 0) = indv.stack(*it, 0);
-      int arity = get_arity(temp(i, 0));
+Population AcyclicGraphManipulator::generate_batch(int n, ThreadPool &pool) {
+  Population population(n, ag_size);
+  population.opt_rate = opt_rate;
+  population.eliminate_common_subexpressions = eliminate_common_subexpressions;
+  population.rewrite_identities = rewrite_identities;
+  bool merges = rewrite_identities || eliminate_common_subexpressions;
+  std::vector<int> num_constants(n, 0);
+  int num_blocks = (n + GENERATE_BLOCK - 1) / GENERATE_BLOCK;
+  std::vector<Xoshiro256> streams(num_blocks, rng);
+
+  for (int b = 1; b < num_blocks; ++b) {
+    streams[b] = streams[b - 1];
+    streams[b].jump();
+  }
 
-      if (arity == 0) {
-        temp(i, 1) = indv.stack(*it, 1);
-        temp(i, 2) = indv.stack(*it, 2);
+  if (num_blocks > 0) {
+    rng = streams.back();
+  }
 
-      } else {
-        temp(i, 1) = reduced[indv.stack(*it, 1)];
-        temp(i, 2) = reduced[indv.stack(*it, 2)];
+  rng.jump();
+
+  pool.parallel_for(num_blocks, [&](int block) {
+    Eigen::ArrayX3i &stack = thread_generate_stack();
+    StackAnalysis &analysis = thread_stack_analysis();
+    Xoshiro256 &stream = streams[block];
+    int end = std::min(n, (block + 1) * GENERATE_BLOCK);
+
+    for (int i = block * GENERATE_BLOCK; i < end; ++i) {
+      fill_random_stack(stream, stack);
+
+      // with opt_rate 0 constants are numbered only so that individual
+      // does not merge distinct constants, as in simplify_stack
+      if (opt_rate != 0) {
+        analyze_stack(stack, analysis);
+        population.needs_opt[i] = number_constants(stack, analysis);
+        num_constants[i] = analysis.num_constants;
+      } else if (merges) {
+        analyze_stack(stack, analysis);
+        number_constants(stack, analysis);
       }
 
-      ++i;
+      population.stack(i) = stack;
     }
+  });
+  population.reset_constants(num_constants);
+  return population;
+}
 
-    indv.simple_stack = temp;
-
-  } else {
-    std::set<int>::iterator it = util.begin();
-    int j = 0;
-    int const_num = 0;
-
-    for (int i = 0; i < indv.stack.rows(); ++i) {
-      if (i == *it) {
-        reduced[*it] = j;
-        temp(j, 0) = indv.stack(*it, 0);
-
-        if (temp(j, 0) == 0) {
-          temp(j, 1) = indv.stack(*it, 1);
-          temp(j, 2) = indv.stack(*it, 2);
-
-        } else if (temp(j, 0) == 1) {
-          if (indv.stack(*it, 1) == -1) {
-            indv.needs_opt = true;
-          }
+void AcyclicGraphManipulator::simplify_stack(AcyclicGraph &indv) {
+  StackAnalysis &analysis = thread_stack_analysis();
+  analyze_stack(indv.stack, analysis);
 
-          temp(j, 1) = const_num;
-          temp(j, 2) = const_num;
-          indv.stack(*it, 1) = const_num;
-          indv.stack(*it, 2) = const_num;
-          const_num += 1;
+  if (opt_rate != 0 && number_constants(indv.stack, analysis)) {
+    indv.needs_opt = true;
+  }
 
-        } else {
-          temp(j, 1) = reduced[indv.stack(*it, 1)];
-          temp(j, 2) = reduced[indv.stack(*it, 2)];
-        }
+  // merging loses the row of each command, so the constants are numbered
+  // first; a new constant leaves the old ones behind to be optimized again
+  bool merges = rewrite_identities || eliminate_common_subexpressions;
 
-        ++j;
-        ++it;
+  if (opt_rate == 0 && merges && number_constants(indv.stack, analysis)) {
+    indv.constants.resize(0);
+  }
 
-      } else {
-        if (indv.stack(i, 0) == 1) {
-          indv.stack(i, 1) = -1;
-          indv.stack(i, 2) = -1;
-        }
-      }
-    }
+  bingo::simplify_stack(indv.stack, analysis, indv.simple_stack);
+  int const_num = analysis.num_constants;
 
-    indv.simple_stack = temp;
+  if (opt_rate != 0 && const_num > indv.count_constants()) {
+    indv.constants.resize(const_num);
+    indv.needs_opt = true;
+  }
 
-    if (const_num > indv.count_constants()) {
-      indv.constants.resize(const_num);
-      indv.needs_opt = true;
-    }
+  if (rewrite_identities) {
+    indv.simple_stack = rewrite_stack(indv.simple_stack);
+  } else if (eliminate_common_subexpressions) {
+    indv.simple_stack = merge_common_subexpressions(indv.simple_stack);
   }
 }
 
@@ -183,10 +204,18 @@ AcyclicGraph AcyclicGraphManipulator::load(
 
 std::vector<AcyclicGraph> AcyclicGraphManipulator::crossover(
   AcyclicGraph &parent1, AcyclicGraph &parent2) {
-  int cross = (rand() % (ag_size - 1)) + 1;
-  std::vector<AcyclicGraph> temp;
-  AcyclicGraph child1 = AcyclicGraph(parent1);
-  AcyclicGraph child2 = AcyclicGraph(parent2);
+  std::vector<AcyclicGraph> children(2);
+  crossover(parent1, parent2, children[0], children[1]);
+  return children;
+}
+
+void AcyclicGraphManipulator::crossover(AcyclicGraph &parent1,
+                                        AcyclicGraph &parent2,
+                                        AcyclicGraph &child1,
+                                        AcyclicGraph &child2) {
+  int cross = rng.uniform_int(ag_size - 1) + 1;
+  child1 = parent1;
+  child2 = parent2;
   int parent_1_rows = parent1.stack.rows() - cross;
   int parent_2_rows = parent2.stack.rows() - cross;
   child1.stack.block(cross, 0, parent_1_rows, parent1.stack.cols()) =
@@ -196,8 +225,8 @@ std::vector<AcyclicGraph> AcyclicGraphManipulator::crossover(
   int max_gen_age = std::max(parent1.genetic_age, parent2.genetic_age);
   child1.genetic_age = max_gen_age;
   child2.genetic_age = max_gen_age;
-  child1.fitness = std::vector<double>();
-  child2.fitness = std::vector<double>();
+  child1.fitness.clear();
+  child2.fitness.clear();
   child1.fit_set = false;
   child2.fit_set = false;
   simplify_stack(child1);
@@ -293,29 +322,70 @@ std::vector<AcyclicGraph> AcyclicGraphManipulator::crossover(
     }
   }
 
-  temp.push_back(child1);
-  temp.push_back(child2);
-  return temp;
+  if (inherit_equivalent_fitness && opt_rate != 3 && opt_rate != 5) {
+    if (!inherit_fitness(child1, parent1)) {
+      inherit_fitness(child1, parent2);
+    }
+
+    if (!inherit_fitness(child2, parent2)) {
+      inherit_fitness(child2, parent1);
+    }
+  }
+}
+
+void AcyclicGraphManipulator::crossover_batch(
+  std::vector<AcyclicGraph> &population,
+  const std::vector<std::pair<int, int> > &pairs,
+  std::vector<AcyclicGraph> &children) {
+  children.resize(2 * pairs.size());
+
+  for (std::size_t k = 0; k < pairs.size(); ++k) {
+    crossover(population[pairs[k].first], population[pairs[k].second],
+              children[2 * k], children[2 * k + 1]);
+  }
 }
 
 AcyclicGraph AcyclicGraphManipulator::mutation(AcyclicGraph &indv) {
-  std::set<int> util = indv.utilized_commands();
-  int loc = rand() % util.size();
-  std::set<int>::iterator it = util.begin();
+  if (!inherit_equivalent_fitness) {
+    mutate(indv, NULL);
+    return indv;
+  }
+
+  AcyclicGraph parent(indv);
+  mutate(indv, &parent);
+  return indv;
+}
+
+void AcyclicGraphManipulator::mutation(AcyclicGraph &parent,
+                                       AcyclicGraph &child) {
+  child = parent;
+  mutate(child, &parent);
+}
+
+void AcyclicGraphManipulator::mutation_batch(
+  std::vector<AcyclicGraph> &population, const std::vector<int> &indices,
+  std::vector<AcyclicGraph> &children) {
+  children.resize(indices.size());
 
-  for (int i = 0; i < loc; ++i) {
-    ++it;
+  for (std::size_t k = 0; k < indices.size(); ++k) {
+    mutation(population[indices[k]], children[k]);
   }
+}
 
-  int mut_point = *it;
+// indv is a copy of parent, which is only read to hand its fitness down.
+void AcyclicGraphManipulator::mutate(AcyclicGraph &indv,
+                                     AcyclicGraph *parent) {
+  StackAnalysis &analysis = thread_stack_analysis();
+  analyze_stack(indv.stack, analysis);
+  int mut_point = analysis.utilized_row(
+                    rng.uniform_int(analysis.num_utilized));
   int orig_node_type = indv.stack(mut_point, 0);
   int new_param1 = indv.stack(mut_point, 1);
   int new_param2 = indv.stack(mut_point, 2);
-  float r = static_cast <float> (rand()) / static_cast < float> (RAND_MAX);
-  std::vector<int> vec;
+  float r = rng.uniform_float();
 
   if (r < 0.4 && mut_point > nloads) {
-    float ran = static_cast <float> (rand()) / static_cast < float> (RAND_MAX);
+    float ran = rng.uniform_float();
     int temp_node = 0;
     int temp_p1 = 0;
     int temp_p2 = 0;
@@ -323,16 +393,11 @@ AcyclicGraph AcyclicGraphManipulator::mutation(AcyclicGraph &indv) {
 
     while (!new_type_found) {
       if (ran < terminal_prob) {
-        vec = rand_terminal();
-        temp_node = vec[0];
-        temp_p1 = vec[1];
-        temp_p2 = vec[2];
+        draw_terminal(rng, temp_node, temp_p1);
+        temp_p2 = temp_p1;
 
       } else {
-        vec = rand_operator(mut_point);
-        temp_node = vec[0];
-        temp_p1 = vec[1];
-        temp_p2 = vec[2];
+        draw_operator(rng, mut_point, temp_node, temp_p1, temp_p2);
       }
 
       if (temp_node != orig_node_type || orig_node_type <= 1) {
@@ -350,9 +415,7 @@ AcyclicGraph AcyclicGraphManipulator::mutation(AcyclicGraph &indv) {
       new_param2 = new_param1;
 
     } else {
-      vec = rand_operator_params(2, mut_point);
-      new_param1 = vec[0];
-      new_param2 = vec[1];
+      draw_operator_params(rng, mut_point, new_param1, new_param2);
     }
 
     indv.stack(mut_point, 1) = new_param1;
@@ -360,7 +423,7 @@ AcyclicGraph AcyclicGraphManipulator::mutation(AcyclicGraph &indv) {
 
   } else {
     if (orig_node_type > 1) {
-      int ran = rand() % 2;
+      int ran = rng.uniform_int(2);
       int pruned_param = 0;
 
       if (ran == 0) {
@@ -393,7 +456,7 @@ AcyclicGraph AcyclicGraphManipulator::mutation(AcyclicGraph &indv) {
     }
   }
 
-  indv.fitness = std::vector<double>();
+  indv.fitness.clear();
   indv.fit_set = false;
   simplify_stack(indv);
 
@@ -401,7 +464,60 @@ AcyclicGraph AcyclicGraphManipulator::mutation(AcyclicGraph &indv) {
     indv.needs_opt = true;
   }
 
-  return indv;
+  if (inherit_equivalent_fitness && parent != NULL && opt_rate != 4 &&
+      opt_rate != 5) {
+    inherit_fitness(indv, *parent);
+  }
+}
+
+// The simple stacks are compared command by command (the second parameter
+// of a unary command means nothing).  Constants which the child still has to
+// optimize are taken from the parent; the others have to match.
+bool AcyclicGraphManipulator::inherit_fitness(AcyclicGraph &child,
+                                              AcyclicGraph &parent) {
+  if (!parent.fit_set || parent.needs_optimization() ||
+      child.simple_stack.rows() != parent.simple_stack.rows()) {
+    return false;
+  }
+
+  bool reoptimize = child.needs_optimization();
+
+  for (int i = 0; i < child.simple_stack.rows(); ++i) {
+    int node = child.simple_stack(i, 0);
+
+    if (node != parent.simple_stack(i, 0) ||
+        child.simple_stack(i, 1) != parent.simple_stack(i, 1) ||
+        (get_arity(node) == 2 &&
+         child.simple_stack(i, 2) != parent.simple_stack(i, 2))) {
+      return false;
+    }
+
+    int con = child.simple_stack(i, 1);
+
+    if (node == 1 && !reoptimize && child.constants(con) !=
+        parent.constants(con)) {
+      return false;
+    }
+  }
+
+  if (reoptimize) {
+    if (child.constants.size() < parent.constants.size()) {
+      child.constants.conservativeResize(parent.constants.size());
+    }
+
+    for (int i = 0; i < child.simple_stack.rows(); ++i) {
+      if (child.simple_stack(i, 0) == 1) {
+        int con = child.simple_stack(i, 1);
+        child.constants(con) = parent.constants(con);
+      }
+    }
+
+    child.needs_opt = false;
+  }
+
+  child.fitness = parent.fitness;
+  child.fit_set = true;
+  return true;
 }
 
 int AcyclicGraphManipulator::distance(AcyclicGraph &indv1,
@@ -431,7 +547,7 @@ std::vector<int> AcyclicGraphManipulator::rand_operator_params(int arity,
 
   if (stack_location > 1) {
     for (int i = 0; i < arity; ++i) {
-      temp.push_back(rand() % stack_location);
+      temp.push_back(rng.uniform_int(stack_location));
     }
 
   } else {
@@ -444,22 +560,18 @@ std::vector<int> AcyclicGraphManipulator::rand_operator_params(int arity,
 }
 
 int AcyclicGraphManipulator::rand_operator_type() {
-  return node_type_vec[op_vec[rand() % op_vec.size()]];
+  return node_type_vec[op_vec[rng.uniform_int(op_vec.size())]];
 }
 
 std::vector<int> AcyclicGraphManipulator::rand_operator(int stack_location) {
-  std::vector<int> temp;
-  int node_type = rand_operator_type();
-  std::vector<int> temp2 = rand_operator_params(2, stack_location);
-  temp.push_back(node_type);
-  temp.push_back(temp2[0]);
-  temp.push_back(temp2[1]);
+  std::vector<int> temp(3);
+  draw_operator(rng, stack_location, temp[0], temp[1], temp[2]);
   return temp;
 }
 
 int AcyclicGraphManipulator::rand_terminal_param(int terminal) {
   if (terminal == 0) {
-    return (rand() % nvars);
+    return rng.uniform_int(nvars);
 
   } else {
     return -1;
@@ -468,7 +580,7 @@ int AcyclicGraphManipulator::rand_terminal_param(int terminal) {
 
 int AcyclicGraphManipulator::mutate_terminal_param(int terminal) {
   if (terminal == 0) {
-    return (rand() % nvars);
+    return rng.uniform_int(nvars);
 
   } else {
     return -1;
@@ -476,12 +588,59 @@ int AcyclicGraphManipulator::mutate_terminal_param(int terminal) {
 }
 
 std::vector<int> AcyclicGraphManipulator::rand_terminal() {
-  std::vector<int> temp;
-  int node = node_type_vec[term_vec[rand() % term_vec.size()]];
-  int param = rand_terminal_param(node);
-  temp.push_back(node);
-  temp.push_back(param);
-  temp.push_back(param);
+  std::vector<int> temp(3);
+  draw_terminal(rng, temp[0], temp[1]);
+  temp[2] = temp[1];
   return temp;
 }
+
+// The draw_ helpers make the draws of rand_terminal and rand_operator
+// without their vectors, from any generator.
+void AcyclicGraphManipulator::draw_terminal(Xoshiro256 &rng, int &node,
+                                            int &param) const {
+  node = node_type_vec[term_vec[rng.uniform_int(term_vec.size())]];
+  param = node == 0 ? rng.uniform_int(nvars) : -1;
+}
+
+void AcyclicGraphManipulator::draw_operator_params(Xoshiro256 &rng,
+    int stack_location, int &param1, int &param2) const {
+  if (stack_location > 1) {
+    param1 = rng.uniform_int(stack_location);
+    param2 = rng.uniform_int(stack_location);
+
+  } else {
+    param1 = 0;
+    param2 = 0;
+  }
+}
+
+void AcyclicGraphManipulator::draw_operator(Xoshiro256 &rng,
+    int stack_location, int &node, int &param1, int &param2) const {
+  node = node_type_vec[op_vec[rng.uniform_int(op_vec.size())]];
+  draw_operator_params(rng, stack_location, param1, param2);
+}
+
+void AcyclicGraphManipulator::fill_random_stack(Xoshiro256 &rng,
+    Eigen::ArrayX3i &stack) const {
+  stack.resize(ag_size, 3);
+
+  for (int i = 0; i < ag_size; ++i) {
+    float r = rng.uniform_float();
+    int node = 0;
+    int param1 = 0;
+    int param2 = 0;
+
+    if (i < nloads || r < terminal_prob) {
+      draw_terminal(rng, node, param1);
+      param2 = param1;
+
+    } else {
+      draw_operator(rng, i, node, param1, param2);
+    }
+
+    stack(i, 0) = node;
+    stack(i, 1) = param1;
+    stack(i, 2) = param2;
+  }
+}
 } // namespace bingo
\ No newline at end of file
@@ -0,0 +1,299 @@
+/*!
+ * \file island.cpp
+ *
+ * This file contains the island model: islands evolved by deterministic
+ * crowding and an archipelago running them concurrently with migration.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+#include "BingoCpp/island.h"
+
+namespace bingo {
+namespace {
+
+// fitness used for comparisons; unevaluated and NaN fitness rank last
+double fitness_of(const AcyclicGraph &indv) {
+  if (!indv.fit_set || indv.fitness.empty() || std::isnan(indv.fitness[0])) {
+    return std::numeric_limits<double>::infinity();
+  }
+
+  return indv.fitness[0];
+}
+
+// replaces parent by child if child is at least as fit
+void crowd(AcyclicGraph &parent, AcyclicGraph &child) {
+  if (fitness_of(child) <= fitness_of(parent)) {
+    std::swap(parent, child);
+  }
+}
+} // namespace
+
+Island::Island(const std::vector<AcyclicGraph> &population,
+               const AcyclicGraphManipulator &manipulator,
+               FitnessMetric &fitness_metric, TrainingData &training_data)
+  : population(population), manipulator(manipulator),
+    fitness_metric(&fitness_metric), training_data(&training_data),
+    crossover_probability(0.7), mutation_probability(0.01), generation(0),
+    fitness_evaluations(0) {}
+
+void Island::evaluate(ThreadPool &pool) {
+  evaluate(population, pool);
+}
+
+// Evaluates the individuals without fitness as one batch, swapping them
+// out of and back into place.
+void Island::evaluate(std::vector<AcyclicGraph> &individuals,
+                      ThreadPool &pool) {
+  unset_.clear();
+
+  for (std::size_t i = 0; i < individuals.size(); ++i) {
+    if (!individuals[i].fit_set) {
+      unset_.push_back(i);
+    }
+  }
+
+  if (unset_.empty()) {
+    return;
+  }
+
+  batch_.resize(unset_.size());
+
+  for (std::size_t k = 0; k < unset_.size(); ++k) {
+    std::swap(batch_[k], individuals[unset_[k]]);
+  }
+
+  initial_constants_.resize(batch_.size());
+
+  for (std::size_t k = 0; k < batch_.size(); ++k) {
+    if (batch_[k].needs_optimization()) {
+      initial_constants_[k].resize(batch_[k].count_constants());
+
+      for (int j = 0; j < initial_constants_[k].size(); ++j) {
+        initial_constants_[k](j) = 2.0 * manipulator.rng.uniform_float() - 1.0;
+      }
+    }
+  }
+
+  std::vector<double> fitness = fitness_metric->evaluate_population_fitness(
+                                  batch_, *training_data, initial_constants_,
+                                  pool);
+
+  for (std::size_t k = 0; k < unset_.size(); ++k) {
+    batch_[k].fitness.assign(1, fitness[k]);
+    batch_[k].fit_set = true;
+    std::swap(batch_[k], individuals[unset_[k]]);
+  }
+
+  fitness_evaluations += unset_.size();
+}
+
+void Island::step(ThreadPool &pool) {
+  evaluate(population, pool);
+  ++generation;
+  int half = population.size() / 2;
+  children_.resize(2 * half);
+
+  for (int i = 0; i < half; ++i) {
+    AcyclicGraph &child1 = children_[2 * i];
+    AcyclicGraph &child2 = children_[2 * i + 1];
+
+    if (manipulator.rng.uniform_float() < crossover_probability) {
+      manipulator.crossover(population[i], population[i + half], child1,
+                            child2);
+
+    } else {
+      child1 = population[i];
+      child2 = population[i + half];
+    }
+
+    for (int c = 2 * i; c < 2 * i + 2; ++c) {
+      if (manipulator.rng.uniform_float() < mutation_probability) {
+        manipulator.mutation(children_[c], mutant_);
+        std::swap(children_[c], mutant_);
+      }
+    }
+  }
+
+  evaluate(children_, pool);
+
+  for (int i = 0; i < half; ++i) {
+    AcyclicGraph &parent1 = population[i];
+    AcyclicGraph &parent2 = population[i + half];
+    AcyclicGraph &child1 = children_[2 * i];
+    AcyclicGraph &child2 = children_[2 * i + 1];
+    int straight = manipulator.distance(parent1, child1) +
+                   manipulator.distance(parent2, child2);
+    int crossed = manipulator.distance(parent1, child2) +
+                  manipulator.distance(parent2, child1);
+
+    if (straight <= crossed) {
+      crowd(parent1, child1);
+      crowd(parent2, child2);
+
+    } else {
+      crowd(parent1, child2);
+      crowd(parent2, child1);
+    }
+  }
+}
+
+int Island::best_individual() const {
+  int best = -1;
+
+  for (std::size_t i = 0; i < population.size(); ++i) {
+    if (fitness_of(population[i]) <
+        std::numeric_limits<double>::infinity() &&
+        (best < 0 || fitness_of(population[i]) <
+         fitness_of(population[best]))) {
+      best = i;
+    }
+  }
+
+  return best;
+}
+
+void Island::sort_by_fitness(bool fittest_first) {
+  order_.resize(population.size());
+
+  for (std::size_t i = 0; i < order_.size(); ++i) {
+    order_[i] = i;
+  }
+
+  std::stable_sort(order_.begin(), order_.end(), [&](int a, int b) {
+    return fittest_first ?
+           fitness_of(population[a]) < fitness_of(population[b]) :
+           fitness_of(population[a]) > fitness_of(population[b]);
+  });
+}
+
+void Island::select_migrants(int num_migrants, MigrantSelection selection,
+                             std::vector<AcyclicGraph> &migrants) {
+  num_migrants = std::min<int>(num_migrants, population.size());
+  migrants.resize(num_migrants);
+
+  if (selection == BEST_MIGRANTS) {
+    sort_by_fitness(true);
+  }
+
+  for (int m = 0; m < num_migrants; ++m) {
+    int i = selection == BEST_MIGRANTS ? order_[m] :
+            manipulator.rng.uniform_int(population.size());
+    migrants[m] = population[i];
+  }
+}
+
+void Island::receive_migrants(const std::vector<AcyclicGraph> &migrants) {
+  sort_by_fitness(false);
+  std::size_t num_migrants = std::min(migrants.size(), population.size());
+
+  for (std::size_t m = 0; m < num_migrants; ++m) {
+    population[order_[m]] = migrants[m];
+  }
+}
+
+Archipelago::Archipelago(const std::vector<Island> &islands,
+                         MigrationTopology topology, int migration_interval,
+                         int num_migrants, uint64_t seed)
+  : islands(islands), topology(topology), migrant_selection(BEST_MIGRANTS),
+    migration_interval(migration_interval), num_migrants(num_migrants),
+    rng(seed), generations_since_migration_(0), outboxes_(islands.size()),
+    sources_(islands.size()) {
+  Xoshiro256 stream = rng;
+
+  for (std::size_t k = 0; k < this->islands.size(); ++k) {
+    stream.jump();
+    this->islands[k].manipulator.rng = stream;
+  }
+}
+
+void Archipelago::evolve(int generations, ThreadPool &pool) {
+  while (generations > 0) {
+    int steps = generations;
+
+    if (migration_interval > 0) {
+      steps = std::min(steps,
+                       migration_interval - generations_since_migration_);
+    }
+
+    pool.parallel_for(islands.size(), [&](int k) {
+      for (int s = 0; s < steps; ++s) {
+        islands[k].step(pool);
+      }
+    });
+    generations -= steps;
+    generations_since_migration_ += steps;
+
+    if (migration_interval > 0 &&
+        generations_since_migration_ >= migration_interval) {
+      migrate(pool);
+      generations_since_migration_ = 0;
+    }
+  }
+}
+
+void Archipelago::migrate(ThreadPool &pool) {
+  int num_islands = islands.size();
+
+  if (num_islands < 2) {
+    return;
+  }
+
+  pool.parallel_for(num_islands, [&](int k) {
+    islands[k].select_migrants(num_migrants, migrant_selection,
+                               outboxes_[k]);
+  });
+
+  for (int k = 0; k < num_islands; ++k) {
+    sources_[k].clear();
+
+    if (topology == RING_MIGRATION) {
+      sources_[k].push_back((k + num_islands - 1) % num_islands);
+
+    } else if (topology == RANDOM_MIGRATION) {
+      int source = rng.uniform_int(num_islands - 1);
+      sources_[k].push_back(source < k ? source : source + 1);
+
+    } else {
+      for (int j = 0; j < num_islands; ++j) {
+        if (j != k) {
+          sources_[k].push_back(j);
+        }
+      }
+    }
+  }
+
+  pool.parallel_for(num_islands, [&](int k) {
+    for (std::size_t s = 0; s < sources_[k].size(); ++s) {
+      islands[k].receive_migrants(outboxes_[sources_[k][s]]);
+    }
+  });
+}
+
+long Archipelago::fitness_evaluations() const {
+  long total = 0;
+
+  for (std::size_t k = 0; k < islands.size(); ++k) {
+    total += islands[k].fitness_evaluations;
+  }
+
+  return total;
+}
+
+AcyclicGraph Archipelago::best_individual() const {
+  AcyclicGraph best;
+
+  for (std::size_t k = 0; k < islands.size(); ++k) {
+    int i = islands[k].best_individual();
+
+    if (i >= 0 && fitness_of(islands[k].population[i]) < fitness_of(best)) {
+      best = islands[k].population[i];
+    }
+  }
+
+  return best;
+}
+} // namespace bingo
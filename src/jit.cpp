@@ -0,0 +1,509 @@
+/*!
+ * \file jit.cpp
+ *
+ * This file contains the native code backend: a stack is turned into C++
+ * source, compiled to a shared object by the system compiler and loaded with
+ * dlopen.  Shared objects are cached on disk by the structural hash of the
+ * stack.
+ */
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#include "BingoCpp/acyclic_graph.h"
+#include "BingoCpp/backend.h"
+#include "BingoCpp/jit.h"
+
+namespace bingo {
+namespace {
+
+const int NODE_IDX = 0;
+const int OP_1 = 1;
+const int OP_2 = 2;
+
+const int X_LOAD = 0;
+const int C_LOAD = 1;
+const int ADDITION = 2;
+const int SUBTRACTION = 3;
+const int MULTIPLICATION = 4;
+const int DIVISION = 5;
+const int SIN = 6;
+const int COS = 7;
+const int EXP = 8;
+const int LOG = 9;
+const int POWER = 10;
+const int ABSOLUTE = 11;
+const int SQRT = 12;
+
+// Changing the generated code must change this, so stale cache entries are
+// not loaded.
+const char* const GENERATOR_VERSION = "bingo-jit-1";
+
+const char* const FORWARD_SYMBOL = "bingo_forward";
+const char* const REVERSE_SYMBOL = "bingo_reverse";
+const char* const STACK_SYMBOL = "bingo_stack";
+const char* const STACK_SIZE_SYMBOL = "bingo_stack_size";
+
+std::string environment_or(const char* name, const char* fallback) {
+  const char* value = std::getenv(name);
+  return value != NULL && *value != '\0' ? value : fallback;
+}
+
+// $XDG_CACHE_HOME/bingo_jit, ~/.cache/bingo_jit, or a directory of the
+// user's own in /tmp
+std::string default_cache_directory() {
+  const char* cache_home = std::getenv("XDG_CACHE_HOME");
+  if (cache_home != NULL && cache_home[0] == '/') {
+    return std::string(cache_home) + "/bingo_jit";
+  }
+  const char* home = std::getenv("HOME");
+  if (home != NULL && home[0] == '/') {
+    return std::string(home) + "/.cache/bingo_jit";
+  }
+  std::stringstream directory;
+  directory << "/tmp/bingo_jit_" << geteuid();
+  return directory.str();
+}
+
+// Whether path is owned by the current user and writable by no one else, so
+// that no other user can plant a shared object for us to load.
+bool owned_privately(const std::string& path, mode_t type) {
+  struct stat status;
+  return lstat(path.c_str(), &status) == 0 &&
+         (status.st_mode & S_IFMT) == type &&
+         status.st_uid == geteuid() &&
+         (status.st_mode & (S_IWGRP | S_IWOTH)) == 0;
+}
+
+// Creates the cache directory, and its parent if needed, readable by the
+// current user only.  An existing directory is used only if it is private.
+bool make_cache_directory(const std::string& directory) {
+  std::string::size_type slash = directory.find_last_of('/');
+  if (slash != std::string::npos && slash > 0) {
+    mkdir(directory.substr(0, slash).c_str(), 0700);
+  }
+  if (mkdir(directory.c_str(), 0700) != 0 && errno != EEXIST) {
+    return false;
+  }
+  return owned_privately(directory, S_IFDIR);
+}
+
+// Splits a command line at whitespace; no shell quoting is interpreted.
+void split_arguments(const std::string& line,
+                     std::vector<std::string>& arguments) {
+  std::stringstream words(line);
+  std::string word;
+  while (words >> word) {
+    arguments.push_back(word);
+  }
+}
+
+// Runs a command without a shell, discarding its output.
+bool run_command(const std::vector<std::string>& arguments) {
+  if (arguments.empty()) {
+    return false;
+  }
+  std::vector<char*> argv;
+  for (std::size_t i = 0; i < arguments.size(); ++i) {
+    argv.push_back(const_cast<char*>(arguments[i].c_str()));
+  }
+  argv.push_back(NULL);
+
+  pid_t pid = fork();
+  if (pid < 0) {
+    return false;
+  }
+  if (pid == 0) {
+    int null_device = open("/dev/null", O_WRONLY);
+    if (null_device >= 0) {
+      dup2(null_device, STDOUT_FILENO);
+      dup2(null_device, STDERR_FILENO);
+    }
+    execvp(argv[0], argv.data());
+    _exit(127);
+  }
+
+  int status;
+  while (waitpid(pid, &status, 0) < 0) {
+    if (errno != EINTR) {
+      return false;
+    }
+  }
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+uint64_t fnv1a(uint64_t hash, uint64_t value) {
+  for (int byte = 0; byte < 8; ++byte) {
+    hash ^= (value >> (8 * byte)) & 0xff;
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+std::string value(int row) {
+  std::stringstream name;
+  name << "v" << row;
+  return name.str();
+}
+
+std::string adjoint(int row) {
+  std::stringstream name;
+  name << "a" << row;
+  return name.str();
+}
+
+void write_forward_command(const Eigen::ArrayX3i& stack, int row,
+                           std::ostream& out) {
+  int param1 = stack(row, OP_1);
+  int param2 = stack(row, OP_2);
+  std::string v1 = value(param1);
+  std::string v2 = value(param2);
+  out << "    const double " << value(row) << " = ";
+
+  switch (stack(row, NODE_IDX)) {
+    case X_LOAD:
+      out << "x[" << param1 << " * ld + i]";
+      break;
+    case C_LOAD:
+      out << "c[" << param1 << "]";
+      break;
+    case ADDITION:
+      out << v1 << " + " << v2;
+      break;
+    case SUBTRACTION:
+      out << v1 << " - " << v2;
+      break;
+    case MULTIPLICATION:
+      out << v1 << " * " << v2;
+      break;
+    case DIVISION:
+      out << v1 << " / " << v2;
+      break;
+    case SIN:
+      out << "std::sin(" << v1 << ")";
+      break;
+    case COS:
+      out << "std::cos(" << v1 << ")";
+      break;
+    case EXP:
+      out << "std::exp(" << v1 << ")";
+      break;
+    case LOG:
+      out << "std::log(std::abs(" << v1 << "))";
+      break;
+    case POWER:
+      out << "std::pow(std::abs(" << v1 << "), " << v2 << ")";
+      break;
+    case ABSOLUTE:
+      out << "std::abs(" << v1 << ")";
+      break;
+    case SQRT:
+      out << "std::sqrt(std::abs(" << v1 << "))";
+      break;
+  }
+  out << ";\n";
+}
+
+// Mirrors the reverse evaluation of backend_nodes.cpp.
+void write_reverse_command(const Eigen::ArrayX3i& stack, int row,
+                           std::ostream& out) {
+  int param1 = stack(row, OP_1);
+  int param2 = stack(row, OP_2);
+  std::string g = adjoint(row);
+  std::string a1 = adjoint(param1);
+  std::string a2 = adjoint(param2);
+  std::string f = value(row);
+  std::string f1 = value(param1);
+  std::string f2 = value(param2);
+
+  switch (stack(row, NODE_IDX)) {
+    case X_LOAD:
+      out << "    if (!wrt_c) d[" << param1 << " * n + i] += " << g << ";\n";
+      break;
+    case C_LOAD:
+      out << "    if (wrt_c) d[" << param1 << " * n + i] += " << g << ";\n";
+      break;
+    case ADDITION:
+      out << "    " << a1 << " += " << g << ";\n";
+      out << "    " << a2 << " += " << g << ";\n";
+      break;
+    case SUBTRACTION:
+      out << "    " << a1 << " += " << g << ";\n";
+      out << "    " << a2 << " -= " << g << ";\n";
+      break;
+    case MULTIPLICATION:
+      out << "    " << a1 << " += " << g << " * " << f2 << ";\n";
+      out << "    " << a2 << " += " << g << " * " << f1 << ";\n";
+      break;
+    case DIVISION:
+      out << "    " << a1 << " += " << g << " / " << f2 << ";\n";
+      out << "    " << a2 << " -= " << g << " * " << f << " / " << f2
+          << ";\n";
+      break;
+    case SIN:
+      out << "    " << a1 << " += " << g << " * std::cos(" << f1 << ");\n";
+      break;
+    case COS:
+      out << "    " << a1 << " -= " << g << " * std::sin(" << f1 << ");\n";
+      break;
+    case EXP:
+      out << "    " << a1 << " += " << g << " * " << f << ";\n";
+      break;
+    case LOG:
+      out << "    " << a1 << " += " << g << " / " << f1 << ";\n";
+      break;
+    case POWER:
+      out << "    " << a1 << " += " << g << " * " << f << " * " << f2
+          << " / " << f1 << ";\n";
+      out << "    " << a2 << " += " << g << " * " << f
+          << " * std::log(std::abs(" << f1 << "));\n";
+      break;
+    case ABSOLUTE:
+      out << "    " << a1 << " += " << g << " * sign(" << f1 << ");\n";
+      break;
+    case SQRT:
+      out << "    " << a1 << " += 0.5 * " << g << " / " << f << " * sign("
+          << f1 << ");\n";
+      break;
+  }
+}
+
+std::string hex(uint64_t hash) {
+  char digits[17];
+  std::snprintf(digits, sizeof(digits), "%016llx",
+                static_cast<unsigned long long>(hash));
+  return digits;
+}
+
+bool file_exists(const std::string& path) {
+  return access(path.c_str(), R_OK) == 0;
+}
+
+// Loads a cached shared object for stack, checking that it was built from
+// the commands of simple_stack and not from another stack with the same hash.
+// As in structural_hash, the unused operand of a command is ignored.
+std::shared_ptr<const JitKernel> load_kernel(
+    const std::string& path, const Eigen::ArrayX3i& stack,
+    const Eigen::ArrayX3i& simple_stack) {
+  // dlopen runs the constructors of the object, so check who wrote it first
+  if (!owned_privately(path, S_IFREG)) {
+    return std::shared_ptr<const JitKernel>();
+  }
+  void* handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+  if (handle == NULL) {
+    return std::shared_ptr<const JitKernel>();
+  }
+
+  const int* stack_size =
+      static_cast<const int*>(dlsym(handle, STACK_SIZE_SYMBOL));
+  const int* commands = static_cast<const int*>(dlsym(handle, STACK_SYMBOL));
+  void* forward = dlsym(handle, FORWARD_SYMBOL);
+  void* reverse = dlsym(handle, REVERSE_SYMBOL);
+  bool matches = stack_size != NULL && commands != NULL && forward != NULL &&
+                 reverse != NULL && *stack_size == simple_stack.rows();
+  for (int row = 0; matches && row < simple_stack.rows(); ++row) {
+    int node = simple_stack(row, NODE_IDX);
+    matches = commands[3 * row + NODE_IDX] == node &&
+              commands[3 * row + OP_1] == simple_stack(row, OP_1) &&
+              (!AcyclicGraph::has_arity_two(node) ||
+               commands[3 * row + OP_2] == simple_stack(row, OP_2));
+  }
+
+  if (!matches) {
+    dlclose(handle);
+    return std::shared_ptr<const JitKernel>();
+  }
+
+  return std::make_shared<JitKernel>(
+      stack, handle,
+      reinterpret_cast<JitKernel::forward_kernel>(forward),
+      reinterpret_cast<JitKernel::reverse_kernel>(reverse));
+}
+
+// Compiles source into path.  The object is written under a unique name and
+// renamed, so processes sharing the cache never load a partial file.
+bool build_kernel(const std::string& source, const std::string& path,
+                  const JitOptions& options) {
+  static std::atomic<long> build_count(0);
+  std::stringstream unique;
+  unique << path << "." << getpid() << "." << build_count++;
+  std::string source_path = unique.str() + ".cpp";
+  std::string object_path = unique.str() + ".so";
+
+  {
+    std::ofstream file(source_path.c_str());
+    file << source;
+    if (!file) {
+      return false;
+    }
+  }
+
+  std::vector<std::string> arguments;
+  split_arguments(options.compiler, arguments);
+  split_arguments(options.flags, arguments);
+  arguments.push_back("-shared");
+  arguments.push_back("-fPIC");
+  arguments.push_back("-o");
+  arguments.push_back(object_path);
+  arguments.push_back(source_path);
+  bool built = run_command(arguments) &&
+               std::rename(object_path.c_str(), path.c_str()) == 0;
+  std::remove(source_path.c_str());
+  if (!built) {
+    std::remove(object_path.c_str());
+  }
+  return built;
+}
+} // namespace
+
+JitOptions::JitOptions()
+  : compiler(environment_or("BINGO_JIT_CXX", "c++")),
+    flags(environment_or("BINGO_JIT_FLAGS", "-O3 -std=c++11")),
+    cache_directory(environment_or("BINGO_JIT_CACHE",
+                                   default_cache_directory().c_str())) {}
+
+JitKernel::JitKernel(const Eigen::ArrayX3i& stack, void* handle,
+                     forward_kernel forward, reverse_kernel reverse)
+  : stack_(stack), handle_(handle), forward_(forward), reverse_(reverse) {}
+
+JitKernel::~JitKernel() {
+  dlclose(handle_);
+}
+
+bool JitKernel::is_compiled_from(const Eigen::ArrayX3i& stack) const {
+  return stack_.rows() == stack.rows() && (stack_ == stack).all();
+}
+
+void JitKernel::forward(const Eigen::ArrayXXd& x,
+                        const Eigen::VectorXd& constants,
+                        Eigen::ArrayXXd& result) const {
+  result.resize(x.rows(), 1);
+  forward_(x.data(), x.rows(), x.outerStride(), constants.data(),
+           result.data());
+}
+
+void JitKernel::reverse(const Eigen::ArrayXXd& x,
+                        const Eigen::VectorXd& constants,
+                        bool param_x_or_c,
+                        Eigen::ArrayXXd& result,
+                        Eigen::ArrayXXd& derivative) const {
+  result.resize(x.rows(), 1);
+  derivative.setZero(x.rows(), param_x_or_c ? x.cols() : constants.size());
+  reverse_(x.data(), x.rows(), x.outerStride(), constants.data(),
+           param_x_or_c ? 0 : 1, result.data(), derivative.data());
+}
+
+uint64_t structural_hash(const Eigen::ArrayX3i& stack) {
+  Eigen::ArrayX3i simple_stack = simplify_stack(stack);
+  uint64_t hash = 14695981039346656037ULL;
+  for (const char* c = GENERATOR_VERSION; *c != '\0'; ++c) {
+    hash = fnv1a(hash, *c);
+  }
+
+  for (int row = 0; row < simple_stack.rows(); ++row) {
+    int node = simple_stack(row, NODE_IDX);
+    hash = fnv1a(hash, node);
+    hash = fnv1a(hash, simple_stack(row, OP_1));
+    if (AcyclicGraph::has_arity_two(node)) {
+      hash = fnv1a(hash, simple_stack(row, OP_2));
+    }
+  }
+  return hash;
+}
+
+std::string generate_kernel_source(const Eigen::ArrayX3i& stack) {
+  Eigen::ArrayX3i simple_stack = simplify_stack(stack);
+  int stack_size = simple_stack.rows();
+  std::stringstream out;
+  out << "// generated by bingo from a stack of " << stack_size
+      << " commands\n"
+      << "#include <cmath>\n\n"
+      << "static inline double sign(double v) {\n"
+      << "  return (v > 0.0) - (v < 0.0);\n"
+      << "}\n\n";
+
+  out << "extern \"C\" const int " << STACK_SIZE_SYMBOL << " = "
+      << stack_size << ";\n"
+      << "extern \"C\" const int " << STACK_SYMBOL << "[] = {";
+  for (int row = 0; row < stack_size; ++row) {
+    out << (row == 0 ? "" : ",") << "\n  " << simple_stack(row, NODE_IDX)
+        << ", " << simple_stack(row, OP_1) << ", "
+        << simple_stack(row, OP_2);
+  }
+  out << "\n};\n\n";
+
+  out << "extern \"C\" void " << FORWARD_SYMBOL
+      << "(const double* x, long n, long ld, const double* c, double* y) {\n"
+      << "  for (long i = 0; i < n; ++i) {\n";
+  for (int row = 0; row < stack_size; ++row) {
+    write_forward_command(simple_stack, row, out);
+  }
+  out << "    y[i] = " << value(stack_size - 1) << ";\n"
+      << "  }\n"
+      << "}\n\n";
+
+  out << "extern \"C\" void " << REVERSE_SYMBOL
+      << "(const double* x, long n, long ld, const double* c, int wrt_c,\n"
+      << "    double* y, double* d) {\n"
+      << "  for (long i = 0; i < n; ++i) {\n";
+  for (int row = 0; row < stack_size; ++row) {
+    write_forward_command(simple_stack, row, out);
+  }
+  out << "    y[i] = " << value(stack_size - 1) << ";\n";
+  for (int row = 0; row < stack_size; ++row) {
+    out << "    double " << adjoint(row) << " = "
+        << (row == stack_size - 1 ? "1.0" : "0.0") << ";\n";
+  }
+  for (int row = stack_size - 1; row >= 0; --row) {
+    write_reverse_command(simple_stack, row, out);
+  }
+  out << "  }\n"
+      << "}\n";
+  return out.str();
+}
+
+std::shared_ptr<const JitKernel> jit_compile(const Eigen::ArrayX3i& stack,
+                                             const JitOptions& options) {
+  Eigen::ArrayX3i simple_stack = simplify_stack(stack);
+  if (!make_cache_directory(options.cache_directory)) {
+    return std::shared_ptr<const JitKernel>();
+  }
+
+  std::string path = options.cache_directory + "/bingo_" +
+                     hex(structural_hash(simple_stack)) + ".so";
+  if (!file_exists(path) &&
+      !build_kernel(generate_kernel_source(simple_stack), path, options)) {
+    return std::shared_ptr<const JitKernel>();
+  }
+  return load_kernel(path, stack, simple_stack);
+}
+
+Eigen::ArrayXXd evaluate(const JitKernel& kernel,
+                         const Eigen::ArrayXXd& x,
+                         const Eigen::VectorXd& constants) {
+  Eigen::ArrayXXd result;
+  kernel.forward(x, constants, result);
+  return result;
+}
+
+std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd> evaluate_with_derivative(
+    const JitKernel& kernel,
+    const Eigen::ArrayXXd& x,
+    const Eigen::VectorXd& constants,
+    const bool param_x_or_c) {
+  std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd> result;
+  kernel.reverse(x, constants, param_x_or_c, result.first, result.second);
+  return result;
+}
+} // namespace bingo
@@ -0,0 +1,284 @@
+/*!
+ * \file memo.cpp
+ *
+ * This file contains the memo table of evaluated subgraphs.  Subgraphs are
+ * keyed by a hash built bottom-up over the stack, so a subgraph has the same
+ * key wherever it appears in whichever individual.
+ */
+
+#include <cstring>
+#include <utility>
+
+#include "BingoCpp/acyclic_graph.h"
+#include "BingoCpp/backend_nodes.h"
+#include "BingoCpp/memo.h"
+
+namespace bingo {
+namespace {
+
+const int NODE_IDX = 0;
+const int OP_1 = 1;
+const int OP_2 = 2;
+
+const int X_LOAD = 0;
+const int C_LOAD = 1;
+const int ADDITION = 2;
+const int MULTIPLICATION = 4;
+
+// splitmix64 finalizer
+uint64_t mix(uint64_t value) {
+  value ^= value >> 30;
+  value *= 0xbf58476d1ce4e5b9ULL;
+  value ^= value >> 27;
+  value *= 0x94d049bb133111ebULL;
+  value ^= value >> 31;
+  return value;
+}
+
+uint64_t combine(uint64_t hash, uint64_t value) {
+  return mix(hash ^ (value + 0x9e3779b97f4a7c15ULL + (hash << 6) +
+                     (hash >> 2)));
+}
+
+uint64_t bits(double value) {
+  uint64_t result;
+  std::memcpy(&result, &value, sizeof(result));
+  return result;
+}
+
+std::size_t bytes(const Eigen::ArrayXXd& value) {
+  return sizeof(Eigen::ArrayXXd) + value.size() * sizeof(double);
+}
+
+// Per-thread buffers of evaluate, so that evaluations do not allocate.
+struct MemoScratch {
+  std::vector<uint64_t> hashes;
+  std::vector<bool> needed;
+  std::vector<std::shared_ptr<const Eigen::ArrayXXd> > found;
+};
+
+MemoScratch& thread_scratch() {
+  static thread_local MemoScratch scratch;
+  return scratch;
+}
+
+EvaluationWorkspace& thread_workspace() {
+  static thread_local EvaluationWorkspace workspace;
+  return workspace;
+}
+
+void evaluate_with_memo(const Eigen::ArrayX3i& stack,
+                        const Eigen::ArrayXXd& x,
+                        const Eigen::VectorXd& constants,
+                        uint64_t samples_hash,
+                        SubexpressionMemo& memo,
+                        EvaluationWorkspace& workspace) {
+  int stack_depth = stack.rows();
+  MemoScratch& scratch = thread_scratch();
+  workspace.reserve(stack_depth);
+  get_utilized_commands(stack, workspace.mask);
+  subgraph_hashes(stack, constants, workspace.mask, samples_hash,
+                  scratch.hashes);
+
+  // look up from the result down; below a hit nothing is needed
+  std::vector<bool>& needed = scratch.needed;
+  needed.assign(stack_depth, false);
+  needed.back() = true;
+  scratch.found.resize(stack_depth);
+  for (int row = stack_depth - 1; row >= 0; --row) {
+    scratch.found[row].reset();
+    int node = stack(row, NODE_IDX);
+    if (!needed[row] || AcyclicGraph::is_terminal(node)) {
+      continue;
+    }
+    scratch.found[row] = memo.find(scratch.hashes[row]);
+    if (!scratch.found[row]) {
+      needed[stack(row, OP_1)] = true;
+      if (AcyclicGraph::has_arity_two(node)) {
+        needed[stack(row, OP_2)] = true;
+      }
+    }
+  }
+
+  for (int row = 0; row < stack_depth; ++row) {
+    if (!needed[row]) {
+      continue;
+    }
+    if (scratch.found[row]) {
+      workspace.forward_eval[row] = *scratch.found[row];
+      scratch.found[row].reset();
+      continue;
+    }
+    int node = stack(row, NODE_IDX);
+    forward_eval_function(node, stack(row, OP_1), stack(row, OP_2), x,
+                          constants, workspace.forward_eval, row);
+    if (!AcyclicGraph::is_terminal(node)) {
+      memo.insert(scratch.hashes[row], workspace.forward_eval[row]);
+    }
+  }
+  workspace.result_index = stack_depth - 1;
+}
+} // namespace
+
+SubexpressionMemo::SubexpressionMemo(std::size_t capacity_bytes) {
+  statistics_.capacity_bytes = capacity_bytes;
+}
+
+std::shared_ptr<const Eigen::ArrayXXd> SubexpressionMemo::find(uint64_t key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::unordered_map<uint64_t, std::list<Entry>::iterator>::iterator found =
+    index_.find(key);
+  if (found == index_.end()) {
+    ++statistics_.misses;
+    return std::shared_ptr<const Eigen::ArrayXXd>();
+  }
+  ++statistics_.hits;
+  entries_.splice(entries_.begin(), entries_, found->second);
+  return found->second->second;
+}
+
+void SubexpressionMemo::insert(uint64_t key, const Eigen::ArrayXXd& value) {
+  if (bytes(value) > statistics_.capacity_bytes) {
+    return;
+  }
+  std::shared_ptr<const Eigen::ArrayXXd> copy =
+    std::make_shared<const Eigen::ArrayXXd>(value);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::unordered_map<uint64_t, std::list<Entry>::iterator>::iterator found =
+    index_.find(key);
+  if (found != index_.end()) {
+    // another thread computed the same subgraph concurrently
+    entries_.splice(entries_.begin(), entries_, found->second);
+    return;
+  }
+  entries_.push_front(Entry(key, copy));
+  index_[key] = entries_.begin();
+  ++statistics_.entries;
+  statistics_.bytes += bytes(value);
+  evict();
+}
+
+void SubexpressionMemo::evict() {
+  while (statistics_.bytes > statistics_.capacity_bytes) {
+    const Entry& oldest = entries_.back();
+    statistics_.bytes -= bytes(*oldest.second);
+    index_.erase(oldest.first);
+    entries_.pop_back();
+    --statistics_.entries;
+    ++statistics_.evictions;
+  }
+}
+
+void SubexpressionMemo::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.clear();
+  index_.clear();
+  statistics_.entries = 0;
+  statistics_.bytes = 0;
+}
+
+MemoStatistics SubexpressionMemo::statistics() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return statistics_;
+}
+
+void SubexpressionMemo::reset_statistics() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  statistics_.hits = 0;
+  statistics_.misses = 0;
+  statistics_.evictions = 0;
+}
+
+uint64_t hash_samples(const Eigen::ArrayXXd& x) {
+  uint64_t hash = combine(mix(x.rows()), x.cols());
+  for (int i = 0; i < x.size(); ++i) {
+    hash = combine(hash, bits(x(i)));
+  }
+  return hash;
+}
+
+void subgraph_hashes(const Eigen::ArrayX3i& stack,
+                     const Eigen::VectorXd& constants,
+                     const std::vector<bool>& mask,
+                     uint64_t samples_hash,
+                     std::vector<uint64_t>& hashes) {
+  hashes.resize(stack.rows());
+  for (int row = 0; row < stack.rows(); ++row) {
+    if (!mask[row]) {
+      continue;
+    }
+    int node = stack(row, NODE_IDX);
+    int param1 = stack(row, OP_1);
+    int param2 = stack(row, OP_2);
+    uint64_t hash = combine(samples_hash, node);
+    if (node == X_LOAD) {
+      hash = combine(hash, param1);
+    } else if (node == C_LOAD) {
+      hash = param1 >= 0 && param1 < constants.size() ?
+             combine(hash, bits(constants[param1])) :
+             combine(combine(hash, param1), row);
+    } else if (AcyclicGraph::has_arity_two(node)) {
+      uint64_t first = hashes[param1];
+      uint64_t second = hashes[param2];
+      if ((node == ADDITION || node == MULTIPLICATION) && second < first) {
+        std::swap(first, second);
+      }
+      hash = combine(combine(hash, first), second);
+    } else {
+      hash = combine(hash, hashes[param1]);
+    }
+    hashes[row] = hash;
+  }
+}
+
+void evaluate(const Eigen::ArrayX3i& stack,
+              const Eigen::ArrayXXd& x,
+              const Eigen::VectorXd& constants,
+              SubexpressionMemo& memo,
+              EvaluationWorkspace& workspace) {
+  evaluate_with_memo(stack, x, constants, hash_samples(x), memo, workspace);
+}
+
+Eigen::ArrayXXd evaluate(const Eigen::ArrayX3i& stack,
+                         const Eigen::ArrayXXd& x,
+                         const Eigen::VectorXd& constants,
+                         SubexpressionMemo& memo) {
+  EvaluationWorkspace& workspace = thread_workspace();
+  evaluate(stack, x, constants, memo, workspace);
+  return workspace.result();
+}
+
+Eigen::ArrayXXd evaluate_population(
+    const std::vector<Eigen::ArrayX3i>& stacks,
+    const Eigen::ArrayXXd& x,
+    const std::vector<Eigen::VectorXd>& constants,
+    SubexpressionMemo& memo) {
+  uint64_t samples_hash = hash_samples(x);
+  EvaluationWorkspace& workspace = thread_workspace();
+  Eigen::ArrayXXd values(x.rows(), stacks.size());
+  for (std::size_t i = 0; i < stacks.size(); ++i) {
+    evaluate_with_memo(stacks[i], x, constants[i], samples_hash, memo,
+                       workspace);
+    values.col(i) = workspace.result();
+  }
+  return values;
+}
+
+Eigen::ArrayXXd evaluate_population(
+    const std::vector<Eigen::ArrayX3i>& stacks,
+    const Eigen::ArrayXXd& x,
+    const std::vector<Eigen::VectorXd>& constants,
+    SubexpressionMemo& memo,
+    ThreadPool& pool) {
+  uint64_t samples_hash = hash_samples(x);
+  Eigen::ArrayXXd values(x.rows(), stacks.size());
+  pool.parallel_for(stacks.size(), [&](int i) {
+    EvaluationWorkspace& workspace = thread_workspace();
+    evaluate_with_memo(stacks[i], x, constants[i], samples_hash, memo,
+                       workspace);
+    values.col(i) = workspace.result();
+  });
+  return values;
+}
+} // namespace bingo
@@ -0,0 +1,190 @@
+/*!
+ * \file population.cpp
+ *
+ * This file contains the structure of arrays population store.
+ */
+
+#include <algorithm>
+
+#include "BingoCpp/backend.h"
+#include "BingoCpp/population.h"
+#include "BingoCpp/rewrite.h"
+#include "BingoCpp/stack_analysis.h"
+
+namespace bingo {
+namespace {
+
+const int C_LOAD = 1;
+} // namespace
+
+template <typename Command>
+BasicPopulation<Command>::BasicPopulation(int pop_size, int stack_size)
+  : fitness(pop_size, 0.0), genetic_age(pop_size, 0), fit_set(pop_size, 0),
+    needs_opt(pop_size, 0), opt_rate(0),
+    eliminate_common_subexpressions(false), rewrite_identities(false),
+    stack_size_(stack_size),
+    commands_(static_cast<std::size_t>(pop_size) * stack_size * 3, 0),
+    constant_offsets_(pop_size + 1, 0) {}
+
+// Moves the constants after individual i so that it has room for exactly
+// count constants.
+template <typename Command>
+void BasicPopulation<Command>::resize_constants(int i, int count) {
+  int difference = count - num_constants(i);
+  if (difference == 0) {
+    return;
+  }
+  std::vector<double>::iterator end =
+    constant_values_.begin() + constant_offsets_[i + 1];
+  if (difference > 0) {
+    constant_values_.insert(end, difference, 0.0);
+  } else {
+    constant_values_.erase(end + difference, end);
+  }
+  for (std::size_t j = i + 1; j < constant_offsets_.size(); ++j) {
+    constant_offsets_[j] += difference;
+  }
+}
+
+template <typename Command>
+void BasicPopulation<Command>::set_constants(
+    int i, const Eigen::VectorXd &constants) {
+  resize_constants(i, constants.size());
+  this->constants(i) = constants;
+}
+
+template <typename Command>
+void BasicPopulation<Command>::reset_constants(const std::vector<int> &counts) {
+  for (int i = 0; i < size(); ++i) {
+    constant_offsets_[i + 1] = constant_offsets_[i] + counts[i];
+  }
+  constant_values_.assign(constant_offsets_.back(), 0.0);
+}
+
+template <typename Command>
+AcyclicGraph BasicPopulation<Command>::individual(int i) const {
+  AcyclicGraph indv;
+  indv.stack = stack(i).template cast<int>();
+  indv.constants = constants(i);
+  if (fit_set[i]) {
+    indv.fitness = std::vector<double>(1, fitness[i]);
+  }
+  indv.fit_set = fit_set[i];
+  indv.needs_opt = needs_opt[i];
+  indv.genetic_age = genetic_age[i];
+  indv.opt_rate = opt_rate;
+
+  StackAnalysis &analysis = thread_stack_analysis();
+  analyze_stack(indv.stack, analysis);
+  simplify_stack(indv.stack, analysis, indv.simple_stack);
+
+  if (rewrite_identities) {
+    indv.simple_stack = rewrite_stack(indv.simple_stack);
+  } else if (eliminate_common_subexpressions) {
+    indv.simple_stack = merge_common_subexpressions(indv.simple_stack);
+  }
+
+  return indv;
+}
+
+template <typename Command>
+void BasicPopulation<Command>::set_individual(int i, const AcyclicGraph &indv) {
+  stack(i) = indv.stack.cast<Command>();
+  set_constants(i, indv.constants);
+  fitness[i] = indv.fitness.empty() ? 0.0 : indv.fitness[0];
+  fit_set[i] = indv.fit_set;
+  needs_opt[i] = indv.needs_opt;
+  genetic_age[i] = indv.genetic_age;
+}
+
+template <typename Command>
+void BasicPopulation<Command>::copy_individual(int from, int to) {
+  if (from == to) {
+    return;
+  }
+  std::copy(commands_.begin() + offset(from),
+            commands_.begin() + offset(from + 1),
+            commands_.begin() + offset(to));
+  resize_constants(to, num_constants(from));
+  constants(to) = constants(from);
+  fitness[to] = fitness[from];
+  fit_set[to] = fit_set[from];
+  needs_opt[to] = needs_opt[from];
+  genetic_age[to] = genetic_age[from];
+}
+
+template <typename Command>
+void BasicPopulation<Command>::set_command(int i, int row, int node,
+                                           int param1, int param2) {
+  Command* command = commands_.data() + offset(i) + 3 * row;
+  command[0] = node;
+  command[1] = param1;
+  command[2] = param2;
+  fit_set[i] = false;
+}
+
+template <typename Command>
+void BasicPopulation<Command>::crossover(int parent1, int parent2,
+                                         int child1, int child2,
+                                         int cross_point) {
+  int age = std::max(genetic_age[parent1], genetic_age[parent2]);
+  Eigen::VectorXd constants1 = constants(parent1);
+  Eigen::VectorXd constants2 = constants(parent2);
+  bool needs_opt1 = needs_opt[parent1];
+  bool needs_opt2 = needs_opt[parent2];
+  copy_individual(parent1, child1);
+  copy_individual(parent2, child2);
+  std::swap_ranges(commands_.begin() + offset(child1) + 3 * cross_point,
+                   commands_.begin() + offset(child1 + 1),
+                   commands_.begin() + offset(child2) + 3 * cross_point);
+  merge_constants(child1, cross_point, constants1, needs_opt1, constants2,
+                  needs_opt2);
+  merge_constants(child2, cross_point, constants2, needs_opt2, constants1,
+                  needs_opt1);
+  genetic_age[child1] = age;
+  genetic_age[child2] = age;
+  fit_set[child1] = false;
+  fit_set[child2] = false;
+}
+
+// Renumbers the utilized constants of a child in stack order, taking each
+// value from the parent its command came from: head above cross_point, tail
+// from it on.  Constants which have no value yet need optimization.
+template <typename Command>
+void BasicPopulation<Command>::merge_constants(
+    int child, int cross_point, const Eigen::VectorXd &head,
+    bool head_needs_opt, const Eigen::VectorXd &tail, bool tail_needs_opt) {
+  StackView child_stack = stack(child);
+  StackAnalysis &analysis = thread_stack_analysis();
+  analyze_stack(child_stack.template cast<int>(), analysis);
+  Eigen::VectorXd merged(analysis.num_constants);
+  bool unset = false;
+
+  for (int row = 0; row < stack_size_; ++row) {
+    if (child_stack(row, 0) != C_LOAD) {
+      continue;
+    }
+    int number = analysis.constant_number[row];
+    if (number >= 0) {
+      const Eigen::VectorXd &source = row < cross_point ? head : tail;
+      int old_number = child_stack(row, 1);
+      if (old_number >= 0 && old_number < source.size()) {
+        merged(number) = source(old_number);
+        unset = unset || (row < cross_point ? head_needs_opt : tail_needs_opt);
+      } else {
+        merged(number) = 0.0;
+        unset = true;
+      }
+    }
+    child_stack(row, 1) = number;
+    child_stack(row, 2) = number;
+  }
+
+  set_constants(child, merged);
+  needs_opt[child] = unset || ((opt_rate == 3 || opt_rate == 5) &&
+                               merged.size() > 0);
+}
+
+template class BasicPopulation<int>;
+template class BasicPopulation<int16_t>;
+} // namespace bingo
@@ -0,0 +1,50 @@
+/*!
+ * \file random.cpp
+ *
+ * This file contains the seeding and jump ahead of the xoshiro256**
+ * generator.
+ */
+
+#include "BingoCpp/random.h"
+
+namespace bingo {
+namespace {
+
+uint64_t splitmix64(uint64_t &x) {
+  uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+const uint64_t JUMP[4] = {
+  0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+  0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL
+};
+} // namespace
+
+void Xoshiro256::seed(uint64_t seed) {
+  for (int i = 0; i < 4; ++i) {
+    state_[i] = splitmix64(seed);
+  }
+}
+
+void Xoshiro256::jump() {
+  uint64_t jumped[4] = {0, 0, 0, 0};
+
+  for (int i = 0; i < 4; ++i) {
+    for (int bit = 0; bit < 64; ++bit) {
+      if (JUMP[i] & (1ULL << bit)) {
+        for (int j = 0; j < 4; ++j) {
+          jumped[j] ^= state_[j];
+        }
+      }
+      (*this)();
+    }
+  }
+
+  for (int j = 0; j < 4; ++j) {
+    state_[j] = jumped[j];
+  }
+}
+} // namespace bingo
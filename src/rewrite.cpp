@@ -0,0 +1,296 @@
+/*!
+ * \file rewrite.cpp
+ *
+ * This file contains the algebraic rewrite pass over stacks.  The identities
+ * are kept in tables indexed by node type so that adding an operator means
+ * adding a row to each table.
+ */
+
+#include <map>
+#include <tuple>
+#include <vector>
+
+#include "BingoCpp/acyclic_graph.h"
+#include "BingoCpp/backend.h"
+#include "BingoCpp/rewrite.h"
+
+namespace bingo {
+namespace {
+
+const int NODE_IDX = 0;
+const int OP_1 = 1;
+const int OP_2 = 2;
+
+const int C_LOAD = 1;
+const int ADDITION = 2;
+const int MULTIPLICATION = 4;
+const int EXP = 8;
+const int LOG = 9;
+const int ABSOLUTE = 11;
+const int SQRT = 12;
+const int NUM_NODE_TYPES = 13;
+
+// What is known about the value of a command.
+enum Value {
+  ANY,
+  ZERO,
+  ONE
+};
+
+// Result of a binary command when one of its operands is zero or one, or
+// when both operands are the same command.
+enum Rewrite {
+  KEEP,          // no simplification
+  FIRST,         // the first operand
+  SECOND,        // the second operand
+  ZERO_VALUE,    // zero
+  ONE_VALUE,     // one
+  ABS_FIRST      // abs of the first operand
+};
+
+struct BinaryIdentities {
+  Rewrite first_zero;
+  Rewrite second_zero;
+  Rewrite first_one;
+  Rewrite second_one;
+  Rewrite same_operands;
+};
+
+const BinaryIdentities NO_IDENTITIES = {KEEP, KEEP, KEEP, KEEP, KEEP};
+
+// indexed by node type; only the binary operators have identities.  0 / b
+// and a / a are kept: where b or a is zero they are NaN, not 0 or 1.
+const BinaryIdentities BINARY_IDENTITIES[NUM_NODE_TYPES] = {
+  NO_IDENTITIES,                                              // X
+  NO_IDENTITIES,                                              // C
+  {SECOND, FIRST, KEEP, KEEP, KEEP},                          // +
+  {KEEP, FIRST, KEEP, KEEP, ZERO_VALUE},                      // -
+  {ZERO_VALUE, ZERO_VALUE, SECOND, FIRST, KEEP},              // *
+  {KEEP, KEEP, KEEP, FIRST, KEEP},                            // /
+  NO_IDENTITIES,                                              // sin
+  NO_IDENTITIES,                                              // cos
+  NO_IDENTITIES,                                              // exp
+  NO_IDENTITIES,                                              // log
+  {KEEP, ONE_VALUE, ONE_VALUE, ABS_FIRST, KEEP},              // pow
+  NO_IDENTITIES,                                              // abs
+  NO_IDENTITIES                                               // sqrt
+};
+
+// value of the unary operators at zero and at one
+const Value UNARY_AT_ZERO[NUM_NODE_TYPES] = {
+  ANY, ANY, ANY, ANY, ANY, ANY,
+  ZERO,   // sin
+  ONE,    // cos
+  ONE,    // exp
+  ANY,    // log
+  ANY,
+  ZERO,   // abs
+  ZERO    // sqrt
+};
+const Value UNARY_AT_ONE[NUM_NODE_TYPES] = {
+  ANY, ANY, ANY, ANY, ANY, ANY,
+  ANY,    // sin
+  ANY,    // cos
+  ANY,    // exp
+  ZERO,   // log
+  ANY,
+  ONE,    // abs
+  ONE     // sqrt
+};
+
+// operators reading only the magnitude of their first operand
+const bool IGNORES_SIGN[NUM_NODE_TYPES] = {
+  false, false, false, false, false, false,
+  false,  // sin
+  true,   // cos
+  false,  // exp
+  true,   // log
+  true,   // pow
+  true,   // abs
+  true    // sqrt
+};
+
+// operators whose value is never negative
+const bool NON_NEGATIVE[NUM_NODE_TYPES] = {
+  false, false, false, false, false, false,
+  false,  // sin
+  false,  // cos
+  true,   // exp
+  false,  // log
+  true,   // pow
+  true,   // abs
+  true    // sqrt
+};
+
+struct Command {
+  int node;
+  int param1;
+  int param2;
+  Value value;
+};
+
+// Builds the rewritten stack one command at a time.  Commands are
+// hash-consed so that operands produced by different rewrites are still
+// recognized as the same command.
+class Rewriter {
+ public:
+  Rewriter() : zero_row_(-1), one_row_(-1) {}
+
+  int terminal(int node, int param1, int param2) {
+    if (node == C_LOAD && param1 < 0) {
+      return append(node, param1, param2, ANY);
+    }
+    return emit(node, param1, param1, ANY);
+  }
+
+  int rewrite(int node, int a, int b) {
+    if (!AcyclicGraph::has_arity_two(node)) {
+      return rewrite_unary(node, a);
+    }
+    return rewrite_binary(node, a, b);
+  }
+
+  Eigen::ArrayX3i stack(int result_row) const {
+    Eigen::ArrayX3i stack(result_row + 1, 3);
+    for (int row = 0; row <= result_row; ++row) {
+      stack.row(row) << commands_[row].node, commands_[row].param1,
+                        commands_[row].param2;
+    }
+    return stack;
+  }
+
+ private:
+  int rewrite_unary(int node, int a) {
+    Command operand = commands_[a];
+    if (operand.value != ANY) {
+      Value value = operand.value == ZERO ? UNARY_AT_ZERO[node]
+                                          : UNARY_AT_ONE[node];
+      if (value == ZERO) {
+        return zero(node, a, a);
+      } else if (value == ONE) {
+        return one(node, a, a);
+      }
+    }
+
+    if (node == ABSOLUTE && NON_NEGATIVE[operand.node]) {
+      return a;
+    }
+    if (IGNORES_SIGN[node] && operand.node == ABSOLUTE) {
+      return rewrite_unary(node, operand.param1);
+    }
+    if (node == EXP && operand.node == LOG) {
+      return rewrite_unary(ABSOLUTE, operand.param1);
+    }
+    if (node == LOG && operand.node == EXP) {
+      return operand.param1;
+    }
+    return emit(node, a, a, ANY);
+  }
+
+  int rewrite_binary(int node, int a, int b) {
+    const BinaryIdentities& identities = BINARY_IDENTITIES[node];
+    Rewrite rewrite = KEEP;
+    if (commands_[a].value == ZERO) {
+      rewrite = identities.first_zero;
+    } else if (commands_[a].value == ONE) {
+      rewrite = identities.first_one;
+    }
+    if (rewrite == KEEP && commands_[b].value == ZERO) {
+      rewrite = identities.second_zero;
+    } else if (rewrite == KEEP && commands_[b].value == ONE) {
+      rewrite = identities.second_one;
+    }
+    if (rewrite == KEEP && a == b) {
+      rewrite = identities.same_operands;
+    }
+
+    switch (rewrite) {
+      case FIRST:
+        return a;
+      case SECOND:
+        return b;
+      case ZERO_VALUE:
+        return zero(node, a, b);
+      case ONE_VALUE:
+        return one(node, a, b);
+      case ABS_FIRST:
+        return rewrite_unary(ABSOLUTE, a);
+      default:
+        break;
+    }
+
+    if (IGNORES_SIGN[node] && commands_[a].node == ABSOLUTE) {
+      return rewrite_binary(node, commands_[a].param1, b);
+    }
+    if (node == MULTIPLICATION && a == b && commands_[a].node == SQRT) {
+      return rewrite_unary(ABSOLUTE, commands_[a].param1);
+    }
+    return emit(node, a, b, ANY);
+  }
+
+  // node(a, b) evaluates to zero; reuse a zero computed earlier if any
+  int zero(int node, int a, int b) {
+    if (zero_row_ < 0) {
+      zero_row_ = emit(node, a, b, ZERO);
+    }
+    return zero_row_;
+  }
+
+  int one(int node, int a, int b) {
+    if (one_row_ < 0) {
+      one_row_ = emit(node, a, b, ONE);
+    }
+    return one_row_;
+  }
+
+  int emit(int node, int param1, int param2, Value value) {
+    if ((node == ADDITION || node == MULTIPLICATION) && param2 < param1) {
+      std::swap(param1, param2);
+    }
+    std::tuple<int, int, int> key(node, param1, param2);
+    std::map<std::tuple<int, int, int>, int>::iterator found =
+      rows_.find(key);
+    if (found != rows_.end()) {
+      if (value != ANY) {
+        commands_[found->second].value = value;
+      }
+      return found->second;
+    }
+    int row = append(node, param1, param2, value);
+    rows_[key] = row;
+    return row;
+  }
+
+  int append(int node, int param1, int param2, Value value) {
+    Command command = {node, param1, param2, value};
+    commands_.push_back(command);
+    return commands_.size() - 1;
+  }
+
+  std::vector<Command> commands_;
+  std::map<std::tuple<int, int, int>, int> rows_;
+  int zero_row_;
+  int one_row_;
+};
+} // namespace
+
+Eigen::ArrayX3i rewrite_stack(const Eigen::ArrayX3i& stack) {
+  Eigen::ArrayX3i simple_stack = simplify_stack(stack);
+  std::vector<int> rewritten_row(simple_stack.rows());
+  Rewriter rewriter;
+  for (int row = 0; row < simple_stack.rows(); ++row) {
+    int node = simple_stack(row, NODE_IDX);
+    int param1 = simple_stack(row, OP_1);
+    int param2 = simple_stack(row, OP_2);
+    if (AcyclicGraph::is_terminal(node)) {
+      rewritten_row[row] = rewriter.terminal(node, param1, param2);
+    } else {
+      rewritten_row[row] = rewriter.rewrite(node, rewritten_row[param1],
+                                            rewritten_row[param2]);
+    }
+  }
+
+  // the result may now be an earlier command; nothing after it is read
+  return simplify_stack(rewriter.stack(rewritten_row.back()));
+}
+} // namespace bingo
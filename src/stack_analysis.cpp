@@ -0,0 +1,67 @@
+/*!
+ * \file stack_analysis.cpp
+ *
+ * This file contains the analysis of the utilized commands of a stack shared
+ * by the backend, the acyclic graph and the manipulator.
+ */
+
+#include "BingoCpp/acyclic_graph.h"
+#include "BingoCpp/backend.h"
+#include "BingoCpp/stack_analysis.h"
+
+namespace bingo {
+namespace {
+
+const int NODE_IDX = 0;
+const int OP_1 = 1;
+const int OP_2 = 2;
+
+const int C_LOAD = 1;
+} // namespace
+
+void analyze_stack(const Eigen::ArrayX3i& stack, StackAnalysis& analysis) {
+  int stack_depth = stack.rows();
+  get_utilized_commands(stack, analysis.mask);
+  analysis.remap.assign(stack_depth, -1);
+  analysis.constant_number.assign(stack_depth, -1);
+  analysis.utilized_rows.resize(stack_depth);
+  analysis.num_utilized = 0;
+  analysis.num_constants = 0;
+
+  for (int row = 0; row < stack_depth; ++row) {
+    if (!analysis.mask[row]) {
+      continue;
+    }
+    if (stack(row, NODE_IDX) == C_LOAD) {
+      analysis.constant_number[row] = analysis.num_constants++;
+    }
+    analysis.remap[row] = analysis.num_utilized;
+    analysis.utilized_rows[analysis.num_utilized++] = row;
+  }
+}
+
+StackAnalysis& thread_stack_analysis() {
+  static thread_local StackAnalysis analysis;
+  return analysis;
+}
+
+void simplify_stack(const Eigen::ArrayX3i& stack,
+                    const StackAnalysis& analysis,
+                    Eigen::ArrayX3i& simple_stack) {
+  simple_stack.resize(analysis.num_utilized, 3);
+  for (int i = 0; i < analysis.num_utilized; ++i) {
+    int row = analysis.utilized_rows[i];
+    int node = stack(row, NODE_IDX);
+    simple_stack(i, NODE_IDX) = node;
+    if (AcyclicGraph::is_terminal(node)) {
+      simple_stack(i, OP_1) = stack(row, OP_1);
+      simple_stack(i, OP_2) = stack(row, OP_2);
+    } else {
+      simple_stack(i, OP_1) = analysis.remap[stack(row, OP_1)];
+      simple_stack(i, OP_2) = AcyclicGraph::has_arity_two(node) ?
+                              analysis.remap[stack(row, OP_2)] :
+                              simple_stack(i, OP_1);
+    }
+  }
+}
+} // namespace bingo
@@ -0,0 +1,183 @@
+/*!
+ * \file thread_pool.cc
+ *
+ * This file contains a work-stealing thread pool used to evaluate
+ * populations of individuals in parallel.
+ */
+
+#include <algorithm>
+
+#include "BingoCpp/thread_pool.h"
+
+namespace bingo {
+namespace {
+
+// Pool whose task is running on the current thread, if any.
+thread_local const ThreadPool* current_pool = NULL;
+} // namespace
+
+ThreadPool::ThreadPool(int num_threads) : task_(NULL), generation_(0),
+  active_workers_(0), stop_(false), pending_tasks_(0), failed_(false) {
+  if (num_threads <= 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  for (int i = 0; i < num_threads; ++i) {
+    queues_.push_back(std::unique_ptr<TaskQueue>(new TaskQueue()));
+  }
+
+  for (int i = 1; i < num_threads; ++i) {
+    workers_.push_back(std::thread(&ThreadPool::worker_loop, this, i));
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  start_condition_.notify_all();
+
+  for (std::size_t i = 0; i < workers_.size(); ++i) {
+    workers_[i].join();
+  }
+}
+
+void ThreadPool::parallel_for(int num_tasks,
+                              const std::function<void(int)>& task) {
+  if (num_tasks <= 0) {
+    return;
+  }
+
+  if (current_pool == this || num_threads() == 1 || num_tasks == 1) {
+    for (int i = 0; i < num_tasks; ++i) {
+      task(i);
+    }
+    return;
+  }
+
+  // one loop at a time: the queues, task_ and pending_tasks_ are shared
+  std::lock_guard<std::mutex> caller_lock(caller_mutex_);
+  int threads = num_threads();
+  for (int t = 0; t < threads; ++t) {
+    std::lock_guard<std::mutex> lock(queues_[t]->mutex);
+    int begin = static_cast<long>(num_tasks) * t / threads;
+    int end = static_cast<long>(num_tasks) * (t + 1) / threads;
+    for (int i = end - 1; i >= begin; --i) {
+      queues_[t]->tasks.push_back(i);
+    }
+  }
+
+  pending_tasks_ = num_tasks;
+  failed_ = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    task_ = &task;
+    ++generation_;
+  }
+  start_condition_.notify_all();
+
+  run_tasks(0, task);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_condition_.wait(lock, [this] {
+    return pending_tasks_ == 0 && active_workers_ == 0;
+  });
+  task_ = NULL;
+
+  if (exception_) {
+    std::exception_ptr exception = exception_;
+    exception_ = std::exception_ptr();
+    std::rethrow_exception(exception);
+  }
+}
+
+void ThreadPool::worker_loop(int thread_id) {
+  long seen_generation = 0;
+
+  while (true) {
+    const std::function<void(int)>* task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      start_condition_.wait(lock, [this, seen_generation] {
+        return stop_ || (task_ != NULL && generation_ != seen_generation);
+      });
+
+      if (stop_) {
+        return;
+      }
+
+      seen_generation = generation_;
+      task = task_;
+      ++active_workers_;
+    }
+
+    run_tasks(thread_id, *task);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      --active_workers_;
+    }
+    done_condition_.notify_all();
+  }
+}
+
+void ThreadPool::run_tasks(int thread_id,
+                           const std::function<void(int)>& task) {
+  const ThreadPool* outer_pool = current_pool;
+  current_pool = this;
+  int task_index;
+
+  while (pop_task(thread_id, task_index) || steal_task(thread_id, task_index)) {
+    // after a failure the remaining tasks are only counted off
+    if (!failed_) {
+      try {
+        task(task_index);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!exception_) {
+          exception_ = std::current_exception();
+        }
+        failed_ = true;
+      }
+    }
+
+    if (--pending_tasks_ == 0) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      done_condition_.notify_all();
+    }
+  }
+
+  current_pool = outer_pool;
+}
+
+bool ThreadPool::pop_task(int thread_id, int& task_index) {
+  TaskQueue& queue = *queues_[thread_id];
+  std::lock_guard<std::mutex> lock(queue.mutex);
+
+  if (queue.tasks.empty()) {
+    return false;
+  }
+
+  task_index = queue.tasks.back();
+  queue.tasks.pop_back();
+  return true;
+}
+
+bool ThreadPool::steal_task(int thread_id, int& task_index) {
+  int threads = num_threads();
+
+  for (int i = 1; i < threads; ++i) {
+    TaskQueue& victim = *queues_[(thread_id + i) % threads];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+
+    if (!victim.tasks.empty()) {
+      task_index = victim.tasks.front();
+      victim.tasks.pop_front();
+      return true;
+    }
+  }
+
+  return false;
+}
+} // namespace bingo
@@ -107,6 +107,41 @@ TEST_P(AGraphBackend, simplify_and_evaluate_c_deriv) {
   Eigen::ArrayXXd df_dc = res_and_gradient.second;
   ASSERT_TRUE(testutils::almost_equal(expected_derivative, df_dc));
 }
+TEST_P(AGraphBackend, mixed_derivative_matches_finite_differences) {
+  int operator_i = GetParam();
+  // op(X_0 * C_0, C_1), or a load of X_0 or C_0
+  Eigen::ArrayX3i stack(5, 3);
+  stack << 0, 0, 0,
+           1, 0, 0,
+           1, 1, 1,
+           4, 0, 1,
+           operator_i, 3, 2;
+  if (operator_i < 2) {
+    stack.row(4) << operator_i, 0, 0;
+  }
+  Eigen::ArrayXXd x_0 = x / 10.0;
+  Eigen::VectorXd c_0 = constants.matrix();
+
+  std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd> mixed =
+    evaluate_mixed_derivative(stack, x_0, c_0);
+  ASSERT_TRUE(testutils::almost_equal(
+    evaluate_with_derivative(stack, x_0, c_0).second, mixed.first));
+
+  const double epsilon = 1e-6;
+  for (int k = 0; k < c_0.size(); ++k) {
+    Eigen::VectorXd c_plus = c_0;
+    Eigen::VectorXd c_minus = c_0;
+    c_plus[k] += epsilon;
+    c_minus[k] -= epsilon;
+    Eigen::ArrayXXd expected =
+      (evaluate_with_derivative(stack, x_0, c_plus).second -
+       evaluate_with_derivative(stack, x_0, c_minus).second) / (2 * epsilon);
+    Eigen::ArrayXXd actual = mixed.second.middleCols(k * x_0.cols(),
+                                                     x_0.cols());
+    ASSERT_TRUE(((expected - actual).abs() <=
+                 1e-5 * expected.abs().max(1.0)).all());
+  }
+}
 INSTANTIATE_TEST_CASE_P(,AGraphBackend, ::testing::Range(0, N_OPS, 1));
 
 
@@ -145,6 +180,401 @@ TEST_F(AGraphBackend, mask_evaluate_and_derivative) {
   ASSERT_TRUE(testutils::almost_equal(y_and_dy.first, y_and_dy_simple.first));
 }
 
+TEST_F(AGraphBackend, workspace_evaluate) {
+  EvaluationWorkspace workspace;
+  evaluate(simple_stack, x, constants, workspace);
+  Eigen::ArrayXXd y_true = x.col(0) * (constants[0] + constants[1] 
+                          / x.col(1)) - x.col(0);
+  ASSERT_TRUE(testutils::almost_equal(workspace.result(), y_true));
+
+  simplify_and_evaluate(simple_stack2, x, constants, workspace);
+  ASSERT_TRUE(testutils::almost_equal(workspace.result(), x.col(0).square()));
+}
+
+TEST_F(AGraphBackend, workspace_evaluate_and_derivative) {
+  EvaluationWorkspace workspace;
+  std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd> y_and_dy =
+    evaluate_with_derivative(simple_stack, x, constants);
+  evaluate_with_derivative(simple_stack, x, constants, workspace);
+  ASSERT_TRUE(testutils::almost_equal(y_and_dy.first, workspace.result()));
+  ASSERT_TRUE(testutils::almost_equal(y_and_dy.second, workspace.derivative));
+
+  y_and_dy = simplify_and_evaluate_with_derivative(simple_stack, x, constants,
+                                                   false);
+  simplify_and_evaluate_with_derivative(simple_stack, x, constants, workspace,
+                                        false);
+  ASSERT_TRUE(testutils::almost_equal(y_and_dy.first, workspace.result()));
+  ASSERT_TRUE(testutils::almost_equal(y_and_dy.second, workspace.derivative));
+}
+
+TEST_F(AGraphBackend, workspace_reuses_buffers) {
+  EvaluationWorkspace workspace;
+  evaluate_with_derivative(simple_stack, x, constants, workspace);
+  const double* first_buffer = workspace.forward_eval[0].data();
+  const double* last_adjoint = workspace.reverse_eval[11].data();
+  evaluate_with_derivative(simple_stack, x, constants, workspace);
+  ASSERT_EQ(first_buffer, workspace.forward_eval[0].data());
+  ASSERT_EQ(last_adjoint, workspace.reverse_eval[11].data());
+}
+
+TEST_F(AGraphBackend, allocate_buffers_recycles_dead_values) {
+  std::vector<bool> mask = get_utilized_commands(simple_stack);
+  BufferAllocation allocation;
+  allocate_buffers(simple_stack, mask, allocation);
+  ASSERT_EQ(allocation.num_buffers, 4);
+  for (int i = 0; i < simple_stack.rows(); ++i) {
+    if (mask[i]) {
+      ASSERT_GE(allocation.buffer_index[i], 0);
+      ASSERT_LT(allocation.buffer_index[i], allocation.num_buffers);
+    } else {
+      ASSERT_EQ(allocation.buffer_index[i], -1);
+    }
+  }
+}
+
+TEST_F(AGraphBackend, allocate_buffers_long_chain) {
+  const int depth = 128;
+  Eigen::ArrayX3i chain(depth, 3);
+  chain.row(0) << 0, 0, 0;
+  chain.row(1) << 0, 1, 1;
+  for (int i = 2; i < depth; ++i) {
+    chain.row(i) << 2 + i % 3, i - 1, i % 2;
+  }
+  std::vector<bool> mask(depth, true);
+  BufferAllocation allocation;
+  allocate_buffers(chain, mask, allocation);
+  ASSERT_EQ(allocation.num_buffers, 3);
+
+  EvaluationWorkspace workspace;
+  evaluate(chain, x, constants, workspace);
+  ASSERT_LE(workspace.forward_eval.size(), 3);
+  std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd> y_and_dy =
+    evaluate_with_derivative(chain, x, constants);
+  ASSERT_TRUE(testutils::almost_equal(workspace.result(), y_and_dy.first));
+}
+
+TEST_F(AGraphBackend, tiled_evaluate_matches_untiled) {
+  Eigen::ArrayXXd big_x = Eigen::ArrayXXd::Random(1003, 3) + 2.;
+  EvaluationWorkspace untiled;
+  untiled.tile_size = big_x.rows();
+  EvaluationWorkspace tiled;
+  tiled.tile_size = 64;
+
+  evaluate(simple_stack, big_x, constants, untiled);
+  evaluate(simple_stack, big_x, constants, tiled);
+  ASSERT_TRUE(testutils::almost_equal(untiled.result(), tiled.result()));
+
+  simplify_and_evaluate(simple_stack, big_x, constants, untiled);
+  simplify_and_evaluate(simple_stack, big_x, constants, tiled);
+  ASSERT_TRUE(testutils::almost_equal(untiled.result(), tiled.result()));
+}
+
+TEST_F(AGraphBackend, tiled_derivative_matches_untiled) {
+  Eigen::ArrayXXd big_x = Eigen::ArrayXXd::Random(1003, 3) + 2.;
+  EvaluationWorkspace untiled;
+  untiled.tile_size = big_x.rows();
+  EvaluationWorkspace tiled;
+  tiled.tile_size = 100;
+
+  for (int x_or_c = 0; x_or_c < 2; ++x_or_c) {
+    evaluate_with_derivative(simple_stack, big_x, constants, untiled, x_or_c);
+    evaluate_with_derivative(simple_stack, big_x, constants, tiled, x_or_c);
+    ASSERT_TRUE(testutils::almost_equal(untiled.result(), tiled.result()));
+    ASSERT_TRUE(testutils::almost_equal(untiled.derivative, tiled.derivative));
+
+    simplify_and_evaluate_with_derivative(simple_stack, big_x, constants,
+                                          untiled, x_or_c);
+    simplify_and_evaluate_with_derivative(simple_stack, big_x, constants,
+                                          tiled, x_or_c);
+    ASSERT_TRUE(testutils::almost_equal(untiled.result(), tiled.result()));
+    ASSERT_TRUE(testutils::almost_equal(untiled.derivative, tiled.derivative));
+  }
+}
+
+TEST_F(AGraphBackend, evaluate_population) {
+  std::vector<Eigen::ArrayX3i> stacks;
+  std::vector<Eigen::VectorXd> population_constants;
+  for (int op = 2; op < N_OPS; ++op) {
+    stacks.push_back(testutils::stack_binary_operator(op));
+    population_constants.push_back(constants * op);
+  }
+
+  Eigen::ArrayXXd values = evaluate_population(stacks, x,
+                                               population_constants);
+  ASSERT_EQ(values.cols(), stacks.size());
+  for (std::size_t i = 0; i < stacks.size(); ++i) {
+    Eigen::ArrayXXd y = simplify_and_evaluate(stacks[i], x,
+                                              population_constants[i]);
+    ASSERT_TRUE(testutils::almost_equal(y, values.col(i)));
+  }
+}
+
+TEST_F(AGraphBackend, evaluate_population_with_derivative) {
+  std::vector<Eigen::ArrayX3i> stacks;
+  std::vector<Eigen::VectorXd> population_constants;
+  stacks.push_back(simple_stack);
+  population_constants.push_back(constants);
+  stacks.push_back(testutils::stack_binary_operator(4));
+  population_constants.push_back(constants.head(1));
+
+  std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd> c_result =
+    evaluate_population_with_derivative(stacks, x, population_constants,
+                                        false);
+  ASSERT_EQ(c_result.second.cols(), 3);
+  std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd> x_result =
+    evaluate_population_with_derivative(stacks, x, population_constants);
+  ASSERT_EQ(x_result.second.cols(), 6);
+
+  for (std::size_t i = 0; i < stacks.size(); ++i) {
+    std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd> expected =
+      simplify_and_evaluate_with_derivative(stacks[i], x,
+                                            population_constants[i], false);
+    ASSERT_TRUE(testutils::almost_equal(expected.first, c_result.first.col(i)));
+    ASSERT_TRUE(testutils::almost_equal(
+      expected.second, c_result.second.middleCols(2 * i, 2 - i)));
+
+    expected = simplify_and_evaluate_with_derivative(stacks[i], x,
+                                                     population_constants[i]);
+    ASSERT_TRUE(testutils::almost_equal(expected.first, x_result.first.col(i)));
+    ASSERT_TRUE(testutils::almost_equal(
+      expected.second, x_result.second.middleCols(3 * i, 3)));
+  }
+}
+
+TEST_F(AGraphBackend, parallel_evaluate_population_matches_serial) {
+  std::vector<Eigen::ArrayX3i> stacks;
+  std::vector<Eigen::VectorXd> population_constants;
+  for (int i = 0; i < 40; ++i) {
+    stacks.push_back(testutils::stack_binary_operator(2 + i % (N_OPS - 2)));
+    population_constants.push_back(constants * (i + 1));
+  }
+  ThreadPool pool(4);
+
+  ASSERT_TRUE(testutils::almost_equal(
+    evaluate_population(stacks, x, population_constants),
+    evaluate_population(stacks, x, population_constants, pool)));
+
+  std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd> serial =
+    evaluate_population_with_derivative(stacks, x, population_constants,
+                                        false);
+  std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd> parallel =
+    evaluate_population_with_derivative(stacks, x, population_constants,
+                                        pool, false);
+  ASSERT_TRUE(testutils::almost_equal(serial.first, parallel.first));
+  ASSERT_TRUE(testutils::almost_equal(serial.second, parallel.second));
+}
+
+TEST_F(AGraphBackend, partitioned_evaluate_matches_serial) {
+  Eigen::ArrayXXd large_x = Eigen::ArrayXXd::Random(10001, 3);
+  ThreadPool pool(3);
+
+  Eigen::ArrayXXd serial = evaluate(simple_stack, large_x, constants);
+  Eigen::ArrayXXd partitioned = evaluate(simple_stack, large_x, constants,
+                                         pool);
+  ASSERT_TRUE((serial == partitioned).all());
+
+  std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd> serial_deriv =
+    evaluate_with_derivative(simple_stack, large_x, constants, false);
+  std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd> partitioned_deriv =
+    evaluate_with_derivative(simple_stack, large_x, constants, pool, false);
+  ASSERT_TRUE((serial_deriv.first == partitioned_deriv.first).all());
+  ASSERT_TRUE((serial_deriv.second == partitioned_deriv.second).all());
+}
+
+TEST_F(AGraphBackend, residual_with_derivative_matches_separate_sweeps) {
+  Eigen::ArrayXXd large_x = Eigen::ArrayXXd::Random(10001, 3) + 2.0;
+  Eigen::ArrayXXd y = Eigen::ArrayXXd::Random(10001, 1);
+  std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd> expected =
+    evaluate_with_derivative(simple_stack, large_x, constants, false);
+  Eigen::ArrayXXd expected_residual = expected.first - y;
+  double expected_fitness = expected_residual.abs().mean();
+
+  Eigen::ArrayXXd residual;
+  Eigen::ArrayXXd derivative;
+  double fitness = evaluate_residual_with_derivative(
+                     simple_stack, large_x, constants, y, residual,
+                     derivative);
+  ASSERT_TRUE((expected_residual == residual).all());
+  ASSERT_TRUE((expected.second == derivative).all());
+  ASSERT_NEAR(expected_fitness, fitness, 1e-12 * expected_fitness);
+
+  ThreadPool pool(3);
+  fitness = evaluate_residual_with_derivative(simple_stack, large_x,
+                                              constants, y, pool, residual,
+                                              derivative);
+  ASSERT_TRUE((expected_residual == residual).all());
+  ASSERT_TRUE((expected.second == derivative).all());
+  ASSERT_NEAR(expected_fitness, fitness, 1e-12 * expected_fitness);
+}
+
+TEST_F(AGraphBackend, program_residual) {
+  Program program = compile_stack(simple_stack);
+  Eigen::ArrayXXd y = Eigen::ArrayXXd::Random(3, 1);
+  Eigen::ArrayXXd expected = evaluate(program, x, constants) - y;
+  Eigen::ArrayXXd residual;
+  double fitness = evaluate_residual(program, x, constants, y, residual);
+  ASSERT_TRUE((expected == residual).all());
+  ASSERT_DOUBLE_EQ(expected.abs().mean(), fitness);
+
+  ThreadPool pool(2);
+  fitness = evaluate_residual(program, x, constants, y, pool, residual);
+  ASSERT_TRUE((expected == residual).all());
+  ASSERT_DOUBLE_EQ(expected.abs().mean(), fitness);
+}
+
+// (sin(C_0 * C_1) + X_0) * (C_1 / (C_0 * C_1))
+Eigen::ArrayX3i constant_subgraph_stack() {
+  Eigen::ArrayX3i stack(8, 3);
+  stack << 0, 0, 0,
+           1, 0, 0,
+           1, 1, 1,
+           4, 1, 2,
+           6, 3, 3,
+           2, 4, 0,
+           5, 2, 3,
+           4, 5, 6;
+  return stack;
+}
+
+TEST_F(AGraphBackend, constant_subgraphs_fold_to_scalars) {
+  Eigen::ArrayX3i stack = constant_subgraph_stack();
+  double c0 = constants[0];
+  double c1 = constants[1];
+  Eigen::ArrayXXd value = (std::sin(c0 * c1) + x.col(0)) / c0;
+  Eigen::ArrayXXd x_deriv = Eigen::ArrayXXd::Zero(x.rows(), x.cols());
+  x_deriv.col(0).setConstant(1 / c0);
+  Eigen::ArrayXXd c_deriv(x.rows(), 2);
+  c_deriv.col(0) = std::cos(c0 * c1) * c1 / c0 - value / c0;
+  c_deriv.col(1).setConstant(std::cos(c0 * c1));
+
+  EvaluationWorkspace workspace;
+  evaluate(stack, x, constants, workspace);
+  ASSERT_TRUE(testutils::almost_equal(value, workspace.result()));
+  ASSERT_EQ(2u, workspace.folding.folded_rows.size());
+  simplify_and_evaluate_with_derivative(stack, x, constants, workspace, true);
+  ASSERT_TRUE(testutils::almost_equal(value, workspace.result()));
+  ASSERT_TRUE(testutils::almost_equal(x_deriv, workspace.derivative));
+  evaluate_with_derivative(stack, x, constants, workspace, false);
+  ASSERT_TRUE(testutils::almost_equal(value, workspace.result()));
+  ASSERT_TRUE(testutils::almost_equal(c_deriv, workspace.derivative));
+
+  Eigen::ArrayXXd residual;
+  Eigen::ArrayXXd derivative;
+  evaluate_residual_with_derivative(stack, x, constants, value, residual,
+                                    derivative);
+  ASSERT_TRUE(testutils::almost_equal(Eigen::ArrayXXd::Zero(x.rows(), 1),
+                                      residual));
+  ASSERT_TRUE(testutils::almost_equal(c_deriv, derivative));
+}
+
+TEST_F(AGraphBackend, constant_stack_broadcasts_to_samples) {
+  Eigen::ArrayX3i stack(4, 3);
+  stack << 0, 0, 0,
+           1, 0, 0,
+           1, 1, 1,
+           4, 1, 2;
+  EvaluationWorkspace workspace;
+  workspace.tile_size = 2;
+  evaluate_with_derivative(stack, x, constants, workspace, false);
+
+  Eigen::ArrayXXd value = Eigen::ArrayXXd::Constant(x.rows(), 1,
+                                                    constants[0] *
+                                                    constants[1]);
+  Eigen::ArrayXXd c_deriv(x.rows(), 2);
+  c_deriv.col(0).setConstant(constants[1]);
+  c_deriv.col(1).setConstant(constants[0]);
+  ASSERT_TRUE(testutils::almost_equal(value, workspace.result()));
+  ASSERT_TRUE(testutils::almost_equal(c_deriv, workspace.derivative));
+}
+
+TEST_F(AGraphBackend, incremental_evaluation_recomputes_changed_commands) {
+  Eigen::ArrayX3i stack = simple_stack;
+  EvaluationCache cache;
+  evaluate_incremental(stack, x, constants, cache);
+  ASSERT_EQ(8, cache.num_recomputed);
+  ASSERT_TRUE(testutils::almost_equal(evaluate(stack, x, constants),
+                                      cache.result()));
+  evaluate_incremental(stack, x, constants, cache);
+  ASSERT_EQ(0, cache.num_recomputed);
+
+  stack.row(11) << 2, 8, 0;
+  evaluate_incremental(stack, x, constants, cache);
+  ASSERT_EQ(1, cache.num_recomputed);
+  ASSERT_TRUE(testutils::almost_equal(evaluate(stack, x, constants),
+                                      cache.result()));
+
+  // C_0 feeds rows 6, 8 and 11
+  Eigen::VectorXd new_constants = constants;
+  new_constants[0] = 2.0;
+  evaluate_incremental(stack, x, new_constants, cache);
+  ASSERT_EQ(4, cache.num_recomputed);
+  ASSERT_TRUE(testutils::almost_equal(evaluate(stack, x, new_constants),
+                                      cache.result()));
+
+  // an unused command is not evaluated, but becomes valid once used
+  stack.row(9) << 6, 5, 5;
+  stack.row(11) << 2, 9, 0;
+  evaluate_incremental(stack, x, new_constants, cache);
+  ASSERT_EQ(3, cache.num_recomputed);
+  ASSERT_TRUE(testutils::almost_equal(evaluate(stack, x, new_constants),
+                                      cache.result()));
+
+  Eigen::ArrayXXd new_x = x + 1.0;
+  evaluate_incremental(stack, new_x, new_constants, cache);
+  ASSERT_EQ(6, cache.num_recomputed);
+  ASSERT_TRUE(testutils::almost_equal(evaluate(stack, new_x, new_constants),
+                                      cache.result()));
+}
+
+TEST_F(AGraphBackend, merge_common_subexpressions) {
+  // (sin(X_0) + sin(X_0)) * X_0 with every command duplicated
+  Eigen::ArrayX3i stack(7, 3);
+  stack << 0, 0, 0,
+           0, 0, 0,
+           6, 0, 0,
+           6, 1, 1,
+           2, 2, 3,
+           1, 0, 0,
+           4, 4, 1;
+  Eigen::ArrayX3i expected(4, 3);
+  expected << 0, 0, 0,
+              6, 0, 0,
+              2, 1, 1,
+              4, 0, 2;
+  Eigen::ArrayX3i merged = merge_common_subexpressions(stack);
+  ASSERT_EQ(expected.rows(), merged.rows());
+  ASSERT_TRUE((expected == merged).all());
+  ASSERT_TRUE((expected == simplify_stack(stack)).all());
+  ASSERT_TRUE(testutils::almost_equal(evaluate(stack, x, constants),
+                                      evaluate(merged, x, constants)));
+}
+
+TEST_F(AGraphBackend, merge_common_subexpressions_orders_commutative_operands) {
+  Eigen::ArrayX3i sum_ab(5, 3);
+  sum_ab << 0, 0, 0,
+            1, 0, 0,
+            2, 0, 1,
+            3, 1, 0,
+            4, 2, 3;
+  Eigen::ArrayX3i sum_ba = sum_ab;
+  sum_ba.row(2) << 2, 1, 0;
+  ASSERT_TRUE((merge_common_subexpressions(sum_ab) ==
+               merge_common_subexpressions(sum_ba)).all());
+
+  // the operands of a subtraction are not interchangeable
+  Eigen::ArrayX3i difference_ba = sum_ab;
+  difference_ba.row(3) << 3, 0, 1;
+  ASSERT_FALSE((merge_common_subexpressions(sum_ab) ==
+                merge_common_subexpressions(difference_ba)).all());
+
+  // unnumbered constants stay distinct
+  Eigen::ArrayX3i unset_constants(3, 3);
+  unset_constants << 1, -1, -1,
+                     1, -1, -1,
+                     3, 0, 1;
+  ASSERT_EQ(3, merge_common_subexpressions(unset_constants).rows());
+}
+
 // TEST_F(AcyclicGraphTest, simplify) {
 //   // shorter stack
 //   std::cout << "stack\n" << stack << std::endl;
@@ -13,6 +13,8 @@
 #include <set>
 #include <string>
 #include <sstream>
+#include <type_traits>
+#include <utility>
 
 #include "gtest/gtest.h"
 
@@ -73,6 +75,28 @@ TEST_F(AGraphTest, copy) {
   }
 }
 
+TEST_F(AGraphTest, move_takes_storage) {
+  static_assert(std::is_nothrow_move_constructible<AcyclicGraph>::value,
+                "vectors of AcyclicGraph should move on reallocation");
+  static_assert(std::is_nothrow_move_assignable<AcyclicGraph>::value,
+                "AcyclicGraph should move assign without throwing");
+  test_indv.compiled_program();
+  const int* stack_data = test_indv.stack.data();
+  const double* constants_data = test_indv.constants.data();
+  const Program* program = test_indv.program.get();
+
+  AcyclicGraph moved(std::move(test_indv));
+  ASSERT_EQ(stack_data, moved.stack.data());
+  ASSERT_EQ(constants_data, moved.constants.data());
+  ASSERT_EQ(program, moved.program.get());
+
+  AcyclicGraph assigned;
+  assigned = std::move(moved);
+  ASSERT_EQ(stack_data, assigned.stack.data());
+  ASSERT_EQ(constants_data, assigned.constants.data());
+  ASSERT_TRUE((test_stack == assigned.stack).all());
+}
+
 TEST_F(AGraphTest, needs_optimization) {
   EXPECT_FALSE(test_indv.needs_optimization());
 }
@@ -110,6 +134,29 @@ TEST_F(AGraphTest, evaluate_deriv) {
   ASSERT_NEAR(p.second(2), 3.806, .001);
 }
 
+TEST_F(AGraphTest, evaluation_cache_follows_mutations) {
+  Eigen::ArrayXXd expected = test_indv.evaluate(test_x_vals);
+  test_indv.enable_evaluation_cache();
+  ASSERT_TRUE(testutils::almost_equal(expected,
+                                      test_indv.evaluate(test_x_vals)));
+
+  AcyclicGraph child(test_indv);
+  ASSERT_EQ(test_indv.evaluation_cache, child.evaluation_cache);
+  child.stack.row(11) << 2, 8, 0;
+  test_manip.simplify_stack(child);
+  Eigen::ArrayXXd child_value = child.evaluate(test_x_vals);
+  ASSERT_NE(test_indv.evaluation_cache, child.evaluation_cache);
+  ASSERT_EQ(1, child.evaluation_cache->num_recomputed);
+
+  AcyclicGraph uncached(child);
+  uncached.evaluation_cache.reset();
+  ASSERT_TRUE(testutils::almost_equal(uncached.evaluate(test_x_vals),
+                                      child_value));
+  ASSERT_TRUE(testutils::almost_equal(expected,
+                                      test_indv.evaluate(test_x_vals)));
+  ASSERT_EQ(0, test_indv.evaluation_cache->num_recomputed);
+}
+
 TEST_F(AGraphTest, latexstring) {
   std::string str_true = "(\\frac{10}{X_1} + 3.14)(X_0) - (X_0)";
   EXPECT_EQ(str_true, test_indv.latexstring());
@@ -0,0 +1,150 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+#include <Eigen/Dense>
+#include "gtest/gtest.h"
+
+#include "BingoCpp/backend.h"
+#include "BingoCpp/bytecode.h"
+#include "testing_utils.h"
+#include "test_fixtures.h"
+
+using namespace bingo;
+namespace {
+const int N_OPS = 13;
+
+// Values of random stacks span many orders of magnitude, and the
+// interpreter's vectorized exp and sin may differ from std:: by an ulp,
+// which stacks like sin(exp(pow(|x|, x))) amplify.  Perturbing x or the
+// constants by a relative 1e-10 measures how much a sample amplifies
+// relative errors: samples may differ by 1e-12 plus a thousandth of the
+// change, i.e. by a few hundred amplified ulps.  Samples which the
+// perturbation changes by more than 1e-6 amplify errors too much to be
+// compared, as do samples next to a singularity.
+bool equal_up_to_conditioning(const Eigen::ArrayX3i& stack,
+                              const Eigen::ArrayXXd& x,
+                              const Eigen::VectorXd& constants,
+                              const Eigen::ArrayXXd& expected,
+                              const Eigen::ArrayXXd& actual) {
+  Eigen::ArrayXXd x_perturbed = evaluate(stack, x * (1.0 + 1e-10),
+                                         constants);
+  Eigen::ArrayXXd c_perturbed = evaluate(stack, x,
+                                         constants * (1.0 + 1e-10));
+  for (int i = 0; i < expected.size(); ++i) {
+    double a = expected(i);
+    double b = actual(i);
+    if (a == b || (std::isnan(a) && std::isnan(b))) {
+      continue;
+    }
+    double scale = std::max(std::abs(a), 1.0);
+    double change = std::max(std::abs(x_perturbed(i) - a),
+                             std::abs(c_perturbed(i) - a));
+    if (!(change <= 1e-6 * scale)) {
+      continue;
+    }
+    if (!(std::abs(a - b) <= 1e-12 * scale + 1e-3 * change)) {
+      return false;
+    }
+  }
+  return expected.size() == actual.size();
+}
+
+class BytecodeTest : public ::testing::Test {
+ public:
+  Eigen::ArrayXXd x;
+  Eigen::VectorXd constants;
+
+  virtual void SetUp() {
+    x = testutils::one_to_nine_3_by_3();
+    constants = testutils::pi_ten_constants();
+  }
+  virtual void TearDown() {}
+};
+
+TEST_F(BytecodeTest, operators_match_interpreter) {
+  std::vector<Eigen::ArrayX3i> stacks;
+  stacks.push_back(testutils::stack_operators_0_to_5());
+  for (int op = 0; op < N_OPS; ++op) {
+    stacks.push_back(testutils::stack_unary_operator(op));
+    stacks.push_back(testutils::stack_unary_operator(op, 1));
+    stacks.push_back(testutils::stack_binary_operator(op));
+    stacks.push_back(testutils::stack_binary_operator(op, 1, 0));
+    stacks.push_back(testutils::stack_binary_operator(op, 1, 1));
+  }
+
+  for (std::size_t i = 0; i < stacks.size(); ++i) {
+    Program program = compile_stack(stacks[i]);
+    Eigen::ArrayXXd expected = simplify_and_evaluate(stacks[i], x, constants);
+    ASSERT_TRUE(testutils::almost_equal(expected,
+                                        evaluate(program, x, constants)));
+  }
+}
+
+TEST_F(BytecodeTest, fuses_superinstructions) {
+  // sin(C_0 * X_1 + X_0)
+  Eigen::ArrayX3i stack(6, 3);
+  stack << 0, 0, 0,
+           0, 1, 1,
+           1, 0, 0,
+           4, 2, 1,
+           2, 3, 0,
+           6, 4, 4;
+  Program program = compile_stack(stack);
+  ASSERT_EQ(program.instructions.size(), 1);
+  ASSERT_EQ(program.num_buffers, 1);
+  const Instruction& instruction = program.instructions[0];
+  ASSERT_EQ(instruction.code, MULTIPLY_ADD_OP);
+  ASSERT_EQ(instruction.unary_node, 6);
+  ASSERT_EQ(instruction.args[0].kind, CONSTANT_OPERAND);
+  ASSERT_EQ(instruction.args[1].kind, X_OPERAND);
+  ASSERT_EQ(instruction.args[2].kind, X_OPERAND);
+
+  Eigen::ArrayXXd expected = (constants[0] * x.col(1) + x.col(0)).sin();
+  ASSERT_TRUE(testutils::almost_equal(expected,
+                                      evaluate(program, x, constants)));
+}
+
+TEST_F(BytecodeTest, random_stacks_match_interpreter) {
+  AcyclicGraphManipulator manip = AcyclicGraphManipulator(3, 32, 2);
+  manip.rng.seed(rand());
+  for (int node = 2; node < N_OPS; ++node) {
+    manip.add_node_type(node);
+  }
+  Eigen::ArrayXXd large_x = Eigen::ArrayXXd::Random(300, 3) + 2.0;
+  Eigen::VectorXd large_constants = Eigen::VectorXd::Random(32);
+  EvaluationWorkspace workspace;
+  workspace.tile_size = 64;
+
+  for (int i = 0; i < 50; ++i) {
+    AcyclicGraph indv = manip.generate();
+    indv.count_constants();
+    Program program = compile_stack(indv.simple_stack);
+    Eigen::ArrayXXd expected = evaluate(indv.simple_stack, large_x,
+                                        large_constants);
+    evaluate(program, large_x, large_constants, workspace);
+    ASSERT_TRUE(equal_up_to_conditioning(indv.simple_stack, large_x,
+                                         large_constants, expected,
+                                         workspace.result()));
+  }
+}
+
+TEST_F(BytecodeTest, program_cached_on_individual) {
+  AcyclicGraph indv;
+  indv.simple_stack = testutils::stack_binary_operator(4);
+  indv.constants = constants;
+  indv.evaluate(x);
+  const Program* program = indv.program.get();
+
+  AcyclicGraph copy(indv);
+  copy.evaluate(x);
+  ASSERT_EQ(program, copy.program.get());
+
+  copy.simple_stack = testutils::stack_binary_operator(2);
+  Eigen::ArrayXXd expected = x.col(0) + constants[0];
+  ASSERT_TRUE(testutils::almost_equal(expected, copy.evaluate(x)));
+  ASSERT_NE(program, copy.program.get());
+  ASSERT_EQ(program, indv.program.get());
+}
+} // namespace
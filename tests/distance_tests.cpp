@@ -0,0 +1,77 @@
+#include <vector>
+
+#include <Eigen/Dense>
+#include "gtest/gtest.h"
+
+#include "BingoCpp/acyclic_graph.h"
+#include "BingoCpp/distance.h"
+#include "BingoCpp/graph_manip.h"
+#include "BingoCpp/population.h"
+#include "BingoCpp/thread_pool.h"
+
+using namespace bingo;
+namespace {
+
+void expect_manipulator_distances(AcyclicGraphManipulator &manip, int n) {
+  std::vector<AcyclicGraph> population;
+  Population packed(n, manip.ag_size);
+
+  for (int i = 0; i < n; ++i) {
+    population.push_back(manip.generate());
+    packed.set_individual(i, population.back());
+  }
+
+  ThreadPool pool(3);
+  Eigen::ArrayXXi distances = distance_matrix(population);
+  ASSERT_TRUE((distances == distance_matrix(population, STACK_DISTANCE,
+                                            pool)).all());
+  ASSERT_TRUE((distances == distance_matrix(packed)).all());
+
+  for (int i = 0; i < n; ++i) {
+    for (int j = 0; j < n; ++j) {
+      ASSERT_EQ(manip.distance(population[i], population[j]),
+                distances(i, j));
+    }
+  }
+}
+
+TEST(DistanceTest, matches_manipulator_distance) {
+  AcyclicGraphManipulator manip(3, 16, 1);
+  manip.add_node_type(2);
+  manip.add_node_type(6);
+  expect_manipulator_distances(manip, 150);
+
+  // parameters beyond a byte
+  AcyclicGraphManipulator large(3, 300, 1);
+  large.add_node_type(4);
+  expect_manipulator_distances(large, 20);
+}
+
+TEST(DistanceTest, utilized_distance_ignores_unused_fields) {
+  // sin(X_0) behind an unused C_0 load
+  Eigen::ArrayX3i stack(4, 3);
+  stack << 0, 0, 0,
+           1, -1, -1,
+           6, 0, 0,
+           3, 2, 2;
+  CompactPopulation population(4, 4);
+  population.stack(0) = stack.cast<int16_t>();
+  population.stack(1) = stack.cast<int16_t>();
+  population.set_command(1, 1, 0, 1, 1);
+  population.set_command(1, 2, 6, 0, 1);
+  population.stack(2) = stack.cast<int16_t>();
+  population.set_command(2, 2, 7, 0, 0);
+  population.stack(3) = stack.cast<int16_t>();
+  population.set_command(3, 3, 3, 2, 1);
+
+  Eigen::ArrayXXi stack_distances = distance_matrix(population);
+  Eigen::ArrayXXi utilized = distance_matrix(population, UTILIZED_DISTANCE);
+  ASSERT_EQ(4, stack_distances(0, 1));
+  ASSERT_EQ(0, utilized(0, 1));
+  ASSERT_EQ(1, utilized(0, 2));
+  // sin(X_0) - C_0 also reads C_0, which differs entirely
+  ASSERT_EQ(4, utilized(0, 3));
+  ASSERT_TRUE((utilized == utilized.transpose()).all());
+  ASSERT_TRUE((utilized.matrix().diagonal().array() == 0).all());
+}
+} // namespace
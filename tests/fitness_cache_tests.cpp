@@ -0,0 +1,138 @@
+#include <Eigen/Dense>
+#include "gtest/gtest.h"
+
+#include "BingoCpp/acyclic_graph.h"
+#include "BingoCpp/fitness_cache.h"
+#include "BingoCpp/fitness_metric.h"
+#include "BingoCpp/training_data.h"
+#include "testing_utils.h"
+
+using namespace bingo;
+namespace {
+
+// C_0 * X_0 + X_1 behind an unused command
+AcyclicGraph cache_test_individual() {
+  AcyclicGraph indv;
+  Eigen::ArrayX3i stack(6, 3);
+  stack << 0, 0, 0,
+           6, 0, 0,
+           1, -1, -1,
+           4, 2, 0,
+           0, 1, 1,
+           2, 3, 4;
+  indv.stack = stack;
+  indv.simple_stack = simplify_stack(stack);
+  return indv;
+}
+
+// training data the cache does not know how to hash
+struct OpaqueTrainingData : TrainingData {
+  OpaqueTrainingData* get_item(std::list<int>) {
+    return NULL;
+  }
+  int size() {
+    return 0;
+  }
+};
+
+class FitnessCacheTest : public ::testing::Test {
+ public:
+  ExplicitTrainingData train;
+
+  virtual void SetUp() {
+    Eigen::ArrayXXd x = Eigen::ArrayXXd::Random(20, 2);
+    Eigen::ArrayXXd y = 1.5 * x.col(0) + x.col(1);
+    train = ExplicitTrainingData(x, y);
+  }
+  virtual void TearDown() {}
+};
+
+TEST_F(FitnessCacheTest, key_follows_utilized_commands_and_constants) {
+  uint64_t dataset_id = training_data_hash(train);
+  AcyclicGraph indv = cache_test_individual();
+  AcyclicGraph other = cache_test_individual();
+  other.stack.row(1) << 7, 0, 0;
+  ASSERT_EQ(fitness_key(indv, dataset_id), fitness_key(other, dataset_id));
+
+  // the constants of an individual which needs optimization do not count
+  indv.count_constants();
+  other.count_constants();
+  other.set_constants(Eigen::VectorXd::Constant(1, 2.0));
+  ASSERT_TRUE(indv.needs_optimization());
+  ASSERT_FALSE(other.needs_optimization());
+  ASSERT_NE(fitness_key(indv, dataset_id), fitness_key(other, dataset_id));
+
+  indv.set_constants(Eigen::VectorXd::Constant(1, 2.0));
+  ASSERT_EQ(fitness_key(indv, dataset_id), fitness_key(other, dataset_id));
+  other.set_constants(Eigen::VectorXd::Constant(1, 3.0));
+  ASSERT_NE(fitness_key(indv, dataset_id), fitness_key(other, dataset_id));
+
+  ExplicitTrainingData shifted(train.x + 1.0, train.y);
+  ASSERT_NE(dataset_id, training_data_hash(shifted));
+}
+
+TEST_F(FitnessCacheTest, dataset_id_computed_once) {
+  ASSERT_EQ(0u, train.dataset_id);
+  uint64_t dataset_id = training_data_id(train);
+  ASSERT_EQ(training_data_hash(train), dataset_id);
+  ASSERT_EQ(dataset_id, train.dataset_id);
+
+  // changed in place, the data keeps its id until it is reset
+  train.x += 1.0;
+  ASSERT_EQ(dataset_id, training_data_id(train));
+  train.dataset_id = 0;
+  ASSERT_NE(dataset_id, training_data_id(train));
+
+  ExplicitTrainingData copy = train;
+  ASSERT_EQ(0u, copy.dataset_id);
+  ASSERT_EQ(train.dataset_id, training_data_id(copy));
+
+  OpaqueTrainingData opaque;
+  ASSERT_EQ(0u, training_data_id(opaque));
+}
+
+TEST_F(FitnessCacheTest, hit_skips_optimization) {
+  FitnessCache cache;
+  StandardRegression regression;
+  regression.fitness_cache = &cache;
+
+  AcyclicGraph indv = cache_test_individual();
+  double fitness = regression.evaluate_fitness(indv, train);
+  ASSERT_NEAR(0.0, fitness, 1e-6);
+  ASSERT_NEAR(1.5, indv.constants[0], 1e-6);
+  ASSERT_EQ(0u, cache.hits());
+  // before and after optimization
+  ASSERT_EQ(2u, cache.size());
+
+  AcyclicGraph child = cache_test_individual();
+  child.stack.row(1) << 8, 0, 0;
+  ASSERT_EQ(fitness, regression.evaluate_fitness(child, train));
+  ASSERT_EQ(1u, cache.hits());
+  ASSERT_FALSE(child.needs_optimization());
+  ASSERT_TRUE((indv.constants.array() == child.constants.array()).all());
+
+  ASSERT_EQ(fitness, regression.evaluate_fitness(indv, train));
+  ASSERT_EQ(2u, cache.hits());
+}
+
+TEST_F(FitnessCacheTest, least_recently_used_dropped) {
+  FitnessCache cache(2);
+  CachedFitness cached;
+  for (int key = 0; key < 3; ++key) {
+    cached.fitness = key;
+    cache.insert(key, cached);
+    if (key == 1) {
+      ASSERT_TRUE(cache.find(0, cached));
+    }
+  }
+
+  ASSERT_EQ(2u, cache.size());
+  ASSERT_FALSE(cache.find(1, cached));
+  ASSERT_TRUE(cache.find(0, cached));
+  ASSERT_EQ(0.0, cached.fitness);
+  ASSERT_TRUE(cache.find(2, cached));
+  ASSERT_EQ(2.0, cached.fitness);
+  ASSERT_EQ(3u, cache.hits());
+  ASSERT_EQ(1u, cache.misses());
+}
+} // namespace
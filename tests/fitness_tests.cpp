@@ -119,6 +119,59 @@ TEST(FitnessTest, explicit_evaluate_fitness) {
   ASSERT_NEAR(metric, 0, .001);
 }
 
+TEST(FitnessTest, evaluate_population_fitness) {
+  StandardRegression sr;
+  AcyclicGraphManipulator manip = AcyclicGraphManipulator(3, 12, 1);
+  manip.add_node_type(2);
+  manip.add_node_type(4);
+  manip.add_node_type(6);
+  std::vector<AcyclicGraph> population;
+
+  for (int i = 0; i < 16; ++i) {
+    population.push_back(manip.generate());
+  }
+
+  Eigen::ArrayXXd x(3, 3);
+  x << 1., 4., 7., 2., 5., 8., 3., 6., 9.;
+  Eigen::ArrayXXd y(3, 1);
+  y << 4.64, 8.28, 11.42;
+  ExplicitTrainingData ex = ExplicitTrainingData(x, y);
+  std::vector<AcyclicGraph> serial_population(population);
+  ThreadPool serial_pool(1);
+  ThreadPool parallel_pool(4);
+  srand(7);
+  std::vector<double> serial = sr.evaluate_population_fitness(
+                                 serial_population, ex, serial_pool);
+  srand(7);
+  std::vector<double> parallel = sr.evaluate_population_fitness(
+                                   population, ex, parallel_pool);
+  ASSERT_EQ(serial.size(), population.size());
+
+  for (std::size_t i = 0; i < population.size(); ++i) {
+    ASSERT_FALSE(population[i].needs_optimization());
+    ASSERT_EQ(serial[i], parallel[i]);
+    ASSERT_NEAR(parallel[i], sr.evaluate_fitness(population[i], ex), 1e-12);
+  }
+}
+
+TEST(FitnessTest, partitioned_evaluate_fitness_vector) {
+  StandardRegression sr;
+  AcyclicGraphManipulator manip = AcyclicGraphManipulator(3, 12, 1);
+  manip.add_node_type(2);
+  manip.add_node_type(4);
+  manip.add_node_type(6);
+  AcyclicGraph indv = manip.generate();
+  indv.set_constants(Eigen::VectorXd::Ones(indv.count_constants()));
+  Eigen::ArrayXXd x = Eigen::ArrayXXd::Random(9000, 3);
+  Eigen::ArrayXXd y = Eigen::ArrayXXd::Random(9000, 1);
+  ExplicitTrainingData ex = ExplicitTrainingData(x, y);
+  Eigen::ArrayXXd serial = sr.evaluate_fitness_vector(indv, ex);
+  ThreadPool pool(2);
+  sr.pool = &pool;
+  Eigen::ArrayXXd partitioned = sr.evaluate_fitness_vector(indv, ex);
+  ASSERT_TRUE((serial == partitioned).all());
+}
+
 TEST(FitnessTest, implicit_evaluate_fitness_vector) {
   ImplicitRegression ir;
   AcyclicGraph indv;
@@ -149,3 +202,121 @@ TEST(FitnessTest, implicit_evaluate_fitness_vector) {
   Eigen::ArrayXXd f = ir.evaluate_fitness_vector(indv, im);
   ASSERT_NEAR(f(0), 1, .001);
 }
+
+namespace {
+Eigen::ArrayXXd numerical_fitness_jacobian(FitnessMetric &fit,
+                                           AcyclicGraph &indv,
+                                           TrainingData &train) {
+  const double epsilon = 1e-6;
+  Eigen::VectorXd constants = indv.constants;
+  Eigen::ArrayXXd jacobian(train.size(), constants.size());
+
+  for (int k = 0; k < constants.size(); ++k) {
+    Eigen::VectorXd shifted = constants;
+    shifted[k] += epsilon;
+    indv.set_constants(shifted);
+    Eigen::ArrayXXd plus = fit.evaluate_fitness_vector(indv, train);
+    shifted[k] -= 2 * epsilon;
+    indv.set_constants(shifted);
+    Eigen::ArrayXXd minus = fit.evaluate_fitness_vector(indv, train);
+    jacobian.col(k) = (plus - minus) / (2 * epsilon);
+  }
+
+  indv.set_constants(constants);
+  return jacobian;
+}
+
+// y = x_0 * ( C_0 + C_1/x_1 ) - x_0
+AcyclicGraph jacobian_test_individual() {
+  AcyclicGraph indv;
+  Eigen::ArrayX3i stack(12, 3);
+  stack << 0, 0, 0,
+        0, 1, 1,
+        1, 0, 0,
+        1, 1, 1,
+        5, 3, 1,
+        5, 3, 1,
+        2, 4, 2,
+        2, 4, 2,
+        4, 6, 0,
+        4, 5, 6,
+        3, 7, 6,
+        3, 8, 0;
+  indv.stack = stack;
+  AcyclicGraphManipulator manip = AcyclicGraphManipulator(3, 12, 1);
+  manip.simplify_stack(indv);
+  Eigen::VectorXd constants(2);
+  constants << 3.14, 10.0;
+  indv.set_constants(constants);
+  return indv;
+}
+} // namespace
+
+TEST(FitnessTest, explicit_fitness_jacobian) {
+  StandardRegression sr;
+  AcyclicGraph indv = jacobian_test_individual();
+  Eigen::ArrayXXd x = Eigen::ArrayXXd::Random(20, 3) + 2.0;
+  Eigen::ArrayXXd y = Eigen::ArrayXXd::Random(20, 1);
+  ExplicitTrainingData ex = ExplicitTrainingData(x, y);
+  Eigen::MatrixXd jacobian;
+  ASSERT_TRUE(sr.evaluate_fitness_jacobian(indv, ex, jacobian));
+  Eigen::ArrayXXd expected = numerical_fitness_jacobian(sr, indv, ex);
+  ASSERT_TRUE(((expected - jacobian.array()).abs() <= 1e-5).all());
+}
+
+TEST(FitnessTest, implicit_fitness_jacobian) {
+  AcyclicGraph indv = jacobian_test_individual();
+  Eigen::ArrayXXd x = Eigen::ArrayXXd::Random(20, 3) + 2.0;
+  Eigen::ArrayXXd dx_dt = Eigen::ArrayXXd::Random(20, 3);
+  ImplicitTrainingData im = ImplicitTrainingData(x, dx_dt);
+
+  for (int normalize = 0; normalize < 2; ++normalize) {
+    ImplicitRegression ir(0, normalize == 1);
+    Eigen::MatrixXd jacobian;
+    ASSERT_TRUE(ir.evaluate_fitness_jacobian(indv, im, jacobian));
+    Eigen::ArrayXXd expected = numerical_fitness_jacobian(ir, indv, im);
+    ASSERT_TRUE(((expected - jacobian.array()).abs() <=
+                 1e-5 * expected.abs().max(1.0)).all());
+  }
+}
+
+TEST(FitnessTest, fused_evaluation_matches_separate_evaluations) {
+  StandardRegression sr;
+  AcyclicGraph indv = jacobian_test_individual();
+  Eigen::ArrayXXd x = Eigen::ArrayXXd::Random(20, 3) + 2.0;
+  Eigen::ArrayXXd y = Eigen::ArrayXXd::Random(20, 1);
+  ExplicitTrainingData ex = ExplicitTrainingData(x, y);
+  Eigen::ArrayXXd expected = sr.evaluate_fitness_vector(indv, ex);
+  Eigen::MatrixXd jacobian;
+  sr.evaluate_fitness_jacobian(indv, ex, jacobian);
+
+  FitnessEvaluation evaluation;
+  sr.evaluate_fused(indv, ex, true, evaluation);
+  ASSERT_TRUE(evaluation.has_jacobian);
+  ASSERT_TRUE(((expected - evaluation.residual).abs() <= 1e-12).all());
+  ASSERT_TRUE(((jacobian.array() - evaluation.jacobian).abs() <=
+               1e-12).all());
+  ASSERT_NEAR(expected.abs().mean(), evaluation.fitness, 1e-12);
+  ASSERT_NEAR(expected.abs().mean(), sr.evaluate_fitness(indv, ex), 1e-12);
+
+  sr.evaluate_fused(indv, ex, false, evaluation);
+  ASSERT_FALSE(evaluation.has_jacobian);
+  ASSERT_NEAR(expected.abs().mean(), evaluation.fitness, 1e-12);
+}
+
+TEST(FitnessTest, memo_shared_between_evaluations) {
+  StandardRegression sr;
+  SubexpressionMemo memo;
+  sr.memo = &memo;
+  AcyclicGraph indv = jacobian_test_individual();
+  Eigen::ArrayXXd x = Eigen::ArrayXXd::Random(20, 3) + 2.0;
+  Eigen::ArrayXXd y = Eigen::ArrayXXd::Random(20, 1);
+  ExplicitTrainingData ex = ExplicitTrainingData(x, y);
+  Eigen::ArrayXXd expected = sr.evaluate_fitness_vector(indv, ex);
+
+  ASSERT_NEAR(expected.abs().mean(), sr.evaluate_fitness(indv, ex), 1e-12);
+  ASSERT_EQ(0u, memo.statistics().hits);
+  AcyclicGraph copy(indv);
+  ASSERT_NEAR(expected.abs().mean(), sr.evaluate_fitness(copy, ex), 1e-12);
+  ASSERT_EQ(1u, memo.statistics().hits);
+}
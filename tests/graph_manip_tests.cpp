@@ -75,10 +75,168 @@ TEST_F(AGraphManipTest, generate) {
   ASSERT_DOUBLE_EQ(indv2.stack.rows(), 12);
 }
 
+TEST_F(AGraphManipTest, generate_batch_matches_generate) {
+  test_manip.add_node_type(2);
+  test_manip.add_node_type(6);
+  test_manip.rng.seed(5);
+  AcyclicGraphManipulator serial = test_manip;
+  AcyclicGraphManipulator single = test_manip;
+  ThreadPool pool(4);
+  Population population = test_manip.generate_batch(600, pool);
+  Population serial_population = serial.generate_batch(600);
+
+  ASSERT_EQ(600, population.size());
+  ASSERT_TRUE(population.commands() == serial_population.commands());
+  ASSERT_EQ(test_manip.rng(), serial.rng());
+
+  for (int i = 0; i < 256; ++i) {
+    AcyclicGraph indv = single.generate();
+    AcyclicGraph batch_indv = population.individual(i);
+    ASSERT_TRUE((indv.stack == batch_indv.stack).all());
+    ASSERT_TRUE((indv.simple_stack == batch_indv.simple_stack).all());
+    ASSERT_EQ(0, population.num_constants(i));
+  }
+}
+
+TEST_F(AGraphManipTest, generate_batch_numbers_constants) {
+  AcyclicGraphManipulator manip(3, 12, 1, 10.0, 0.5, 1);
+  manip.add_node_type(2);
+  manip.rng.seed(9);
+  AcyclicGraphManipulator single = manip;
+  Population population = manip.generate_batch(50);
+
+  for (int i = 0; i < population.size(); ++i) {
+    AcyclicGraph indv = single.generate();
+    AcyclicGraph batch_indv = population.individual(i);
+    ASSERT_TRUE((indv.stack == batch_indv.stack).all());
+    ASSERT_EQ(indv.constants.size(), population.num_constants(i));
+    ASSERT_EQ(indv.needs_optimization(), batch_indv.needs_optimization());
+  }
+}
+
+TEST_F(AGraphManipTest, generate_batch_applies_merge_and_rewrite) {
+  for (int rewrite = 0; rewrite < 2; ++rewrite) {
+    AcyclicGraphManipulator manip(3, 12, 1, 10.0, 0.5, rewrite ? 0 : 1);
+    manip.add_node_type(2);
+    manip.add_node_type(3);
+    manip.add_node_type(4);
+    manip.eliminate_common_subexpressions = !rewrite;
+    manip.rewrite_identities = rewrite;
+    manip.rng.seed(13);
+    AcyclicGraphManipulator single = manip;
+    Population population = manip.generate_batch(300);
+
+    for (int i = 0; i < 256; ++i) {
+      AcyclicGraph indv = single.generate();
+      AcyclicGraph batch_indv = population.individual(i);
+      ASSERT_TRUE((indv.stack == batch_indv.stack).all());
+      ASSERT_EQ(indv.simple_stack.rows(), batch_indv.simple_stack.rows());
+      ASSERT_TRUE((indv.simple_stack == batch_indv.simple_stack).all());
+    }
+  }
+}
+
 TEST_F(AGraphManipTest, simplify_stack) {
     ASSERT_DOUBLE_EQ(test_indv.simple_stack.rows(), 8);
 }
 
+TEST_F(AGraphManipTest, simplify_stack_merges_duplicates_when_enabled) {
+  AcyclicGraph indv;
+  indv.stack = Eigen::ArrayX3i(5, 3);
+  indv.stack << 0, 0, 0,
+                0, 0, 0,
+                6, 0, 0,
+                6, 1, 1,
+                4, 2, 3;
+  test_manip.simplify_stack(indv);
+  ASSERT_EQ(5, indv.simple_stack.rows());
+  Eigen::ArrayXXd expected = indv.evaluate(test_x_vals);
+
+  test_manip.eliminate_common_subexpressions = true;
+  test_manip.simplify_stack(indv);
+  ASSERT_EQ(3, indv.simple_stack.rows());
+  ASSERT_TRUE(testutils::almost_equal(expected, indv.evaluate(test_x_vals)));
+}
+
+TEST_F(AGraphManipTest, simplify_stack_rewrites_identities_when_enabled) {
+  AcyclicGraph indv;
+  indv.stack = Eigen::ArrayX3i(4, 3);
+  indv.stack << 0, 0, 0,
+                0, 1, 1,
+                3, 0, 0,
+                2, 1, 2;
+  test_manip.rewrite_identities = true;
+  test_manip.simplify_stack(indv);
+  ASSERT_EQ(1, indv.simple_stack.rows());
+  ASSERT_TRUE(testutils::almost_equal(test_x_vals.col(1),
+                                      indv.evaluate(test_x_vals)));
+}
+
+TEST_F(AGraphManipTest, merged_stack_constants_numbered_in_stack) {
+  // (X_0 + X_0) * C_0 + X_1 with a duplicated X_0 load
+  AcyclicGraph indv;
+  indv.stack = Eigen::ArrayX3i(7, 3);
+  indv.stack << 0, 0, 0,
+                0, 1, 1,
+                0, 0, 0,
+                1, -1, -1,
+                2, 0, 2,
+                4, 4, 3,
+                2, 5, 1;
+  Eigen::ArrayX3i loads = indv.stack.topRows(3);
+  test_manip.eliminate_common_subexpressions = true;
+  test_manip.simplify_stack(indv);
+  ASSERT_EQ(6, indv.simple_stack.rows());
+  ASSERT_TRUE(indv.needs_optimization());
+
+  ASSERT_EQ(1, indv.count_constants());
+  ASSERT_TRUE((loads == indv.stack.topRows(3)).all());
+  ASSERT_EQ(0, indv.stack(3, 1));
+  ASSERT_EQ(0, indv.stack(3, 2));
+  for (int i = 0; i < indv.simple_stack.rows(); ++i) {
+    if (indv.simple_stack(i, 0) == 1) {
+      ASSERT_EQ(0, indv.simple_stack(i, 1));
+    }
+  }
+
+  indv.set_constants(Eigen::VectorXd::Constant(1, 2.0));
+  ASSERT_FALSE(indv.needs_optimization());
+  Eigen::ArrayXXd expected = 2.0 * (test_x_vals.col(0) + test_x_vals.col(0)) +
+                             test_x_vals.col(1);
+  ASSERT_TRUE(testutils::almost_equal(expected, indv.evaluate(test_x_vals)));
+}
+
+TEST_F(AGraphManipTest, rewritten_stack_constants_numbered_in_stack) {
+  // |X_0| * C_0 * C_1 through a redundant abs, then a new constant
+  AcyclicGraph indv;
+  indv.stack = Eigen::ArrayX3i(7, 3);
+  indv.stack << 0, 0, 0,
+                11, 0, 0,
+                11, 1, 1,
+                1, -1, -1,
+                4, 2, 3,
+                1, -1, -1,
+                4, 4, 5;
+  test_manip.rewrite_identities = true;
+  test_manip.simplify_stack(indv);
+  ASSERT_EQ(6, indv.simple_stack.rows());
+
+  ASSERT_EQ(2, indv.count_constants());
+  ASSERT_EQ(1, indv.stack(2, 1));
+  ASSERT_EQ(0, indv.stack(3, 1));
+  ASSERT_EQ(1, indv.stack(5, 1));
+  indv.set_constants(Eigen::Vector2d(2.0, 3.0));
+  ASSERT_FALSE(indv.needs_optimization());
+  Eigen::ArrayXXd expected = 6.0 * test_x_vals.col(0).abs();
+  ASSERT_TRUE(testutils::almost_equal(expected, indv.evaluate(test_x_vals)));
+
+  indv.stack.row(5) << 1, -1, -1;
+  test_manip.simplify_stack(indv);
+  ASSERT_TRUE(indv.needs_optimization());
+  ASSERT_EQ(2, indv.count_constants());
+  ASSERT_EQ(1, indv.stack(5, 1));
+}
+
 TEST_F(AGraphManipTest, dump) {
   std::pair<std::pair<Eigen::ArrayX3i, Eigen::VectorXd>, int> temp = test_manip.dump(
         test_indv);
@@ -177,6 +335,138 @@ TEST_F(AGraphManipTest, mutation) {
   EXPECT_FALSE(all_match);
 }
 
+TEST_F(AGraphManipTest, seeded_manipulators_reproduce_variation) {
+  test_manip.add_node_type(2);
+  test_manip.add_node_type(6);
+  AcyclicGraphManipulator copy = test_manip;
+  test_manip.rng.seed(11);
+  copy.rng.seed(11);
+
+  for (int i = 0; i < 20; ++i) {
+    AcyclicGraph parent1 = test_manip.generate();
+    AcyclicGraph parent2 = test_manip.generate();
+    ASSERT_TRUE((parent1.stack == copy.generate().stack).all());
+    ASSERT_TRUE((parent2.stack == copy.generate().stack).all());
+    std::vector<AcyclicGraph> children = test_manip.crossover(parent1,
+                                         parent2);
+    std::vector<AcyclicGraph> copy_children = copy.crossover(parent1,
+        parent2);
+    ASSERT_TRUE((children[0].stack == copy_children[0].stack).all());
+    ASSERT_TRUE((test_manip.mutation(children[1]).stack ==
+                 copy.mutation(copy_children[1]).stack).all());
+  }
+}
+
+TEST_F(AGraphManipTest, variation_into_existing_children) {
+  test_manip.add_node_type(2);
+  test_manip.add_node_type(4);
+  test_manip.rng.seed(3);
+  AcyclicGraphManipulator copy = test_manip;
+  AcyclicGraph parent1 = test_manip.generate();
+  AcyclicGraph parent2 = test_manip.generate();
+  copy.generate();
+  copy.generate();
+  AcyclicGraph child1 = test_manip.generate();
+  AcyclicGraph child2 = test_manip.generate();
+  copy.generate();
+  copy.generate();
+  const int* child1_stack = child1.stack.data();
+  const int* child2_stack = child2.stack.data();
+
+  for (int i = 0; i < 10; ++i) {
+    std::vector<AcyclicGraph> children = copy.crossover(parent1, parent2);
+    test_manip.crossover(parent1, parent2, child1, child2);
+    ASSERT_TRUE((children[0].stack == child1.stack).all());
+    ASSERT_TRUE((children[1].stack == child2.stack).all());
+
+    AcyclicGraph mutant = copy.mutation(children[0]);
+    test_manip.mutation(child1, child2);
+    ASSERT_TRUE((mutant.stack == child2.stack).all());
+    ASSERT_TRUE((mutant.simple_stack == child2.simple_stack).all());
+    ASSERT_EQ(child1_stack, child1.stack.data());
+    ASSERT_EQ(child2_stack, child2.stack.data());
+  }
+}
+
+TEST_F(AGraphManipTest, batched_variation_follows_indices) {
+  test_manip.add_node_type(2);
+  test_manip.add_node_type(4);
+  test_manip.rng.seed(4);
+  std::vector<AcyclicGraph> population;
+
+  for (int i = 0; i < 6; ++i) {
+    population.push_back(test_manip.generate());
+  }
+
+  std::vector<std::pair<int, int> > pairs;
+  pairs.push_back(std::make_pair(0, 5));
+  pairs.push_back(std::make_pair(3, 1));
+  std::vector<int> indices(1, 2);
+  AcyclicGraphManipulator copy = test_manip;
+  std::vector<AcyclicGraph> children;
+  std::vector<AcyclicGraph> mutants;
+  test_manip.crossover_batch(population, pairs, children);
+  test_manip.mutation_batch(population, indices, mutants);
+
+  ASSERT_EQ(4u, children.size());
+  ASSERT_EQ(1u, mutants.size());
+  for (std::size_t k = 0; k < pairs.size(); ++k) {
+    std::vector<AcyclicGraph> expected = copy.crossover(
+        population[pairs[k].first], population[pairs[k].second]);
+    ASSERT_TRUE((expected[0].stack == children[2 * k].stack).all());
+    ASSERT_TRUE((expected[1].stack == children[2 * k + 1].stack).all());
+  }
+  AcyclicGraph parent = population[2];
+  ASSERT_TRUE((copy.mutation(parent).stack == mutants[0].stack).all());
+}
+
+TEST_F(AGraphManipTest, neutral_variation_inherits_fitness) {
+  test_indv.fitness = std::vector<double>(1, 0.5);
+  test_indv.fit_set = true;
+  AcyclicGraph child = AcyclicGraph(test_indv);
+  child.stack.row(9) << 4, 5, 5;
+  child.fit_set = false;
+  test_manip.simplify_stack(child);
+  ASSERT_TRUE(test_manip.inherit_fitness(child, test_indv));
+  ASSERT_TRUE(child.fit_set);
+  ASSERT_DOUBLE_EQ(0.5, child.fitness[0]);
+
+  // a constant the child reads differs
+  child.fit_set = false;
+  child.constants(1) += 1.0;
+  ASSERT_FALSE(test_manip.inherit_fitness(child, test_indv));
+  ASSERT_FALSE(child.fit_set);
+
+  // a command the child utilizes differs
+  child = AcyclicGraph(test_indv);
+  child.stack.row(8) << 4, 6, 1;
+  test_manip.simplify_stack(child);
+  ASSERT_FALSE(test_manip.inherit_fitness(child, test_indv));
+}
+
+TEST_F(AGraphManipTest, inherited_fitness_brings_optimized_constants) {
+  test_indv.fitness = std::vector<double>(1, 0.5);
+  test_indv.fit_set = true;
+  AcyclicGraph child = AcyclicGraph(test_indv);
+  child.constants = Eigen::VectorXd(0);
+  child.fit_set = false;
+  ASSERT_TRUE(child.needs_optimization());
+
+  ASSERT_TRUE(test_manip.inherit_fitness(child, test_indv));
+  ASSERT_FALSE(child.needs_optimization());
+  ASSERT_TRUE((test_indv.constants.array() == child.constants.array()).all());
+
+  // crossover of an individual with itself is neutral
+  std::vector<AcyclicGraph> children = test_manip.crossover(test_indv,
+                                                            test_indv);
+  ASSERT_TRUE(children[0].fit_set);
+  ASSERT_TRUE(children[1].fit_set);
+
+  test_manip.inherit_equivalent_fitness = false;
+  children = test_manip.crossover(test_indv, test_indv);
+  ASSERT_FALSE(children[0].fit_set);
+}
+
 TEST_F(AGraphManipTest, zero_distance) {
   AcyclicGraph indv2 = AcyclicGraph(test_indv);
   ASSERT_DOUBLE_EQ(test_manip.distance(test_indv, indv2), 0);
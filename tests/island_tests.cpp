@@ -0,0 +1,152 @@
+#include <vector>
+
+#include <Eigen/Dense>
+#include "gtest/gtest.h"
+
+#include "BingoCpp/acyclic_graph.h"
+#include "BingoCpp/fitness_metric.h"
+#include "BingoCpp/graph_manip.h"
+#include "BingoCpp/island.h"
+#include "BingoCpp/thread_pool.h"
+#include "BingoCpp/training_data.h"
+
+using namespace bingo;
+namespace {
+
+class IslandTest : public ::testing::Test {
+ public:
+  ExplicitTrainingData train;
+  StandardRegression regression;
+  AcyclicGraphManipulator manip;
+
+  virtual void SetUp() {
+    Eigen::ArrayXXd x = Eigen::ArrayXXd::Random(30, 2);
+    Eigen::ArrayXXd y = x.col(0) * x.col(1) + x.col(0);
+    train = ExplicitTrainingData(x, y);
+    manip = AcyclicGraphManipulator(2, 12, 2);
+    manip.add_node_type(2);
+    manip.add_node_type(3);
+    manip.add_node_type(4);
+    manip.rng.seed(1);
+  }
+  virtual void TearDown() {}
+
+  Island make_island(int size) {
+    std::vector<AcyclicGraph> population;
+
+    for (int i = 0; i < size; ++i) {
+      population.push_back(manip.generate());
+    }
+
+    Island island(population, manip, regression, train);
+    island.mutation_probability = 0.3;
+    return island;
+  }
+};
+
+double fitness_of_best(const Island &island) {
+  return island.population[island.best_individual()].fitness[0];
+}
+
+TEST_F(IslandTest, crowding_never_loses_the_best) {
+  ThreadPool pool(2);
+  Island island = make_island(16);
+  island.evaluate(pool);
+  ASSERT_EQ(16, island.fitness_evaluations);
+  double best = fitness_of_best(island);
+
+  for (int i = 0; i < 10; ++i) {
+    island.step(pool);
+    ASSERT_EQ(16u, island.population.size());
+    ASSERT_LE(fitness_of_best(island), best);
+    best = fitness_of_best(island);
+  }
+
+  ASSERT_EQ(10, island.generation);
+  ASSERT_GT(island.fitness_evaluations, 16);
+}
+
+TEST_F(IslandTest, ring_migration_sends_the_best_to_the_next_island) {
+  ThreadPool pool(3);
+  std::vector<Island> islands;
+
+  for (int k = 0; k < 3; ++k) {
+    islands.push_back(make_island(8));
+    islands.back().evaluate(pool);
+  }
+
+  Archipelago archipelago(islands, RING_MIGRATION, 5, 1, 7);
+  std::vector<double> best(3);
+  for (int k = 0; k < 3; ++k) {
+    best[k] = fitness_of_best(archipelago.islands[k]);
+  }
+  archipelago.migrate(pool);
+
+  for (int k = 0; k < 3; ++k) {
+    bool received = false;
+    for (std::size_t i = 0; i < 8; ++i) {
+      received |= archipelago.islands[k].population[i].fitness[0] ==
+                  best[(k + 2) % 3];
+    }
+    ASSERT_TRUE(received);
+    ASSERT_LE(fitness_of_best(archipelago.islands[k]), best[(k + 2) % 3]);
+  }
+}
+
+TEST_F(IslandTest, archipelago_evolves_every_island) {
+  ThreadPool pool(4);
+  std::vector<Island> islands;
+
+  for (int k = 0; k < 4; ++k) {
+    islands.push_back(make_island(8));
+  }
+
+  Archipelago archipelago(islands, FULLY_CONNECTED_MIGRATION, 3, 2);
+  archipelago.migrant_selection = RANDOM_MIGRANTS;
+  archipelago.evolve(7, pool);
+  long evaluations = 0;
+
+  for (int k = 0; k < 4; ++k) {
+    ASSERT_EQ(7, archipelago.islands[k].generation);
+    ASSERT_EQ(8u, archipelago.islands[k].population.size());
+    evaluations += archipelago.islands[k].fitness_evaluations;
+  }
+
+  ASSERT_EQ(evaluations, archipelago.fitness_evaluations());
+  AcyclicGraph best = archipelago.best_individual();
+  ASSERT_TRUE(best.fit_set);
+  for (int k = 0; k < 4; ++k) {
+    ASSERT_LE(best.fitness[0], fitness_of_best(archipelago.islands[k]));
+  }
+}
+
+TEST_F(IslandTest, evolution_independent_of_thread_count) {
+  manip = AcyclicGraphManipulator(2, 12, 2, 10.0, 0.5, 1);
+  manip.add_node_type(2);
+  manip.add_node_type(4);
+  manip.rng.seed(3);
+  std::vector<Island> islands;
+
+  for (int k = 0; k < 3; ++k) {
+    islands.push_back(make_island(6));
+  }
+
+  Archipelago serial(islands, RING_MIGRATION, 2, 1, 11);
+  Archipelago parallel(islands, RING_MIGRATION, 2, 1, 11);
+  ThreadPool one_thread(1);
+  ThreadPool three_threads(3);
+  serial.evolve(5, one_thread);
+  parallel.evolve(5, three_threads);
+
+  for (int k = 0; k < 3; ++k) {
+    for (std::size_t i = 0; i < 6; ++i) {
+      const AcyclicGraph &expected = serial.islands[k].population[i];
+      const AcyclicGraph &actual = parallel.islands[k].population[i];
+      ASSERT_TRUE((expected.stack == actual.stack).all());
+      ASSERT_EQ(expected.constants.size(), actual.constants.size());
+      ASSERT_TRUE((expected.constants.array() ==
+                   actual.constants.array()).all());
+    }
+  }
+}
+} // namespace
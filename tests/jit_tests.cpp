@@ -0,0 +1,165 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+
+#include <sys/stat.h>
+
+#include <Eigen/Dense>
+#include "gtest/gtest.h"
+
+#include "BingoCpp/acyclic_graph.h"
+#include "BingoCpp/backend.h"
+#include "BingoCpp/jit.h"
+#include "testing_utils.h"
+#include "test_fixtures.h"
+
+using namespace bingo;
+namespace {
+
+bool relatively_equal(const Eigen::ArrayXXd& expected,
+                      const Eigen::ArrayXXd& actual) {
+  for (int i = 0; i < expected.size(); ++i) {
+    double a = expected(i);
+    double b = actual(i);
+    if (!(a == b || (std::isnan(a) && std::isnan(b)) ||
+          std::abs(a - b) <= 1e-12 * std::max(std::abs(a), 1.0))) {
+      return false;
+    }
+  }
+  return expected.size() == actual.size();
+}
+
+class JitTest : public ::testing::Test {
+ public:
+  Eigen::ArrayXXd x;
+  Eigen::VectorXd constants;
+  JitOptions options;
+
+  virtual void SetUp() {
+    x = testutils::one_to_nine_3_by_3();
+    constants = testutils::pi_ten_constants();
+    // spaces reach the compiler as part of one argument
+    options.cache_directory = "/tmp/bingo jit tests";
+  }
+  virtual void TearDown() {}
+
+  // sqrt(|log|pow(|sin(X_0)|, C_0)||) * |exp(cos(X_1))| / X_1 - C_0
+  Eigen::ArrayX3i unary_operator_stack() {
+    Eigen::ArrayX3i stack(13, 3);
+    stack << 0, 0, 0,
+             0, 1, 1,
+             1, 0, 0,
+             6, 0, 0,
+             7, 1, 1,
+             10, 3, 2,
+             8, 4, 4,
+             9, 5, 5,
+             11, 6, 6,
+             12, 7, 7,
+             4, 9, 8,
+             5, 10, 1,
+             3, 11, 2;
+    return stack;
+  }
+
+  void expect_matches_interpreter(const Eigen::ArrayX3i& stack) {
+    std::shared_ptr<const JitKernel> kernel = jit_compile(stack, options);
+    if (!kernel) {
+      std::printf("no compiler for the native backend; skipping\n");
+      return;
+    }
+
+    ASSERT_TRUE(relatively_equal(evaluate(stack, x, constants),
+                                 evaluate(*kernel, x, constants)));
+    for (int wrt_x = 0; wrt_x < 2; ++wrt_x) {
+      std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd> expected =
+        evaluate_with_derivative(stack, x, constants, wrt_x == 1);
+      std::pair<Eigen::ArrayXXd, Eigen::ArrayXXd> actual =
+        evaluate_with_derivative(*kernel, x, constants, wrt_x == 1);
+      ASSERT_TRUE(relatively_equal(expected.first, actual.first));
+      ASSERT_TRUE(relatively_equal(expected.second, actual.second));
+    }
+  }
+};
+
+TEST_F(JitTest, binary_operators_match_interpreter) {
+  expect_matches_interpreter(testutils::stack_operators_0_to_5());
+}
+
+TEST_F(JitTest, unary_operators_match_interpreter) {
+  expect_matches_interpreter(unary_operator_stack());
+}
+
+TEST_F(JitTest, kernels_cached_by_structure) {
+  Eigen::ArrayX3i stack = unary_operator_stack();
+  // the same commands behind an unused one
+  Eigen::ArrayX3i padded(stack.rows() + 1, 3);
+  padded.row(0) << 0, 2, 2;
+  for (int row = 0; row < stack.rows(); ++row) {
+    padded.row(row + 1) = stack.row(row);
+    if (!AcyclicGraph::is_terminal(stack(row, 0))) {
+      padded(row + 1, 1) += 1;
+      padded(row + 1, 2) += 1;
+    }
+  }
+  ASSERT_EQ(structural_hash(stack), structural_hash(padded));
+  ASSERT_NE(structural_hash(stack),
+            structural_hash(testutils::stack_operators_0_to_5()));
+
+  std::shared_ptr<const JitKernel> kernel = jit_compile(stack, options);
+  if (!kernel) {
+    return;
+  }
+  std::shared_ptr<const JitKernel> cached = jit_compile(padded, options);
+  ASSERT_TRUE(static_cast<bool>(cached));
+  ASSERT_TRUE(cached->is_compiled_from(padded));
+  ASSERT_FALSE(cached->is_compiled_from(stack));
+  ASSERT_TRUE(relatively_equal(evaluate(*kernel, x, constants),
+                               evaluate(*cached, x, constants)));
+}
+
+TEST_F(JitTest, shared_cache_directory_refused) {
+  options.cache_directory = "/tmp/bingo_jit_tests_shared";
+  mkdir(options.cache_directory.c_str(), 0700);
+  chmod(options.cache_directory.c_str(), 0777);
+  ASSERT_FALSE(static_cast<bool>(jit_compile(unary_operator_stack(),
+                                             options)));
+
+  chmod(options.cache_directory.c_str(), 0700);
+  std::shared_ptr<const JitKernel> kernel =
+    jit_compile(unary_operator_stack(), options);
+  if (!kernel) {
+    return;
+  }
+  // a cached object which others could have written is not loaded
+  char name[32];
+  std::snprintf(name, sizeof(name), "/bingo_%016llx.so",
+                static_cast<unsigned long long>(
+                  structural_hash(unary_operator_stack())));
+  std::string path = options.cache_directory + name;
+  kernel.reset();
+  chmod(path.c_str(), 0666);
+  ASSERT_FALSE(static_cast<bool>(jit_compile(unary_operator_stack(),
+                                             options)));
+  std::remove(path.c_str());
+}
+
+TEST_F(JitTest, individual_uses_native_kernel) {
+  AcyclicGraph indv;
+  indv.simple_stack = testutils::stack_operators_0_to_5();
+  indv.constants = constants;
+  if (!indv.compile_native(options)) {
+    return;
+  }
+
+  Eigen::ArrayXXd expected = evaluate(*indv.native_kernel, x, constants);
+  AcyclicGraph copy(indv);
+  ASSERT_EQ(indv.native_kernel, copy.native_kernel);
+  ASSERT_TRUE(relatively_equal(expected, copy.evaluate(x)));
+
+  copy.simple_stack = testutils::stack_binary_operator(2);
+  ASSERT_TRUE(testutils::almost_equal(x.col(0) + constants[0],
+                                      copy.evaluate(x)));
+}
+} // namespace
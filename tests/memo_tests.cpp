@@ -0,0 +1,103 @@
+#include <vector>
+
+#include <Eigen/Dense>
+#include "gtest/gtest.h"
+
+#include "BingoCpp/backend.h"
+#include "BingoCpp/memo.h"
+#include "testing_utils.h"
+#include "test_fixtures.h"
+
+using namespace bingo;
+namespace {
+
+class MemoTest : public ::testing::Test {
+ public:
+  Eigen::ArrayXXd x;
+  Eigen::VectorXd constants;
+
+  virtual void SetUp() {
+    x = testutils::one_to_nine_3_by_3();
+    constants = testutils::pi_ten_constants();
+  }
+  virtual void TearDown() {}
+};
+
+TEST_F(MemoTest, values_match_plain_evaluation) {
+  Eigen::ArrayX3i stack = testutils::stack_operators_0_to_5();
+  SubexpressionMemo memo;
+  ASSERT_TRUE(testutils::almost_equal(evaluate(stack, x, constants),
+                                      evaluate(stack, x, constants, memo)));
+  // the four utilized operators
+  ASSERT_EQ(0u, memo.statistics().hits);
+  ASSERT_EQ(4u, memo.statistics().misses);
+  ASSERT_EQ(4u, memo.statistics().entries);
+
+  // the result itself is found
+  memo.reset_statistics();
+  ASSERT_TRUE(testutils::almost_equal(evaluate(stack, x, constants),
+                                      evaluate(stack, x, constants, memo)));
+  ASSERT_EQ(1u, memo.statistics().hits);
+  ASSERT_EQ(0u, memo.statistics().misses);
+
+  // new constants are new subgraphs
+  constants[1] = 2.5;
+  ASSERT_TRUE(testutils::almost_equal(evaluate(stack, x, constants),
+                                      evaluate(stack, x, constants, memo)));
+  ASSERT_EQ(8u, memo.statistics().entries);
+
+  // and so are new samples
+  x *= 2.0;
+  ASSERT_TRUE(testutils::almost_equal(evaluate(stack, x, constants),
+                                      evaluate(stack, x, constants, memo)));
+  ASSERT_EQ(12u, memo.statistics().entries);
+}
+
+TEST_F(MemoTest, population_shares_subgraphs) {
+  // X_0 * X_1 + C_0 and sin(X_1 * X_0)
+  std::vector<Eigen::ArrayX3i> stacks(2, Eigen::ArrayX3i(5, 3));
+  stacks[0] << 0, 0, 0,
+               0, 1, 1,
+               4, 0, 1,
+               1, 0, 0,
+               2, 2, 3;
+  stacks[1] << 0, 1, 1,
+               0, 0, 0,
+               4, 0, 1,
+               6, 2, 2,
+               6, 2, 2;
+  std::vector<Eigen::VectorXd> population_constants(2, constants);
+
+  SubexpressionMemo memo;
+  ASSERT_TRUE(testutils::almost_equal(
+      evaluate_population(stacks, x, population_constants),
+      evaluate_population(stacks, x, population_constants, memo)));
+  MemoStatistics statistics = memo.statistics();
+  ASSERT_EQ(1u, statistics.hits);
+  ASSERT_EQ(3u, statistics.misses);
+  ASSERT_EQ(3u, statistics.entries);
+  ASSERT_DOUBLE_EQ(0.25, statistics.hit_rate());
+}
+
+TEST_F(MemoTest, least_recently_used_evicted) {
+  Eigen::ArrayXXd value = x.col(0);
+  std::size_t bytes = sizeof(Eigen::ArrayXXd) + value.size() * sizeof(double);
+  SubexpressionMemo memo(2 * bytes);
+  memo.insert(1, value);
+  memo.insert(2, value + 1.0);
+  ASSERT_TRUE(static_cast<bool>(memo.find(1)));
+  memo.insert(3, value + 2.0);
+
+  ASSERT_FALSE(static_cast<bool>(memo.find(2)));
+  ASSERT_TRUE(testutils::almost_equal(value, *memo.find(1)));
+  ASSERT_TRUE(testutils::almost_equal(value + 2.0, *memo.find(3)));
+  MemoStatistics statistics = memo.statistics();
+  ASSERT_EQ(1u, statistics.evictions);
+  ASSERT_EQ(2u, statistics.entries);
+  ASSERT_EQ(2 * bytes, statistics.bytes);
+
+  memo.clear();
+  ASSERT_EQ(0u, memo.statistics().entries);
+  ASSERT_FALSE(static_cast<bool>(memo.find(1)));
+}
+} // namespace
@@ -0,0 +1,116 @@
+#include <stdint.h>
+
+#include <Eigen/Dense>
+#include "gtest/gtest.h"
+
+#include "BingoCpp/acyclic_graph.h"
+#include "BingoCpp/population.h"
+#include "test_fixtures.h"
+
+using namespace bingo;
+namespace {
+
+AcyclicGraph population_test_individual() {
+  AcyclicGraph indv;
+  indv.stack = testutils::stack_operators_0_to_5();
+  indv.simple_stack = simplify_stack(indv.stack);
+  indv.constants = testutils::pi_ten_constants();
+  indv.fitness = std::vector<double>(1, 0.5);
+  indv.fit_set = true;
+  indv.genetic_age = 3;
+  return indv;
+}
+
+TEST(PopulationTest, individual_round_trip) {
+  AcyclicGraph indv = population_test_individual();
+  Population population(3, indv.stack.rows());
+  population.set_individual(1, indv);
+
+  ASSERT_EQ(3, population.size());
+  ASSERT_EQ(3u * 12 * 3, population.commands().size());
+  ASSERT_EQ(0, population.num_constants(0));
+  ASSERT_EQ(2, population.num_constants(1));
+  ASSERT_TRUE((population.stack(0) == 0).all());
+
+  AcyclicGraph copy = population.individual(1);
+  ASSERT_TRUE((indv.stack == copy.stack).all());
+  ASSERT_TRUE((indv.constants.array() == copy.constants.array()).all());
+  ASSERT_TRUE(copy.fit_set);
+  ASSERT_EQ(0.5, copy.fitness[0]);
+  ASSERT_EQ(3, copy.genetic_age);
+
+  Eigen::ArrayXXd x = Eigen::ArrayXXd::Random(10, 2);
+  ASSERT_TRUE((indv.evaluate(x) == copy.evaluate(x)).all());
+}
+
+TEST(PopulationTest, crossover_exchanges_tails) {
+  AcyclicGraph indv = population_test_individual();
+  AcyclicGraph other = population_test_individual();
+  // the same commands with the constants numbered the other way round
+  other.stack.row(2) << 1, 1, 1;
+  other.stack.row(3) << 1, 0, 0;
+  other.constants = Eigen::Vector2d(1.0, 2.0);
+  Population population(3, indv.stack.rows());
+  population.set_individual(0, indv);
+  population.set_individual(1, other);
+  population.genetic_age[1] = 5;
+  Population::StackArray parent1 = population.stack(0);
+  Population::StackArray parent2 = population.stack(1);
+
+  population.crossover(0, 1, 0, 1, 3);
+  ASSERT_TRUE((population.stack(0).col(0) == parent1.col(0)).all());
+  ASSERT_TRUE((population.stack(0).bottomRows(8) ==
+               parent2.bottomRows(8)).all());
+  ASSERT_TRUE((population.stack(1).bottomRows(8) ==
+               parent1.bottomRows(8)).all());
+  // the constant swapped in at row 3 keeps the value of its parent
+  ASSERT_EQ(0, population.stack(0)(2, 1));
+  ASSERT_EQ(1, population.stack(0)(3, 1));
+  ASSERT_EQ(0, population.stack(1)(2, 1));
+  ASSERT_EQ(1, population.stack(1)(3, 1));
+  ASSERT_EQ(3.14, population.constants(0)(0));
+  ASSERT_EQ(1.0, population.constants(0)(1));
+  ASSERT_EQ(2.0, population.constants(1)(0));
+  ASSERT_EQ(10.0, population.constants(1)(1));
+  ASSERT_FALSE(population.needs_opt[0]);
+  ASSERT_FALSE(population.needs_opt[1]);
+  ASSERT_FALSE(population.fit_set[0]);
+  ASSERT_EQ(5, population.genetic_age[0]);
+  ASSERT_EQ(5, population.genetic_age[1]);
+
+  // a constant which was never numbered has no value yet
+  population.set_individual(2, indv);
+  population.set_command(2, 3, 1, -1, -1);
+  population.crossover(0, 2, 0, 2, 3);
+  ASSERT_EQ(3.14, population.constants(0)(0));
+  ASSERT_EQ(0.0, population.constants(0)(1));
+  ASSERT_TRUE(population.needs_opt[0]);
+  ASSERT_EQ(3.14, population.constants(2)(0));
+  ASSERT_EQ(1.0, population.constants(2)(1));
+  ASSERT_FALSE(population.needs_opt[2]);
+}
+
+TEST(PopulationTest, compact_constants_resize_in_place) {
+  AcyclicGraph indv = population_test_individual();
+  CompactPopulation population(3, indv.stack.rows());
+  for (int i = 0; i < population.size(); ++i) {
+    population.set_individual(i, indv);
+  }
+  ASSERT_EQ(3u * 12 * 3 * sizeof(int16_t),
+            population.commands().size() * sizeof(int16_t));
+
+  population.set_constants(1, Eigen::VectorXd::Constant(4, 1.0));
+  population.copy_individual(1, 0);
+  population.set_command(2, 11, 3, 9, 0);
+
+  ASSERT_EQ(4, population.num_constants(0));
+  ASSERT_EQ(4, population.num_constants(1));
+  ASSERT_TRUE((population.constants(0).array() == 1.0).all());
+  ASSERT_TRUE((population.constants(2).array() ==
+               indv.constants.array()).all());
+  ASSERT_FALSE(population.fit_set[2]);
+  AcyclicGraph changed = population.individual(2);
+  ASSERT_EQ(9, changed.stack(11, 1));
+  ASSERT_TRUE((indv.stack.topRows(11) == changed.stack.topRows(11)).all());
+}
+} // namespace
@@ -0,0 +1,63 @@
+#include <stdint.h>
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "BingoCpp/random.h"
+
+using namespace bingo;
+namespace {
+
+TEST(RandomTest, seed_determines_stream) {
+  Xoshiro256 rng(42);
+  Xoshiro256 same(7);
+  same.seed(42);
+  Xoshiro256 other(43);
+  int differences = 0;
+
+  for (int i = 0; i < 100; ++i) {
+    uint64_t value = rng();
+    ASSERT_EQ(value, same());
+    differences += value != other();
+  }
+
+  ASSERT_EQ(100, differences);
+}
+
+TEST(RandomTest, jump_gives_distinct_reproducible_streams) {
+  Xoshiro256 base(1);
+  Xoshiro256 stream1 = base;
+  stream1.jump();
+  Xoshiro256 stream2 = stream1;
+  stream2.jump();
+  Xoshiro256 again(1);
+  again.jump();
+
+  for (int i = 0; i < 100; ++i) {
+    uint64_t value = stream1();
+    ASSERT_EQ(value, again());
+    ASSERT_NE(value, base());
+    ASSERT_NE(value, stream2());
+  }
+}
+
+TEST(RandomTest, uniform_draws_cover_range) {
+  Xoshiro256 rng(3);
+  std::vector<int> counts(7, 0);
+
+  for (int i = 0; i < 7000; ++i) {
+    int value = rng.uniform_int(7);
+    ASSERT_GE(value, 0);
+    ASSERT_LT(value, 7);
+    ++counts[value];
+    float f = rng.uniform_float();
+    ASSERT_GE(f, 0.0f);
+    ASSERT_LT(f, 1.0f);
+  }
+
+  for (int i = 0; i < 7; ++i) {
+    ASSERT_NEAR(1000, counts[i], 150);
+  }
+}
+} // namespace
@@ -0,0 +1,128 @@
+#include <algorithm>
+#include <cmath>
+
+#include <Eigen/Dense>
+#include "gtest/gtest.h"
+
+#include "BingoCpp/backend.h"
+#include "BingoCpp/graph_manip.h"
+#include "BingoCpp/rewrite.h"
+#include "testing_utils.h"
+#include "test_fixtures.h"
+
+using namespace bingo;
+namespace {
+
+// rewrites hold where the original stack is finite, up to rounding
+bool equal_where_finite(const Eigen::ArrayXXd& expected,
+                        const Eigen::ArrayXXd& actual) {
+  for (int i = 0; i < expected.size(); ++i) {
+    double a = expected(i);
+    double b = actual(i);
+    if (std::isfinite(a) &&
+        std::abs(a - b) > 1e-9 * std::max(std::abs(a), 1.0)) {
+      return false;
+    }
+  }
+  return expected.size() == actual.size();
+}
+
+void expect_rewrite(const Eigen::ArrayX3i& stack,
+                    const Eigen::ArrayX3i& expected) {
+  Eigen::ArrayX3i rewritten = rewrite_stack(stack);
+  ASSERT_EQ(expected.rows(), rewritten.rows());
+  ASSERT_TRUE((expected == rewritten).all());
+}
+
+TEST(RewriteTest, zero_and_one_identities) {
+  // (X_0 - X_0) + sin(X_1) * cos(X_1 - X_1)
+  Eigen::ArrayX3i stack(8, 3);
+  stack << 0, 0, 0,
+           0, 1, 1,
+           3, 0, 0,
+           6, 1, 1,
+           3, 1, 1,
+           7, 4, 4,
+           4, 3, 5,
+           2, 2, 6;
+  Eigen::ArrayX3i expected(2, 3);
+  expected << 0, 1, 1,
+              6, 0, 0;
+  expect_rewrite(stack, expected);
+
+  // pow(|X_0|, cos(X_1 - X_1)) = |X_0|
+  Eigen::ArrayX3i power(5, 3);
+  power << 0, 0, 0,
+           0, 1, 1,
+           3, 1, 1,
+           7, 2, 2,
+           10, 0, 3;
+  Eigen::ArrayX3i absolute(2, 3);
+  absolute << 0, 0, 0,
+              11, 0, 0;
+  expect_rewrite(power, absolute);
+
+  // X_0 / X_0 and (X_1 - X_1) / X_0 are NaN where X_0 is zero
+  Eigen::ArrayX3i division(5, 3);
+  division << 0, 0, 0,
+              0, 1, 1,
+              5, 0, 0,
+              3, 1, 1,
+              5, 3, 2;
+  expect_rewrite(division, division);
+}
+
+TEST(RewriteTest, unary_compositions) {
+  // exp(log|abs(abs(X_0))|) = |X_0|
+  Eigen::ArrayX3i exp_log(5, 3);
+  exp_log << 0, 0, 0,
+             11, 0, 0,
+             11, 1, 1,
+             9, 2, 2,
+             8, 3, 3;
+  Eigen::ArrayX3i absolute(2, 3);
+  absolute << 0, 0, 0,
+              11, 0, 0;
+  expect_rewrite(exp_log, absolute);
+
+  // sqrt|X_0| * sqrt|X_0| = |X_0|
+  Eigen::ArrayX3i square(3, 3);
+  square << 0, 0, 0,
+            12, 0, 0,
+            4, 1, 1;
+  expect_rewrite(square, absolute);
+
+  // log|exp(X_0)| = X_0, and sin is kept
+  Eigen::ArrayX3i log_exp(4, 3);
+  log_exp << 0, 0, 0,
+             8, 0, 0,
+             9, 1, 1,
+             6, 2, 2;
+  Eigen::ArrayX3i sine(2, 3);
+  sine << 0, 0, 0,
+          6, 0, 0;
+  expect_rewrite(log_exp, sine);
+}
+
+TEST(RewriteTest, random_stacks_keep_their_values) {
+  // identities such as exp(log|a|) = |a| change the rounding of a value,
+  // which sin, pow and friends can amplify without bound; the arithmetic
+  // identities are exact
+  AcyclicGraphManipulator manip = AcyclicGraphManipulator(2, 32, 2);
+  for (int node = 2; node <= 5; ++node) {
+    manip.add_node_type(node);
+  }
+  manip.add_node_type(11);
+  Eigen::ArrayXXd x = Eigen::ArrayXXd::Random(100, 2) * 2.0;
+  Eigen::VectorXd constants = Eigen::VectorXd::Random(32);
+
+  for (int i = 0; i < 200; ++i) {
+    AcyclicGraph indv = manip.generate();
+    indv.count_constants();
+    Eigen::ArrayX3i rewritten = rewrite_stack(indv.simple_stack);
+    ASSERT_LE(rewritten.rows(), indv.simple_stack.rows());
+    ASSERT_TRUE(equal_where_finite(evaluate(indv.simple_stack, x, constants),
+                                   evaluate(rewritten, x, constants)));
+  }
+}
+} // namespace
@@ -0,0 +1,68 @@
+#include <vector>
+
+#include <Eigen/Dense>
+#include "gtest/gtest.h"
+
+#include "BingoCpp/backend.h"
+#include "BingoCpp/stack_analysis.h"
+#include "test_fixtures.h"
+
+using namespace bingo;
+namespace {
+
+TEST(StackAnalysisTest, utilized_commands_remapped_in_order) {
+  Eigen::ArrayX3i stack = testutils::stack_operators_0_to_5();
+  StackAnalysis analysis;
+  analyze_stack(stack, analysis);
+
+  int utilized[] = {0, 1, 2, 3, 4, 6, 8, 11};
+  ASSERT_EQ(8, analysis.num_utilized);
+  ASSERT_EQ(2, analysis.num_constants);
+  for (int i = 0; i < analysis.num_utilized; ++i) {
+    ASSERT_EQ(utilized[i], analysis.utilized_row(i));
+    ASSERT_EQ(i, analysis.remap[utilized[i]]);
+  }
+  ASSERT_FALSE(analysis.is_utilized(5));
+  ASSERT_EQ(-1, analysis.remap[5]);
+  ASSERT_EQ(0, analysis.constant_number[2]);
+  ASSERT_EQ(1, analysis.constant_number[3]);
+  ASSERT_EQ(-1, analysis.constant_number[4]);
+
+  Eigen::ArrayX3i simple_stack;
+  simplify_stack(stack, analysis, simple_stack);
+  Eigen::ArrayX3i expected(8, 3);
+  expected << 0, 0, 0,
+              0, 1, 1,
+              1, 0, 0,
+              1, 1, 1,
+              5, 3, 1,
+              2, 4, 2,
+              4, 5, 0,
+              3, 6, 0;
+  ASSERT_TRUE((expected == simple_stack).all());
+}
+
+TEST(StackAnalysisTest, unary_commands_use_one_operand) {
+  // sin(X_0), whose unused second operand points at C_0
+  Eigen::ArrayX3i stack(3, 3);
+  stack << 1, 0, 0,
+           0, 0, 0,
+           6, 1, 0;
+  StackAnalysis analysis;
+  analyze_stack(testutils::stack_operators_0_to_5(), analysis);
+  std::size_t capacity = analysis.remap.capacity();
+  analyze_stack(stack, analysis);
+
+  ASSERT_EQ(2, analysis.num_utilized);
+  ASSERT_EQ(0, analysis.num_constants);
+  ASSERT_FALSE(analysis.is_utilized(0));
+  ASSERT_EQ(capacity, analysis.remap.capacity());
+
+  Eigen::ArrayX3i simple_stack;
+  simplify_stack(stack, analysis, simple_stack);
+  Eigen::ArrayX3i expected(2, 3);
+  expected << 0, 0, 0,
+              6, 0, 0;
+  ASSERT_TRUE((expected == simple_stack).all());
+}
+} // namespace
@@ -0,0 +1,88 @@
+/*!
+ * \file thread_pool_tests.cc
+ *
+ * This file contains the unit tests for the ThreadPool class.
+ */
+
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "BingoCpp/thread_pool.h"
+
+using namespace bingo;
+
+TEST(ThreadPoolTest, runs_every_task_once) {
+  ThreadPool pool(4);
+  ASSERT_EQ(pool.num_threads(), 4);
+  std::vector<int> counts(1000, 0);
+
+  for (int repeat = 0; repeat < 3; ++repeat) {
+    pool.parallel_for(counts.size(), [&](int i) {
+      counts[i] += 1;
+    });
+  }
+
+  for (std::size_t i = 0; i < counts.size(); ++i) {
+    ASSERT_EQ(counts[i], 3);
+  }
+}
+
+TEST(ThreadPoolTest, nested_loops_run_serially) {
+  ThreadPool pool(3);
+  std::atomic<int> total(0);
+  pool.parallel_for(8, [&](int) {
+    pool.parallel_for(8, [&](int j) {
+      total += j;
+    });
+  });
+  ASSERT_EQ(total, 8 * 28);
+}
+
+TEST(ThreadPoolTest, loops_from_several_threads_take_turns) {
+  ThreadPool pool(4);
+  std::vector<std::vector<int> > counts(3, std::vector<int>(500, 0));
+  std::vector<std::thread> callers;
+
+  for (int c = 0; c < 3; ++c) {
+    callers.push_back(std::thread([&pool, &counts, c] {
+      for (int repeat = 0; repeat < 20; ++repeat) {
+        pool.parallel_for(counts[c].size(), [&counts, c](int i) {
+          counts[c][i] += 1;
+        });
+      }
+    }));
+  }
+
+  for (int c = 0; c < 3; ++c) {
+    callers[c].join();
+  }
+
+  for (int c = 0; c < 3; ++c) {
+    for (std::size_t i = 0; i < counts[c].size(); ++i) {
+      ASSERT_EQ(counts[c][i], 20);
+    }
+  }
+}
+
+TEST(ThreadPoolTest, task_exception_rethrown_after_loop) {
+  ThreadPool pool(4);
+  std::atomic<int> started(0);
+  ASSERT_THROW(pool.parallel_for(1000, [&](int i) {
+    ++started;
+    if (i == 10) {
+      throw std::runtime_error("task failed");
+    }
+  }), std::runtime_error);
+  ASSERT_GE(started, 1);
+
+  // the pool is usable afterwards
+  std::atomic<int> total(0);
+  pool.parallel_for(100, [&](int i) {
+    total += i;
+  });
+  ASSERT_EQ(total, 4950);
+}